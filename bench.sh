@@ -0,0 +1,77 @@
+#!/bin/bash
+#
+#   bench.sh -- fixed-seed benchmark of quagmire on the known-answer ciphers in ciphers/tests.
+#
+#   $ ./bench.sh [results file] [baseline results file]
+#
+#   Each case is solved once for each of the seeds 1 to BENCH_SEEDS (default 3) with one
+#   thread, stopping as soon as the plaintext of its *_solution.txt file is reached (or
+#   after BENCH_TIMEBUDGET seconds, default 60). For each case the results file records
+#   how many seeds reached the solution, the median time they took, and the mean
+#   iterations per second. Micro-benchmarks of the hot path functions on the K4-length
+#   example cipher follow. With a baseline (an earlier results file), the ratio of each
+#   figure to the baseline's is printed too.
+#
+
+cd "$(dirname "$0")"
+
+RESULTS=${1:-bench_results.txt}
+BASELINE=$2
+SEEDS=${BENCH_SEEDS:-3}
+TIMEBUDGET=${BENCH_TIMEBUDGET:-60}
+NGRAMS="-ngramsize 4 -ngramfile english_quadgrams.txt"
+T=ciphers/tests
+STATS=$(mktemp)
+
+# name, solution file, arguments.
+
+CASES=(
+	"vigenere|$T/cipher_vigenere_solution.txt|-type 0 -cipher $T/cipher_vigenere.txt -keywordlen 7 -cyclewordlen 7 -nhillclimbs 500 -nrestarts 1000 -backtrackprob 0.15"
+	"beaufort|$T/cipher_beaufort_solution.txt|-type 5 -cipher $T/cipher_beaufort.txt -cyclewordlen 7 -nhillclimbs 500 -nrestarts 1000 -backtrackprob 0.15"
+	"quagmire_1_longer|$T/cipher_quagmire_1_longer_solution.txt|-type 1 -cipher $T/cipher_quagmire_1_longer.txt -plaintextkeywordlen 5 -cyclewordlen 7 -nhillclimbs 1000 -nrestarts 10000 -backtrackprob 0.25"
+	"quagmire_2_longer|$T/cipher_quagmire_2_longer_solution.txt|-type 2 -cipher $T/cipher_quagmire_2_longer.txt -ciphertextkeywordlen 6 -cyclewordlen 7 -nhillclimbs 2500 -nrestarts 10000 -backtrackprob 0.25"
+	"quagmire_3_longer|$T/cipher_quagmire_3_longer_solution.txt|-type 3 -cipher $T/cipher_quagmire_3_longer.txt -plaintextkeywordlen 5 -ciphertextkeywordlen 5 -cyclewordlen 7 -nhillclimbs 2500 -nrestarts 10000 -backtrackprob 0.25"
+	"variant|$T/cipher_variant_solution.txt|-type 3 -variant -cipher $T/cipher_variant.txt -crib crib.txt -keywordlen 7 -cyclewordlen 7 -nhillclimbs 2500 -nrestarts 10000 -backtrackprob 0.15"
+)
+
+{
+	echo "# quagmire benchmark: seeds 1 to $SEEDS, -timebudget $TIMEBUDGET, english_quadgrams.txt"
+	echo "# case                    solved  median_seconds  it_per_sec"
+
+	for c in "${CASES[@]}"; do
+		IFS='|' read -r name solution args <<< "$c"
+		times=()
+		rates=()
+		for seed in $(seq 1 $SEEDS); do
+			output=$(./quagmire $args $NGRAMS -seed $seed -threads 1 -timebudget $TIMEBUDGET \
+				-solution $solution -stats $STATS)
+			t=$(echo "$output" | sed -n 's/^Known solution of .* reached after \([0-9.]*\) seconds$/\1/p')
+			if [ -n "$t" ]; then
+				times+=($t)
+			fi
+			rates+=($(sed -n 's/^  "moves_per_second": \([0-9.]*\),$/\1/p' $STATS))
+		done
+		median=$(printf "%s\n" "${times[@]}" | sort -g | awk '{ t[NR] = $1 } END { print NR ? t[int((NR + 1)/2)] : "-" }')
+		rate=$(printf "%s\n" "${rates[@]}" | awk '{ s += $1 } END { printf "%.0f", NR ? s/NR : 0 }')
+		printf "%-26s %d/%d  %14s  %10s\n" $name ${#times[@]} $SEEDS $median $rate
+	done
+
+	echo "# function                  ns_per_call"
+	./quagmire -type 3 -cipher cipher.txt -crib crib.txt $NGRAMS -keywordlen 7 -cyclewordlen 7 -seed 1 \
+		-benchmark 200000 | awk '/\[ns\/call\]/ { printf "%-26s %12s\n", $1, $2 }'
+} | tee $RESULTS
+
+rm -f $STATS
+
+# Ratios to the baseline, for every figure present in both files.
+
+if [ -n "$BASELINE" ]; then
+	echo
+	echo "# ratio to $BASELINE"
+	awk 'function ratio(x, y) { return (x != "-" && y != "-" && y + 0 != 0) ? sprintf("%.2f", x/y) : "-" }
+		FNR == 1 { f++ } /^#/ { next }
+		f == 1 { base[$1] = $0; next }
+		($1 in base) { split(base[$1], b);
+			if (NF == 4) printf "%-26s %s vs %s  %14s  %10s\n", $1, $2, b[2], ratio($3, b[3]), ratio($4, b[4]);
+			else printf "%-26s %12s\n", $1, ratio($2, b[2]) }' $BASELINE $RESULTS
+fi
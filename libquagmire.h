@@ -0,0 +1,67 @@
+//
+//	libquagmire.h
+//
+//	The interface for embedding the solver in another program (make libquagmire). A
+//	context holds the loaded models (the n-gram table and the dictionary), which are
+//	read-only once loaded, so one context may be shared by any number of threads, each
+//	calling quagmire_solve concurrently.
+//
+
+#ifndef LIBQUAGMIRE_H
+#define LIBQUAGMIRE_H
+
+#include <stdbool.h>
+
+#if defined(__GNUC__)
+#define QUAGMIRE_API __attribute__((visibility("default")))
+#else
+#define QUAGMIRE_API
+#endif
+
+typedef struct quagmire_context quagmire_context;
+
+// A cipher to solve. The ciphertext is the text itself (or a file holding it, as for
+// -cipher). The options are those of the command line that may differ between searches,
+// with their values, e.g. {"-type", "4", "-plaintextkeywordlen", "7", "-nrestarts", "100"}:
+// the cipher options (-type, -variant, -crib, the keyword and cycleword lengths, and
+// -solution), the search options (-nhillclimbs, -threads, -engine, the weights,
+// -timebudget, -keywordsearch etc.), and -seed. A -crib may be the crib text itself.
+
+typedef struct {
+	const char *ciphertext;
+	int n_options;
+	const char **options;
+} quagmire_request;
+
+// The best solution of a request, as upper case strings. The plaintext and cycleword are
+// allocated by quagmire_solve and freed by quagmire_result_free. n_words_found is -1
+// without a dictionary.
+
+typedef struct {
+	double score;
+	int cipher_len, cycleword_len, n_words_found;
+	char plaintext_keyword[27], ciphertext_keyword[27], *cycleword, *plaintext;
+} quagmire_result;
+
+// Load the n-gram file (with ngram_table "float", "uint16", "uint8" or "sparse", or NULL
+// for the default for the n-gram size) and the dictionary (or NULL), returning NULL if
+// either cannot be. With verbose, every search reports its progress.
+
+QUAGMIRE_API quagmire_context *quagmire_context_create(const char *ngram_file, int ngram_size,
+	const char *ngram_table, const char *dictionary_file, bool verbose);
+QUAGMIRE_API void quagmire_context_free(quagmire_context *context);
+
+// Load the keyword list that searches with the -keywordsearch option start from: a file
+// with one word per line, or comma separated words. Call it before any search uses the
+// context. Returns false if the list has no usable words.
+
+QUAGMIRE_API bool quagmire_context_load_keywords(quagmire_context *context, const char *keywords);
+
+// Solve a request, returning false (having printed the error) if its ciphertext or options
+// cannot be used. Without a -seed option the seed is taken from the clock.
+
+QUAGMIRE_API bool quagmire_solve(quagmire_context *context, quagmire_request *request,
+	quagmire_result *result);
+QUAGMIRE_API void quagmire_result_free(quagmire_result *result);
+
+#endif
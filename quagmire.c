@@ -25,32 +25,110 @@
 
 #include "quagmire.h"
 
+// English word length frequencies. (Ref: https://math.wvu.edu/~hdiamond/Math222F17/Sigurd_et_al-2004-Studia_Linguistica.pdf)
+
+int n_english_word_length_frequency_letters = 25;
+char *ngram_backend_names[N_NGRAM_BACKENDS] = {"float", "uint16", "uint8", "sparse"};
+char *engine_names[N_ENGINES] = {"hill", "anneal", "tempering"};
+char *keyword_search_names[N_KEYWORD_SEARCHES] = {"random", "seed", "exhaustive"};
+char *stats_phase_names[N_STATS_PHASES] = {"restart", "perturb", "constrain", 
+	"score_incremental", "score_full", "score_batch", "accept"};
+char *move_type_names[N_MOVE_TYPES] = {"keyword", "cycleword", "batch"};
+char *move_outcome_names[N_MOVE_OUTCOMES] = {"improved", "slipped", "rejected"};
+
+double english_word_length_frequencies[] = {
+	0.0316, 0.16975, 0.21192, 0.15678, 0.10852, 0.08524, 0.07724, 
+	0.05623, 0.04032, 0.02766, 0.01582, 0.00917, 0.00483, 0.00262, 
+	0.00099, 0.0005, 0.00027, 0.00022, 0.00011, 0.00006, 0.00005, 
+	0.00002, 0.00001, 0.00001, 0.00001};
+
+
+
+// Ref: http://practicalcryptography.com/cryptanalysis/letter-frequencies-various-languages/english-letter-frequencies/
+double english_monograms[] = {
+	0.085517, // A
+	0.016048, // B
+	0.031644, // C
+	0.038712, // D
+	0.120965, // E
+	0.021815, // F
+	0.020863, // G
+	0.049557, // H
+	0.073251, // I
+	0.002198, // J
+	0.008087, // K
+	0.042065, // L
+	0.025263, // M
+	0.071722, // N
+	0.074673, // O
+	0.020662, // P
+	0.001040, // Q
+	0.063327, // R
+	0.067282, // S
+	0.089381, // T
+	0.026816, // U
+	0.010593, // V
+	0.018254, // W
+	0.001914, // X
+	0.017214, // Y
+	0.001138  // Z
+};
+
 /* Program syntax:
 
 	$ ./quagmire \
 		-nhillclimbs /number of hillclimbing steps/ \
 		-nrestarts /number of restarts/ \
+		-batch /number of candidate moves scored together at each hill climbing step/ \
 		-type /cipher type (0, 1, 2, 3, 4, or 5)/ \
 		-cipher /ciphertext file/ \
+		-manifest /file (or - for stdin) listing many ciphers to solve, one per line, instead of -cipher/ \
+		-manifestjobs /number of manifest ciphers solved concurrently/ \
 		-crib /crib file/ \
 		-ngramsize /n-gram size in n-gram statistics file/ \
 		-ngramfile /n-gram statistics file/ \
+		-ngramtable /n-gram table type (float, uint16, uint8 or sparse)/ \
 		-maxkeywordlen /max length of the keyword/ \
 		-maxcyclewordlen /max length of the cycleword/ \
 		-plaintextkeywordlen /user defined length of the plaintext keyword/ \
 		-ciphertextkeywordlen /user defined length of the ciphertext keyword/ \
 		-cyclewordlen /user defined length of the cycleword/ \
 		-nsigmathreshold /n sigma threshold for candidate keyword length/ \
+		-periodtests /rank candidate cycleword lengths by the IoC, autocorrelation and Kasiski tests combined/ \
 		-backtrackprob /probability of backtracking to the best 
 			solution instead of a random initial solution/ \
 		-keywordpermprob /probability of permuting the keyword instead of the cycleword/ \
 		-slipprob /probability of slipping to a worse score/ \
 		-iocthreshold /lower limit for ioc/ \
 		-dictionary /dictionary file, a text file containing one word per line/ \
+		-keywordsearch /keywords the restarts start from (random, seed or exhaustive, see -keywords)/ \
+		-keywords /keyword list file, one word per line, or comma separated words (default the dictionary)/ \
 		-weightngram /weight used in the hillclimber score for the ngram score/ \
 		-weightcrib /weight used in the hillclimber score for the crib matches/ \
 		-weightioc /weight used in the hillclimber score for the IoC/ \
 		-weightentropy /weight used in the hillclimber score for the plaintext entropy/ \
+		-threads /number of worker threads sharing the restarts/ \
+		-jobs /number of length triples (cycleword, plaintext and ciphertext keyword lengths) run concurrently/ \
+		-dropthreshold /drop a length triple when its best score falls below this fraction of the leader's/ \
+		-topk /number of best distinct solutions kept, printed and backtracked to/ \
+		-engine /search engine (hill, anneal or tempering)/ \
+		-starttemp /initial annealing temperature, or the hottest tempering replica's/ \
+		-endtemp /final annealing temperature, or the coldest tempering replica's/ \
+		-swapinterval /moves between tempering swap attempts/ \
+		-confirm /stop a length triple once this many independent restarts reach its best plaintext/ \
+		-stall /stop a length triple after this many restarts without improvement/ \
+		-targetscore /stop the search once a solution scores at least this/ \
+		-timebudget /stop the search after this many seconds/ \
+		-searchlength /letters at the start of a longer ciphertext the hill climber searches (default 10000)/ \
+		-seed /random seed, for reproducible runs/ \
+		-checkpoint /file the search state is saved to periodically and at the end/ \
+		-checkpointinterval /seconds between checkpoints/ \
+		-resume /continue the search saved in the -checkpoint file/ \
+		-solution /known plaintext (or *_solution.txt file), the search stops once it is reached/ \
+		-benchmark /number of calls to time each hot path function with, instead of searching/ \
+		-stats /file (or - for stdout) the JSON report of hot path counters and timings is written to at exit/ \
+		-results /file (or - for stdout) NDJSON result records (and with -verbose, progress records) are written to/ \
+		-earlyabort /stop scoring a move once it cannot beat the current score/ \
 		-verbose
 
 
@@ -78,130 +156,95 @@
 		the cribs given for K4 were correct we could make additional performance improvements. 
 */
 
+#ifndef QUAGMIRE_LIBRARY
 int main(int argc, char **argv) {
 
-	int i, j, k, cipher_type = 3, cipher_len, cycleword_len, ngram_size = 0,
-		ciphertext_keyword_len = 5, plaintext_keyword_len = 5, ciphertext_max_keyword_len = 12, 
-		min_keyword_len = 5, plaintext_max_keyword_len = 12, max_cycleword_len = 20, n_restarts = 1, 
-		n_cycleword_lengths, n_hill_climbs = 1000, n_cribs, best_cycleword_length,
-		best_plaintext_keyword_length, best_ciphertext_keyword_length, n_words_found, 
-		cipher_indices[MAX_CIPHER_LENGTH], crib_positions[MAX_CIPHER_LENGTH], 
-		crib_indices[MAX_CIPHER_LENGTH], cycleword_lengths[MAX_CIPHER_LENGTH],
-		decrypted[MAX_CIPHER_LENGTH], best_decrypted[MAX_CIPHER_LENGTH],
-		plaintext_keyword[ALPHABET_SIZE], ciphertext_keyword[ALPHABET_SIZE], cycleword[ALPHABET_SIZE],
-		best_plaintext_keyword[ALPHABET_SIZE], best_ciphertext_keyword[ALPHABET_SIZE], best_cycleword[ALPHABET_SIZE]; 
-	double n_sigma_threshold = 1., ioc_threshold = 0.047, backtracking_probability = 0.01, 
-		keyword_permutation_probability = 0.01, slip_probability = 0.0005, score, best_score;
-	float weight_ngram = 12., weight_crib = 36., weight_ioc = 1., weight_entropy = 1.;
-	char ciphertext_file[MAX_FILENAME_LEN], crib_file[MAX_FILENAME_LEN], dictionary_file[MAX_FILENAME_LEN], 
-		ngram_file[MAX_FILENAME_LEN], ciphertext[MAX_CIPHER_LENGTH], 
-		cribtext[MAX_CIPHER_LENGTH];
-	bool verbose = false, cipher_present = false, crib_present = false, plaintext_keyword_len_present = false, 
-		cycleword_len_present = false, ciphertext_keyword_len_present = false, dictionary_present_p = false,
-		variant = false, beaufort = false;
-	FILE *fp;
-	float *ngram_data;
+	int i, n, ngram_backend_indx = INACTIVE, n_manifest_jobs = 1, n_benchmark_calls = 0;
+	char ciphertext_file[MAX_FILENAME_LEN], dictionary_file[MAX_FILENAME_LEN], 
+		ngram_file[MAX_FILENAME_LEN], manifest_file[MAX_FILENAME_LEN], checkpoint_file[MAX_FILENAME_LEN], 
+		stats_file[MAX_FILENAME_LEN], results_file[MAX_FILENAME_LEN], *keywords_source = NULL;
+	bool cipher_present = false, dictionary_present_p = false, seed_present = false, manifest_present = false, 
+		results_present = false;
+	uint64_t seed = 0;
+	quagmire_context *context;
+	stats_report report;
+	progress_reporter *reporter = NULL;
+	FILE *results_fp = NULL;
+	cipher_options options;
+	solver_settings settings;
+	cipher_job *job;
+	manifest_reader reader;
+
+	default_cipher_options(&options);
+	default_solver_settings(&settings);
 
 	// Read command line args. 
 	for(i = 1; i < argc; i++) {
-		if (strcmp(argv[i], "-type") == 0) {
-			cipher_type = atoi(argv[++i]);
-			printf("\n-type %d", cipher_type);
+		n = parse_cipher_option(&options, argc, argv, i, true);
+		if (n == 0) {
+			n = parse_solver_option(&settings, argc, argv, i, true);
+		}
+		if (n == INACTIVE) {
+			return 0;
+		} else if (n > 0) {
+			i += n - 1;
 		} else if (strcmp(argv[i], "-cipher") == 0) {
 			cipher_present = true;
 			strcpy(ciphertext_file, argv[++i]);
 			printf("\n-cipher %s", ciphertext_file);
-		} else if (strcmp(argv[i], "-crib") == 0) {
-			crib_present = true;
-			strcpy(crib_file, argv[++i]);
-			printf("\n-crib %s", crib_file);
+		} else if (strcmp(argv[i], "-manifest") == 0) {
+			manifest_present = true;
+			strcpy(manifest_file, argv[++i]);
+			printf("\n-manifest %s", manifest_file);
+		} else if (strcmp(argv[i], "-manifestjobs") == 0) {
+			n_manifest_jobs = atoi(argv[++i]);
+			printf("\n-manifestjobs %d", n_manifest_jobs);
 		} else if (strcmp(argv[i], "-ngramsize") == 0) {
-			ngram_size = atoi(argv[++i]);
-			printf("\n-ngram_size %d", ngram_size);
+			settings.ngram_size = atoi(argv[++i]);
+			printf("\n-ngram_size %d", settings.ngram_size);
 		} else if (strcmp(argv[i], "-ngramfile") == 0) {
 			strcpy(ngram_file, argv[++i]);
 			printf("\n-ngramfile %s", ngram_file);
-		} else if (strcmp(argv[i], "-maxkeywordlen") == 0) {
-			plaintext_keyword_len = atoi(argv[++i]);
-			ciphertext_keyword_len = plaintext_keyword_len;
-			printf("\n-maxkeywordlen %d", plaintext_keyword_len);
-		} else if (strcmp(argv[i], "-keywordlen") == 0) {
-			plaintext_keyword_len_present = true;
-			ciphertext_keyword_len_present = true;
-			plaintext_keyword_len = atoi(argv[++i]);
-			ciphertext_keyword_len = plaintext_keyword_len;
-			plaintext_max_keyword_len = max(plaintext_max_keyword_len, 1 + plaintext_keyword_len);
-			ciphertext_max_keyword_len = max(ciphertext_max_keyword_len, 1 + ciphertext_keyword_len);
-			min_keyword_len = plaintext_keyword_len;
-			printf("\n-keywordlen %d", plaintext_keyword_len);			
-		} else if (strcmp(argv[i], "-plaintextkeywordlen") == 0) {
-			plaintext_keyword_len_present = true;
-			plaintext_keyword_len = atoi(argv[++i]);
-			plaintext_max_keyword_len = max(plaintext_max_keyword_len, 1 + plaintext_keyword_len);
-			min_keyword_len = plaintext_keyword_len;
-			printf("\n-plaintextkeywordlen %d", plaintext_keyword_len);
-		} else if (strcmp(argv[i], "-ciphertextkeywordlen") == 0) {
-			ciphertext_keyword_len_present = true;
-			ciphertext_keyword_len = atoi(argv[++i]);
-			ciphertext_max_keyword_len = max(ciphertext_max_keyword_len, 1 + ciphertext_keyword_len);
-			min_keyword_len = ciphertext_keyword_len;
-			printf("\n-ciphertextkeywordlen %d", ciphertext_keyword_len);
-		} else if (strcmp(argv[i], "-maxcyclewordlen") == 0) {
-			max_cycleword_len = atoi(argv[++i]);
-			printf("\n-maxcyclewordlen %d", max_cycleword_len);
-		} else if (strcmp(argv[i], "-cyclewordlen") == 0) {
-			cycleword_len_present = true;
-			cycleword_len = atoi(argv[++i]);
-			if (cycleword_len == 0) {
-				cycleword_len_present = false;
+		} else if (strcmp(argv[i], "-ngramtable") == 0) {
+			i++;
+			ngram_backend_indx = ngram_backend(argv[i]);
+			printf("\n-ngramtable %s", argv[i]);
+			if (ngram_backend_indx == INACTIVE) {
+				printf("\n\nERROR: unknown n-gram table '%s' (float, uint16, uint8 or sparse).\n\n", argv[i]);
+				return 0;
 			}
-			max_cycleword_len = max(max_cycleword_len, 1 + cycleword_len);
-			printf("\n-cyclewordlen %d", cycleword_len);
-		} else if (strcmp(argv[i], "-nsigmathreshold") == 0) {
-			n_sigma_threshold = atof(argv[++i]);
-			printf("\n-nsigmathreshold %.2f", n_sigma_threshold);
-		} else if (strcmp(argv[i], "-nlocal") == 0) {
-			// TODO: remove me and update all tests/scripts etc. 
-		} else if (strcmp(argv[i], "-nhillclimbs") == 0) {
-			n_hill_climbs = atoi(argv[++i]);
-			printf("\n-nhillclimbs %d", n_hill_climbs);			
-		} else if (strcmp(argv[i], "-nrestarts") == 0) {
-			n_restarts = atoi(argv[++i]);
-			printf("\n-nrestarts %d", n_restarts);
-		} else if (strcmp(argv[i], "-backtrackprob") == 0) {
-			backtracking_probability = atof(argv[++i]);
-			printf("\n-backtrackprob %.4f", backtracking_probability);
-		} else if (strcmp(argv[i], "-keywordpermprob") == 0) {
-			keyword_permutation_probability = atof(argv[++i]);
-			printf("\n-keywordpermprob %.4f", keyword_permutation_probability);
-		} else if (strcmp(argv[i], "-slipprob") == 0) {
-			slip_probability = atof(argv[++i]);
-			printf("\n-slipprob %.4f", slip_probability);
-		} else if (strcmp(argv[i], "-iocthreshold") == 0) {
-			ioc_threshold = atof(argv[++i]);
-			printf("\n-iocthreshold %.4f", ioc_threshold);
 		} else if (strcmp(argv[i], "-dictionary") == 0 || strcmp(argv[i], "-dict") == 0) {
 			dictionary_present_p = true;
 			strcpy(dictionary_file, argv[++i]);
 			printf("\n-dictionary %s", dictionary_file);
-		} else if (strcmp(argv[i], "-weightngram") == 0) { 
-			weight_ngram = atof(argv[++i]);
-			printf("\n-weightngram %.4f", weight_ngram);
-		} else if (strcmp(argv[i], "-weightcrib") == 0) { 
-			weight_crib = atof(argv[++i]);
-			printf("\n-weightcrib %.4f", weight_crib);
-		} else if (strcmp(argv[i], "-weightioc") == 0) { 
-			weight_ioc = atof(argv[++i]);
-			printf("\n-weightioc %.4f", weight_ioc);
-		} else if (strcmp(argv[i], "-weightentropy") == 0) { 
-			weight_entropy = atof(argv[++i]);
-			printf("\n-weightentropy %.4f", weight_entropy);
-		} else if (strcmp(argv[i], "-variant") == 0) { 
-			variant = true;
-			printf("\n-variant");
-		} else if (strcmp(argv[i], "-verbose") == 0) {
-			verbose = true;
-			printf("\n-verbose ");
+		} else if (strcmp(argv[i], "-keywords") == 0) {
+			keywords_source = argv[++i];
+			printf("\n-keywords %s", keywords_source);
+		} else if (strcmp(argv[i], "-seed") == 0) {
+			seed_present = true;
+			seed = strtoull(argv[++i], NULL, 10);
+			printf("\n-seed %llu", (unsigned long long) seed);
+		} else if (strcmp(argv[i], "-checkpoint") == 0) {
+			strcpy(checkpoint_file, argv[++i]);
+			settings.checkpoint_file = checkpoint_file;
+			printf("\n-checkpoint %s", checkpoint_file);
+		} else if (strcmp(argv[i], "-checkpointinterval") == 0) {
+			settings.checkpoint_interval = atof(argv[++i]);
+			printf("\n-checkpointinterval %.1f", settings.checkpoint_interval);
+		} else if (strcmp(argv[i], "-resume") == 0) {
+			settings.resume = true;
+			printf("\n-resume");
+		} else if (strcmp(argv[i], "-benchmark") == 0) {
+			n_benchmark_calls = atoi(argv[++i]);
+			printf("\n-benchmark %d", n_benchmark_calls);
+		} else if (strcmp(argv[i], "-stats") == 0) {
+			strcpy(stats_file, argv[++i]);
+			settings.stats = &report;
+			printf("\n-stats %s", stats_file);
+		} else if (strcmp(argv[i], "-results") == 0) {
+			results_present = true;
+			strcpy(results_file, argv[++i]);
+			printf("\n-results %s", results_file);
 		} else {
 			printf("\n\nERROR: unknown arg '%s'\n\n", argv[i]);
 			return 0;
@@ -210,58 +253,95 @@ int main(int argc, char **argv) {
 	printf("\n\n");
 
 
-	if (cipher_type == BEAUFORT) {
-		beaufort = true;
-	}
-
 	// Print cipher type. 
 
-	char variant_display[10], variant_str[] = "variant";
-	if (variant) {
-		strcpy(variant_display, variant_str);
-	} else {
-		strcpy(variant_display, "");
-	}
+	if (! manifest_present) {
+
+		char variant_display[10], variant_str[] = "variant";
+		if (options.variant) {
+			strcpy(variant_display, variant_str);
+		} else {
+			strcpy(variant_display, "");
+		}
 
-	if (cipher_type == VIGENERE) {
-		printf("\n\nSolving a %s Vigenere cipher.\n\n", variant_display);
-	} else if (cipher_type == BEAUFORT) {
-		printf("\n\nSolving a %s Beaufort cipher.\n\n", variant_display);
-	} else if (cipher_type == QUAGMIRE_1) {
-		printf("\n\nSolving a %s Quagmire I cipher.\n\n", variant_display);
-	} else if (cipher_type == QUAGMIRE_2) {
-		printf("\n\nSolving a %s Quagmire II cipher.\n\n", variant_display);
-	} else if (cipher_type == QUAGMIRE_3) {
-		printf("\n\nSolving a %s Quagmire III cipher.\n\n", variant_display);
-	} else if (cipher_type == QUAGMIRE_4) {
-		printf("\n\nSolving a %s Quagmire IV cipher.\n\n", variant_display);
+		if (options.cipher_type == VIGENERE) {
+			printf("\n\nSolving a %s Vigenere cipher.\n\n", variant_display);
+		} else if (options.cipher_type == BEAUFORT) {
+			printf("\n\nSolving a %s Beaufort cipher.\n\n", variant_display);
+		} else if (options.cipher_type == QUAGMIRE_1) {
+			printf("\n\nSolving a %s Quagmire I cipher.\n\n", variant_display);
+		} else if (options.cipher_type == QUAGMIRE_2) {
+			printf("\n\nSolving a %s Quagmire II cipher.\n\n", variant_display);
+		} else if (options.cipher_type == QUAGMIRE_3) {
+			printf("\n\nSolving a %s Quagmire III cipher.\n\n", variant_display);
+		} else if (options.cipher_type == QUAGMIRE_4) {
+			printf("\n\nSolving a %s Quagmire IV cipher.\n\n", variant_display);
+		}
 	}
 
 
 	// Sense check command line inputs. 
 
-	if (! cipher_present) {
+	if (! cipher_present && ! manifest_present) {
 		printf("\n\nERROR: cipher file not present.\n\n");
 		return 0;
 	}
 
-	if (ngram_size == 0) {
+	if (cipher_present && manifest_present) {
+		printf("\n\nERROR: use either -cipher or -manifest, not both.\n\n");
+		return 0;
+	}
+
+	if (settings.ngram_size == 0) {
 		printf("\n\nERROR: -ngramsize missing.\n\n");
 		return 0;
 	}
 
-	if (! file_exists(ciphertext_file)) {
+	if (! check_cipher_options(&options)) {
+		return 0;
+	}
+
+	if (! check_solver_settings(&settings)) {
+		return 0;
+	}
+
+	if (n_manifest_jobs < 1 || n_manifest_jobs > MAX_THREADS) {
+		printf("\n\nERROR: -manifestjobs must be between 1 and %d.\n\n", MAX_THREADS);
+		return 0;
+	}
+
+	if (settings.resume && settings.checkpoint_file == NULL) {
+		printf("\n\nERROR: -resume needs the -checkpoint file to resume from.\n\n");
+		return 0;
+	}
+
+	if (settings.checkpoint_file != NULL && manifest_present) {
+		printf("\n\nERROR: -checkpoint cannot be used with -manifest.\n\n");
+		return 0;
+	}
+
+	if (n_benchmark_calls < 0 || (n_benchmark_calls > 0 && manifest_present)) {
+		printf("\n\nERROR: -benchmark needs a positive number of calls, and cannot be used with -manifest.\n\n");
+		return 0;
+	}
+
+	if (settings.checkpoint_interval <= 0.) {
+		printf("\n\nERROR: -checkpointinterval must be positive.\n\n");
+		return 0;
+	}
+
+	if (cipher_present && ! file_exists(ciphertext_file)) {
 		printf("\nERROR: missing file '%s'\n", ciphertext_file);
   		return 0;
 	}
 
-	if (! file_exists(ngram_file)) {
-		printf("\nERROR: missing file '%s'\n", ngram_file);
+	if (manifest_present && strcmp(manifest_file, "-") != 0 && ! file_exists(manifest_file)) {
+		printf("\nERROR: missing file '%s'\n", manifest_file);
   		return 0;
 	}
 
-	if (crib_present && ! file_exists(crib_file)) {
-		printf("\nERROR: missing file '%s'\n", crib_file);
+	if (options.crib_present && ! file_exists(options.crib)) {
+		printf("\nERROR: missing file '%s'\n", options.crib);
   		return 0;
 	}
 
@@ -271,281 +351,180 @@ int main(int argc, char **argv) {
 	if (! dictionary_present_p && file_exists(oxford_english_words)) {
 		dictionary_present_p = true;
 		strcpy(dictionary_file, oxford_english_words);
-		if (verbose) {
+		if (settings.verbose) {
 			printf("\ndictionary = %s\n\n", dictionary_file);
 		}
 	}
 
-	// Read ciphertext. Only the first line of the ciphertext file is read (leaving 
-	// further lines for explanation/derivation etc.)
+	// Load the n-gram file and the dictionary, which are shared by every cipher. 
 
-	fp = fopen(ciphertext_file, "r");
-	fscanf(fp, "%s", ciphertext);
-	fclose(fp);
-
-	if (verbose) {
-		printf("ciphertext = \n\'%s\'\n\n", ciphertext);
+	context = quagmire_context_create(ngram_file, settings.ngram_size, 
+		ngram_backend_indx == INACTIVE ? NULL : ngram_backend_names[ngram_backend_indx], 
+		dictionary_present_p ? dictionary_file : NULL, settings.verbose);
+	if (context == NULL) {
+		return 0;
 	}
 
-	cipher_len = (int) strlen(ciphertext);
-
-	// Read crib. 
-
-	if (file_exists(crib_file)) {
-
-		fp = fopen(crib_file, "r");
-		fscanf(fp, "%s", cribtext);
-		fclose(fp);
-
-		if (verbose) {
-			printf("cribtext = \n\'%s\'\n\n", cribtext);
-		}
-
-		// Check ciphertext and cribtext are of the same length. 
-
-		if (cipher_len != strlen(cribtext)) {
-			printf("\n\nERROR: strlen(ciphertext) = %d, strlen(cribtext) = %lu.\n\n", 
-				cipher_len, strlen(cribtext));
-			return 0; 
-		}
-
-		// Extract crib positions and corresponding plaintext. 
-
-		if (verbose) {
-			printf("\ncrib indices = \n\n");
-		}
-
-		n_cribs = 0;
-		for (i = 0; i < cipher_len; i++) {
-			if (cribtext[i] != '_') {
-				crib_positions[n_cribs] = i;
-				crib_indices[n_cribs] = cribtext[i] - 'A';
-				n_cribs++;
-				if (verbose) {
-					printf("%d, %c, %d\n", i, cribtext[i], cribtext[i] - 'A');
-				}
-			}
-		}
+	// The keyword list of -keywordsearch is the dictionary unless -keywords is given. 
 
-		if (verbose) {
-			printf("\n");
+	if (keywords_source == NULL && settings.keyword_search != KEYWORD_RANDOM) {
+		if (! dictionary_present_p) {
+			printf("\n\nERROR: -keywordsearch %s needs -keywords or a dictionary.\n\n", 
+				keyword_search_names[settings.keyword_search]);
+			quagmire_context_free(context);
+			return 0;
 		}
-	} else {
-		// No cribs present. 
-		n_cribs = 0;
+		keywords_source = dictionary_file;
 	}
 
-	// Compute ciphertext indices. A -> 0, B -> 1, ..., Z -> 25 (Assuming ALPHABET_SIZE = 26)
-
-	ord(ciphertext, cipher_indices);
-
-	// Estimate cycleword length. 
-
-	estimate_cycleword_lengths(
-			cipher_indices, 
-			cipher_len, 
-			max_cycleword_len, 
-			n_sigma_threshold,
-			ioc_threshold, 
-			&n_cycleword_lengths, 
-			cycleword_lengths, 
-			verbose);
-
-	// Load n-gram file. 
+	if (keywords_source != NULL && ! quagmire_context_load_keywords(context, keywords_source)) {
+		quagmire_context_free(context);
+		return 0;
+	}
 
-	ngram_data = load_ngrams(ngram_file, ngram_size, verbose);
+	quagmire_context_settings(context, &settings);
 
 	// Set random seed.
 
-	srand(time(NULL));
+	if (! seed_present) {
+		seed = default_seed();
+	}
+	seed_rand(seed);
+	printf("\nRandom seed = %llu\n", (unsigned long long) seed);
 
-	// User-defined cycleword length. 
-	
-	if (cycleword_len_present) {
-		n_cycleword_lengths = 1;
-		cycleword_lengths[0] = cycleword_len;
+	if (settings.stats != NULL) {
+		stats_report_init(settings.stats);
 	}
 
-	// Vigenere cipher case.
-	if (cipher_type == VIGENERE) {
-		min_keyword_len = 1;
+	// Progress and results are reported from a thread of their own. 
+
+	if (results_present) {
+		results_fp = strcmp(results_file, "-") == 0 ? stdout : fopen(results_file, "w");
+		if (results_fp == NULL) {
+			printf("\n\nERROR: cannot write the results file '%s'.\n\n", results_file);
+			return 0;
+		}
 	}
 
-	// Beaufort cipher case.
-	if (cipher_type == BEAUFORT) {
-		min_keyword_len = 1;
-		plaintext_max_keyword_len = 2;
-		plaintext_max_keyword_len = 2;
+	if (settings.verbose || results_present) {
+		reporter = malloc(sizeof(progress_reporter));
+		progress_reporter_start(reporter, settings.verbose, results_fp);
+		settings.reporter = reporter;
 	}
 
-	// For each cycleword length and keyword length combination, run the 'shotgun' hill-climber. 
+	// Batch mode: solve each cipher of the manifest, streaming a summary line for each. 
 
-	best_score = 0.;
+	if (manifest_present) {
 
-	for (i = 0; i < n_cycleword_lengths; i++) {
-		for (j = min(min_keyword_len, plaintext_keyword_len); j < plaintext_max_keyword_len; j++) {
-			for (k = min(min_keyword_len, ciphertext_keyword_len); k < ciphertext_max_keyword_len; k++) {
-				
-				// printf("i,j,k = %d, %d, %d", i, j, k);
+		reader.fp = strcmp(manifest_file, "-") == 0 ? stdin : fopen(manifest_file, "r");
+		reader.defaults = &options;
+		reader.settings = &settings;
 
-				// User-specified plaintext keyword length. 
-				if (plaintext_keyword_len_present && j != plaintext_keyword_len) {
-					continue ;
-				}
+		run_manifest(&reader, n_manifest_jobs);
 
-				// User-specified ciphertext keyword length. 
-				if (ciphertext_keyword_len_present && k != ciphertext_keyword_len) {
-					continue ;
-				}
+		printf("\n%d ciphers solved, %d failed.\n", atomic_load(&reader.n_solved), atomic_load(&reader.n_failed));
 
-				// Both Vigenere and Quagmire 3 use the same ciphertext and plaintext keywords. 
-				if ((cipher_type == VIGENERE || cipher_type == QUAGMIRE_3) && j != k) continue ;
+		if (settings.stats != NULL) {
+			write_stats_report(settings.stats, stats_file, &settings);
+		}
 
-				// Vigenere cipher uses same ciphertext, plaintext, and cycleword lengths.
-				if (cipher_type == VIGENERE && ! (cycleword_lengths[i] == j && cycleword_lengths[i] == k)) continue ;
+		if (reader.fp != stdin) {
+			fclose(reader.fp);
+		}
+		close_reporter(reporter, results_fp);
+		quagmire_context_free(context);
 
-				// Beaufort cipher uses a plaintext and ciphertext keyword of 'A'.
-				if (cipher_type == BEAUFORT && ! (j == 1 && k == 1)) continue ;
+		return 1;
+	}
 
-				if (verbose) {
-					printf("\nplaintext, ciphertext, cycleword lengths = %d, %d, %d\n", j, k, cycleword_lengths[i]);
-				}
+	// Read the ciphertext and the crib. 
 
-				// Check the cipher satisfies the cribs for the cycleword length. 
-				if (! cribs_satisfied_p(cipher_indices, cipher_len, crib_indices, crib_positions, n_cribs, cycleword_lengths[i], verbose)) {
-					if (verbose) {
-						printf("\n\nCiphertext does not satisfy the cribs for cycleword length %d. \n\n", cycleword_lengths[i]);
-					}
-#if CRIB_CHECK
-					continue ;
-#endif
-				}
+	job = malloc(sizeof(cipher_job));
 
-				// Run the hill-climber. 
-
-				score = quagmire_shotgun_hill_climber(
-					cipher_type, 
-					cipher_indices, 
-					cipher_len, 
-					crib_indices, 
-					crib_positions, 
-					n_cribs, 
-					cycleword_lengths[i],
-					j,  
-					k,
-					n_hill_climbs, 
-					n_restarts, 
-					ngram_data, 
-					ngram_size,
-					decrypted, 
-					plaintext_keyword,
-					ciphertext_keyword,
-					cycleword, 
-					backtracking_probability,
-					keyword_permutation_probability,
-					slip_probability, 
-					weight_ngram, 
-					weight_crib, 
-					weight_ioc, 
-					weight_entropy,
-					variant, 
-					beaufort,
-					verbose);
-
-				// Keep the best solution. 
-
-				if (score > best_score) {
-					best_score = score;
-					best_cycleword_length = cycleword_lengths[i];
-					best_plaintext_keyword_length = j;
-					best_ciphertext_keyword_length = k;
-					vec_copy(decrypted, best_decrypted, cipher_len);
-					vec_copy(plaintext_keyword, best_plaintext_keyword, ALPHABET_SIZE);
-					vec_copy(ciphertext_keyword, best_ciphertext_keyword, ALPHABET_SIZE);
-					vec_copy(cycleword, best_cycleword, ALPHABET_SIZE);
-				}
-			}
-		}
+	if (! load_cipher_job(job, ciphertext_file, &options, false, settings.verbose)) {
+		free_cipher_job(job);
+		return 0;
 	}
 
-	// Find dictionary words. 
+	// Micro-benchmarks of the hot path instead of a search. 
 
-	char plaintext_string[MAX_CIPHER_LENGTH];
+	if (n_benchmark_calls > 0) {
+		run_benchmarks(job, &settings, n_benchmark_calls);
+		close_reporter(reporter, results_fp);
+		free_cipher_job(job);
+		free(job);
+		quagmire_context_free(context);
+		return 1;
+	}
 
-	for (int i = 0; i < cipher_len; i++) {
-		plaintext_string[i] = best_decrypted[i] + 'A';
+	if (! solve_cipher(job, &settings)) {
+		free_cipher_job(job);
+		return 0;
 	}
-	plaintext_string[cipher_len] = '\0';
 
-#if DICTIONARY
-	if (dictionary_present_p) {
-		char **dict = NULL;
-		int n_dict_words, max_dict_word_len;
+	// Find dictionary words. 
 
-		load_dictionary(dictionary_file, &dict, &n_dict_words, &max_dict_word_len, verbose);
+	char *plaintext_string = text_string(job->best_decrypted, job->cipher_len);
 
-		if (verbose) {
+#if DICTIONARY
+	if (settings.dict != NULL) {
+
+		if (settings.verbose) {
 			printf("\nDictionary words = \n");
 		}
 
-		n_words_found = find_dictionary_words(plaintext_string, dict, n_dict_words, max_dict_word_len);
-		printf("\n%d words found.\n", n_words_found);
-
-		free_dictionary(dict, n_dict_words);
+		job->n_words_found = find_dictionary_words(plaintext_string, settings.dict, true);
+		printf("\n%d words found.\n", job->n_words_found);
 	}
 #endif
 
-	printf("\n\n%.2f\n", best_score);
-	if (dictionary_present_p) {
-		printf("%d\n", n_words_found);
+	printf("\n\n%.2f\n", job->best_score);
+	if (settings.dict != NULL) {
+		printf("%d\n", job->n_words_found);
 	}
 
-	print_text(cipher_indices, cipher_len);
+	print_text(job->cipher_indices, job->cipher_len);
 	printf("\n");
-	print_text(best_plaintext_keyword, ALPHABET_SIZE);
+	print_text(job->best_plaintext_keyword, ALPHABET_SIZE);
 	printf("\n");
-	print_text(best_ciphertext_keyword, ALPHABET_SIZE);
+	print_text(job->best_ciphertext_keyword, ALPHABET_SIZE);
 	printf("\n");
-	print_text(best_cycleword, best_cycleword_length);
+	print_text(job->best_cycleword, job->best_cycleword_len);
 	printf("\n");
-	print_text(best_decrypted, cipher_len);
+	print_text(job->best_decrypted, job->cipher_len);
 	printf("\n\n");
 
+	if (job->top.n_solutions > 1) {
+		print_top_solutions(job);
+		printf("\n");
+	}
+
 	// K4-specific checks for BERLIN, CLOCK, EAST, NORTH, BERLINCLOCK and EASTNORTHEAST. 
 
 #if KRYPTOS
-	bool berlin_present = false, clock_present = false, east_present = false, north_present = false, 
-		berlinclock_present = false, eastnortheast_present = false; 
-
 	if (strstr(plaintext_string, "BERLIN") != NULL) {
-		berlin_present = true;
 		printf("**** \'BERLIN\' PRESENT!!! ****\n");
 	}
 
 	if (strstr(plaintext_string, "CLOCK") != NULL) {
-		clock_present = true;
 		printf("**** \'CLOCK\' PRESENT!!! ****\n");
 	}
 
 	if (strstr(plaintext_string, "EAST") != NULL) {
-		east_present = true;
 		printf("**** \'EAST\' PRESENT!!! ****\n");
 	}
 
 	if (strstr(plaintext_string, "NORTH") != NULL) {
-		north_present = true;
 		printf("**** \'NORTH\' PRESENT!!! ****\n");
 	}
 
 	if (strstr(plaintext_string, "BERLINCLOCK") != NULL) {
-		berlinclock_present = true;
 		for (i = 0; i < 1000; i++) {
 			printf("**** \'BERLINCLOCK\' PRESENT!!! ****");
 		}
 	}
 
 	if (strstr(plaintext_string, "EASTNORTHEAST") != NULL) {
-		eastnortheast_present = true;
 		for (i = 0; i < 1000; i++) {
 			printf("**** \'EASTNORTHEAST\' PRESENT!!! ****");
 		}
@@ -556,1750 +535,6138 @@ int main(int argc, char **argv) {
 
 	// Single line summary of results for subsequent filtering and analysis. 
 
-	if (dictionary_present_p) {
-		printf("\n\n>>> %.2f, %d, %d, %s, ", best_score, n_words_found, cipher_type, ciphertext_file);
+	printf("\n\n");
+	if (results_fp != NULL) {
+		write_result_record(results_fp, job);
 	} else {
-		printf("\n\n>>> %.2f, %d, %s, ", best_score, cipher_type, ciphertext_file);
+		print_summary_line(job);
 	}
-	print_text(cipher_indices, cipher_len);
-	printf(", ");
-	print_text(best_plaintext_keyword, ALPHABET_SIZE);
-	printf(", ");
-	print_text(best_ciphertext_keyword, ALPHABET_SIZE);
-	printf(", ");
-	print_text(best_cycleword, best_cycleword_length);
-	printf(", ");
-	print_text(best_decrypted, cipher_len);
 #if KRYPTOS
-	if (berlin_present) {
-		printf(", BERLIN");
-	}
-	if (clock_present) {
-		printf(", CLOCK");
-	}
-	if (east_present) {
-		printf(", EAST");
-	}
-	if (north_present) {
-		printf(", NORTH");
-	}
-	if (berlinclock_present) {
-		printf(", BERLINCLOCK");
-	}
-	if (eastnortheast_present) {
-		printf(", EASTNORTHEAST");
-	}
 	printf("\n\n");
 #endif
 
-	free(ngram_data);
+	if (settings.stats != NULL) {
+		write_stats_report(settings.stats, stats_file, &settings);
+	}
+
+	close_reporter(reporter, results_fp);
+	free(plaintext_string);
+	free_cipher_job(job);
+	free(job);
+	quagmire_context_free(context);
 
 	return 1;
 }
+#endif
 
 
 
-// Slippery stochastic shotgun restarted hill climber for Quagmire ciphers.
-
-double quagmire_shotgun_hill_climber(
-	int cipher_type, 
-	int cipher_indices[], int cipher_len, 
-	int crib_indices[], int crib_positions[], int n_cribs,
-	int cycleword_len, int plaintext_keyword_len, int ciphertext_keyword_len, 
-	int n_hill_climbs, int n_restarts,
-	float *ngram_data, int ngram_size,
-	int decrypted[MAX_CIPHER_LENGTH], int plaintext_keyword[ALPHABET_SIZE], 
-	int ciphertext_keyword[ALPHABET_SIZE], int cycleword[ALPHABET_SIZE],
-	double backtracking_probability, double keyword_permutation_probability, double slip_probability,
-	float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy, 
-	bool variant, bool beaufort, bool verbose) {
-
-	int i, j, n, indx, n_iterations, n_backtracks, n_explore, n_contradictions,
-		local_plaintext_keyword_state[ALPHABET_SIZE], current_plaintext_keyword_state[ALPHABET_SIZE], 
-		local_ciphertext_keyword_state[ALPHABET_SIZE], current_ciphertext_keyword_state[ALPHABET_SIZE], 
-		best_plaintext_keyword_state[ALPHABET_SIZE], best_ciphertext_keyword_state[ALPHABET_SIZE],
-		local_cycleword_state[MAX_CYCLEWORD_LEN], current_cycleword_state[MAX_CYCLEWORD_LEN], 
-		best_cycleword_state[MAX_CYCLEWORD_LEN];
-	double start_time, elapsed, n_iter_per_sec, best_score, local_score, current_score, ioc, chi, 
-		entropy_score;
-	bool perturbate_keyword_p, contradiction;
-
-	if (cipher_type == VIGENERE) {
-		cycleword_len = ALPHABET_SIZE;
-	}
+// Load the models of the library interface. Returns NULL (having printed the error) if 
+// they cannot be. 
 
-	n_iterations = 0;
-	n_backtracks = 0;
-	n_explore = 0;
-	n_contradictions = 0;
-	start_time = clock();
+quagmire_context *quagmire_context_create(const char *ngram_file, int ngram_size, 
+	const char *ngram_table_name, const char *dictionary_file, bool verbose) {
 
-	best_score = 0.;
+	quagmire_context *context;
+	int backend = NGRAM_FLOAT;
 
-	for (n = 0; n < n_restarts; n++) {
+	if (ngram_size < 1 || ngram_size > MAX_NGRAM_SIZE) {
+		printf("\n\nERROR: -ngramsize must be between 1 and %d.\n\n", MAX_NGRAM_SIZE);
+		return NULL;
+	}
 
-		if (best_score > 0. && frand() < backtracking_probability) {
-			// Backtrack to best state. 
-			n_backtracks += 1;
-			current_score = best_score;
-			vec_copy(best_plaintext_keyword_state, current_plaintext_keyword_state, ALPHABET_SIZE);
-			vec_copy(best_ciphertext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
-			vec_copy(best_cycleword_state, current_cycleword_state, cycleword_len);
-		} else {
-			// Initialise random state.
-			switch (cipher_type) {
-				case VIGENERE:
-					random_keyword(current_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len);
-					vec_copy(current_plaintext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
-					vec_copy(current_plaintext_keyword_state, current_cycleword_state, ALPHABET_SIZE);
-					break ;
-				case QUAGMIRE_1:
-					random_keyword(current_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len);
-					straight_alphabet(current_ciphertext_keyword_state, ALPHABET_SIZE);
-					random_cycleword(current_cycleword_state, ALPHABET_SIZE, cycleword_len);
-					break ;
-				case QUAGMIRE_2:
-					straight_alphabet(current_plaintext_keyword_state, ALPHABET_SIZE);
-					random_keyword(current_ciphertext_keyword_state, ALPHABET_SIZE, ciphertext_keyword_len);
-					random_cycleword(current_cycleword_state, ALPHABET_SIZE, cycleword_len);
-					break ;
-				case QUAGMIRE_3:
-					random_keyword(current_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len);
-					vec_copy(current_plaintext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
-					random_cycleword(current_cycleword_state, ALPHABET_SIZE, cycleword_len);
-					break ;
-				case QUAGMIRE_4:
-					random_keyword(current_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len);
-					random_keyword(current_ciphertext_keyword_state, ALPHABET_SIZE, ciphertext_keyword_len);
-					random_cycleword(current_cycleword_state, ALPHABET_SIZE, cycleword_len);
-					break ;
-				case BEAUFORT:
-					plaintext_keyword_len = ALPHABET_SIZE;
-					ciphertext_keyword_len = ALPHABET_SIZE;
-					for (i = 0; i < ALPHABET_SIZE; i++) current_plaintext_keyword_state[i] = i;
-					vec_copy(current_plaintext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
-					random_cycleword(current_cycleword_state, ALPHABET_SIZE, cycleword_len);
-					break ; 
-			}
+	// Dense tables hold every possible n-gram, so beyond MAX_DENSE_NGRAM_SIZE only the 
+	// observed n-grams are stored. 
 
-			current_score = state_score(cipher_indices, cipher_len, 
-				crib_indices, crib_positions, n_cribs, 
-				current_plaintext_keyword_state, current_ciphertext_keyword_state, 
-				current_cycleword_state, cycleword_len, 
-				variant, beaufort, 
-				decrypted, ngram_data, ngram_size,
-				weight_ngram, weight_crib, weight_ioc, weight_entropy);
+	if (ngram_table_name == NULL) {
+		backend = ngram_size <= 5 ? NGRAM_FLOAT : NGRAM_SPARSE;
+	} else {
+		backend = ngram_backend((char *) ngram_table_name);
+		if (backend == INACTIVE) {
+			printf("\n\nERROR: unknown n-gram table '%s' (float, uint16, uint8 or sparse).\n\n", ngram_table_name);
+			return NULL;
 		}
-
-// The following are K4-specific hacks to manually set the ciphertext and plaintext keywords to KRYPTOS and/or KOMITET.
-
-#if 0
-	current_plaintext_keyword_state[0] = 0;
-	current_plaintext_keyword_state[1] = 13;
-	current_plaintext_keyword_state[2] = 6;
-	current_plaintext_keyword_state[3] = 11;
-	current_plaintext_keyword_state[4] = 4;
-	current_plaintext_keyword_state[5] = 18;
-	current_plaintext_keyword_state[6] = 1;
-	current_plaintext_keyword_state[7] = 2;
-	current_plaintext_keyword_state[8] = 3;
-	current_plaintext_keyword_state[9] = 5;
-	current_plaintext_keyword_state[10] = 7;
-	current_plaintext_keyword_state[11] = 8;
-	current_plaintext_keyword_state[12] = 9;
-	current_plaintext_keyword_state[13] = 10;
-	current_plaintext_keyword_state[14] = 12;
-	current_plaintext_keyword_state[15] = 14;
-	current_plaintext_keyword_state[16] = 15;
-	current_plaintext_keyword_state[17] = 16;
-	current_plaintext_keyword_state[18] = 17;
-	current_plaintext_keyword_state[19] = 19;
-	current_plaintext_keyword_state[20] = 20;
-	current_plaintext_keyword_state[21] = 21;
-	current_plaintext_keyword_state[22] = 22;
-	current_plaintext_keyword_state[23] = 23;
-	current_plaintext_keyword_state[24] = 24;
-	current_plaintext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(current_plaintext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
 	}
-#endif
 
-#if 0
-	current_ciphertext_keyword_state[0] = 19;
-	current_ciphertext_keyword_state[1] = 8;
-	current_ciphertext_keyword_state[2] = 13;
-	current_ciphertext_keyword_state[3] = 3;
-	current_ciphertext_keyword_state[4] = 4;
-	current_ciphertext_keyword_state[5] = 17;
-	current_ciphertext_keyword_state[6] = 0;
-	current_ciphertext_keyword_state[7] = 1;
-	current_ciphertext_keyword_state[8] = 2;
-	current_ciphertext_keyword_state[9] = 5;
-	current_ciphertext_keyword_state[10] = 6;
-	current_ciphertext_keyword_state[11] = 7;
-	current_ciphertext_keyword_state[12] = 9;
-	current_ciphertext_keyword_state[13] = 10;
-	current_ciphertext_keyword_state[14] = 11;
-	current_ciphertext_keyword_state[15] = 12;
-	current_ciphertext_keyword_state[16] = 14;
-	current_ciphertext_keyword_state[17] = 15;
-	current_ciphertext_keyword_state[18] = 16;
-	current_ciphertext_keyword_state[19] = 18;
-	current_ciphertext_keyword_state[20] = 20;
-	current_ciphertext_keyword_state[21] = 21;
-	current_ciphertext_keyword_state[22] = 22;
-	current_ciphertext_keyword_state[23] = 23;
-	current_ciphertext_keyword_state[24] = 24;
-	current_ciphertext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(current_ciphertext_keyword_state, current_plaintext_keyword_state, ALPHABET_SIZE);
+	if (backend != NGRAM_SPARSE && ngram_size > MAX_DENSE_NGRAM_SIZE) {
+		printf("\n\nERROR: dense n-gram tables are limited to n <= %d, use -ngramtable sparse.\n\n", 
+			MAX_DENSE_NGRAM_SIZE);
+		return NULL;
 	}
-#endif
 
-#if KOMITET_PT
-	// KOMITE[T]
-	current_plaintext_keyword_state[0] = 10;
-	current_plaintext_keyword_state[1] = 14;
-	current_plaintext_keyword_state[2] = 12;
-	current_plaintext_keyword_state[3] = 8;
-	current_plaintext_keyword_state[4] = 19;
-	current_plaintext_keyword_state[5] = 4;
-	current_plaintext_keyword_state[6] = 0;
-	current_plaintext_keyword_state[7] = 1;
-	current_plaintext_keyword_state[8] = 2;
-	current_plaintext_keyword_state[9] = 3;
-	current_plaintext_keyword_state[10] = 5;
-	current_plaintext_keyword_state[11] = 6;
-	current_plaintext_keyword_state[12] = 7;
-	current_plaintext_keyword_state[13] = 9;
-	current_plaintext_keyword_state[14] = 11;
-	current_plaintext_keyword_state[15] = 13;
-	current_plaintext_keyword_state[16] = 15;
-	current_plaintext_keyword_state[17] = 16;
-	current_plaintext_keyword_state[18] = 17;
-	current_plaintext_keyword_state[19] = 18;
-	current_plaintext_keyword_state[20] = 20;
-	current_plaintext_keyword_state[21] = 21;
-	current_plaintext_keyword_state[22] = 22;
-	current_plaintext_keyword_state[23] = 23;
-	current_plaintext_keyword_state[24] = 24;
-	current_plaintext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(current_plaintext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
+	if (! file_exists((char *) ngram_file)) {
+		printf("\nERROR: missing file '%s'\n", ngram_file);
+  		return NULL;
 	}
-#endif
 
-#if KOMITET_CT
-	// KOMITE[T]
-	current_ciphertext_keyword_state[0] = 10;
-	current_ciphertext_keyword_state[1] = 14;
-	current_ciphertext_keyword_state[2] = 12;
-	current_ciphertext_keyword_state[3] = 8;
-	current_ciphertext_keyword_state[4] = 19;
-	current_ciphertext_keyword_state[5] = 4;
-	current_ciphertext_keyword_state[6] = 0;
-	current_ciphertext_keyword_state[7] = 1;
-	current_ciphertext_keyword_state[8] = 2;
-	current_ciphertext_keyword_state[9] = 3;
-	current_ciphertext_keyword_state[10] = 5;
-	current_ciphertext_keyword_state[11] = 6;
-	current_ciphertext_keyword_state[12] = 7;
-	current_ciphertext_keyword_state[13] = 9;
-	current_ciphertext_keyword_state[14] = 11;
-	current_ciphertext_keyword_state[15] = 13;
-	current_ciphertext_keyword_state[16] = 15;
-	current_ciphertext_keyword_state[17] = 16;
-	current_ciphertext_keyword_state[18] = 17;
-	current_ciphertext_keyword_state[19] = 18;
-	current_ciphertext_keyword_state[20] = 20;
-	current_ciphertext_keyword_state[21] = 21;
-	current_ciphertext_keyword_state[22] = 22;
-	current_ciphertext_keyword_state[23] = 23;
-	current_ciphertext_keyword_state[24] = 24;
-	current_ciphertext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(current_ciphertext_keyword_state, current_plaintext_keyword_state, ALPHABET_SIZE);
+	if (dictionary_file != NULL && ! file_exists((char *) dictionary_file)) {
+		printf("\nERROR: missing file '%s'\n", dictionary_file);
+  		return NULL;
 	}
-#endif
 
+	context = malloc(sizeof(quagmire_context));
+	context->verbose = verbose;
+	context->dictionary_present = false;
+	context->keywords_present = false;
 
-#if KRYPTOS_PT || KRYPTOS_PT_SCRAMBLE
-	// KRYPTOS
-	current_plaintext_keyword_state[0] = 10;
-	current_plaintext_keyword_state[1] = 17;
-	current_plaintext_keyword_state[2] = 24;
-	current_plaintext_keyword_state[3] = 15;
-	current_plaintext_keyword_state[4] = 19;
-	current_plaintext_keyword_state[5] = 14;
-	current_plaintext_keyword_state[6] = 18;
-	current_plaintext_keyword_state[7] = 0; 
-	current_plaintext_keyword_state[8] = 1;
-	current_plaintext_keyword_state[9] = 2;
-	current_plaintext_keyword_state[10] = 3;
-	current_plaintext_keyword_state[11] = 4;
-	current_plaintext_keyword_state[12] = 5; 
-	current_plaintext_keyword_state[13] = 6; 
-	current_plaintext_keyword_state[14] = 7; 
-	current_plaintext_keyword_state[15] = 8;
-	current_plaintext_keyword_state[16] = 9;
-	current_plaintext_keyword_state[17] = 11; 
-	current_plaintext_keyword_state[18] = 12;
-	current_plaintext_keyword_state[19] = 13;
-	current_plaintext_keyword_state[20] = 16;
-	current_plaintext_keyword_state[21] = 20;
-	current_plaintext_keyword_state[22] = 21; 
-	current_plaintext_keyword_state[23] = 22;
-	current_plaintext_keyword_state[24] = 23; 
-	current_plaintext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(current_plaintext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
-	}
-#endif
+	load_ngrams(&context->ngrams, (char *) ngram_file, ngram_size, backend, verbose);
 
-#if KRYPTOS_CT
-	// KRYPTOS
-	current_ciphertext_keyword_state[0] = 10;
-	current_ciphertext_keyword_state[1] = 17;
-	current_ciphertext_keyword_state[2] = 24;
-	current_ciphertext_keyword_state[3] = 15;
-	current_ciphertext_keyword_state[4] = 19;
-	current_ciphertext_keyword_state[5] = 14;
-	current_ciphertext_keyword_state[6] = 18;
-	current_ciphertext_keyword_state[7] = 0; 
-	current_ciphertext_keyword_state[8] = 1;
-	current_ciphertext_keyword_state[9] = 2;
-	current_ciphertext_keyword_state[10] = 3;
-	current_ciphertext_keyword_state[11] = 4;
-	current_ciphertext_keyword_state[12] = 5; 
-	current_ciphertext_keyword_state[13] = 6; 
-	current_ciphertext_keyword_state[14] = 7; 
-	current_ciphertext_keyword_state[15] = 8;
-	current_ciphertext_keyword_state[16] = 9;
-	current_ciphertext_keyword_state[17] = 11; 
-	current_ciphertext_keyword_state[18] = 12;
-	current_ciphertext_keyword_state[19] = 13;
-	current_ciphertext_keyword_state[20] = 16;
-	current_ciphertext_keyword_state[21] = 20;
-	current_ciphertext_keyword_state[22] = 21; 
-	current_ciphertext_keyword_state[23] = 22;
-	current_ciphertext_keyword_state[24] = 23; 
-	current_ciphertext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(current_ciphertext_keyword_state, current_plaintext_keyword_state, ALPHABET_SIZE);
+#if DICTIONARY
+	if (dictionary_file != NULL) {
+		load_dictionary((char *) dictionary_file, &context->dict, verbose);
+		context->dictionary_present = true;
 	}
 #endif
 
-#if SOLUBLE_PT
-	// SOLUB[L]E
-	current_plaintext_keyword_state[0] = 18;
-	current_plaintext_keyword_state[1] = 14;
-	current_plaintext_keyword_state[2] = 11;
-	current_plaintext_keyword_state[3] = 20;
-	current_plaintext_keyword_state[4] = 1;
-	current_plaintext_keyword_state[5] = 4;
-	current_plaintext_keyword_state[6] = 0;
-	current_plaintext_keyword_state[7] = 2; 
-	current_plaintext_keyword_state[8] = 3;
-	current_plaintext_keyword_state[9] = 5;
-	current_plaintext_keyword_state[10] = 6;
-	current_plaintext_keyword_state[11] = 7;
-	current_plaintext_keyword_state[12] = 8; 
-	current_plaintext_keyword_state[13] = 9; 
-	current_plaintext_keyword_state[14] = 10; 
-	current_plaintext_keyword_state[15] = 12;
-	current_plaintext_keyword_state[16] = 13;
-	current_plaintext_keyword_state[17] = 15; 
-	current_plaintext_keyword_state[18] = 16;
-	current_plaintext_keyword_state[19] = 17;
-	current_plaintext_keyword_state[20] = 19;
-	current_plaintext_keyword_state[21] = 21;
-	current_plaintext_keyword_state[22] = 22; 
-	current_plaintext_keyword_state[23] = 23;
-	current_plaintext_keyword_state[24] = 24; 
-	current_plaintext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(current_plaintext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
+	return context;
+}
+
+
+
+void quagmire_context_free(quagmire_context *context) {
+
+	if (context == NULL) {
+		return ;
 	}
-#endif
 
-#if SOLUBLE_CT
-	// SOLUB[L]E
-	current_ciphertext_keyword_state[0] = 18;
-	current_ciphertext_keyword_state[1] = 14;
-	current_ciphertext_keyword_state[2] = 11;
-	current_ciphertext_keyword_state[3] = 20;
-	current_ciphertext_keyword_state[4] = 1;
-	current_ciphertext_keyword_state[5] = 4;
-	current_ciphertext_keyword_state[6] = 0;
-	current_ciphertext_keyword_state[7] = 2; 
-	current_ciphertext_keyword_state[8] = 3;
-	current_ciphertext_keyword_state[9] = 5;
-	current_ciphertext_keyword_state[10] = 6;
-	current_ciphertext_keyword_state[11] = 7;
-	current_ciphertext_keyword_state[12] = 8; 
-	current_ciphertext_keyword_state[13] = 9; 
-	current_ciphertext_keyword_state[14] = 10; 
-	current_ciphertext_keyword_state[15] = 12;
-	current_ciphertext_keyword_state[16] = 13;
-	current_ciphertext_keyword_state[17] = 15; 
-	current_ciphertext_keyword_state[18] = 16;
-	current_ciphertext_keyword_state[19] = 17;
-	current_ciphertext_keyword_state[20] = 19;
-	current_ciphertext_keyword_state[21] = 21;
-	current_ciphertext_keyword_state[22] = 22; 
-	current_ciphertext_keyword_state[23] = 23;
-	current_ciphertext_keyword_state[24] = 24; 
-	current_ciphertext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(current_ciphertext_keyword_state, current_plaintext_keyword_state, ALPHABET_SIZE);
+	if (context->dictionary_present) {
+		free_dictionary(&context->dict);
 	}
-#endif
+	if (context->keywords_present) {
+		free_keyword_index(&context->keywords);
+	}
+	free_ngrams(&context->ngrams);
+	free(context);
 
-		perturbate_keyword_p = true;
+	return ;
+}
 
-		for (i = 0; i < n_hill_climbs; i++) {
-				
-			n_iterations += 1;
 
-			// perturbate.
-			vec_copy(current_plaintext_keyword_state, local_plaintext_keyword_state, ALPHABET_SIZE);
-			vec_copy(current_ciphertext_keyword_state, local_ciphertext_keyword_state, ALPHABET_SIZE);
-			vec_copy(current_cycleword_state, local_cycleword_state, cycleword_len);
 
-			if (cipher_type != BEAUFORT && (perturbate_keyword_p || cipher_type == VIGENERE || frand() < keyword_permutation_probability)) {
-				switch (cipher_type) {
-					case VIGENERE:
-						perturbate_keyword(local_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len);
-						vec_copy(local_plaintext_keyword_state, local_ciphertext_keyword_state, ALPHABET_SIZE);	
-						vec_copy(local_plaintext_keyword_state, local_cycleword_state, ALPHABET_SIZE);
-						break ; 
-					case QUAGMIRE_1:
-						perturbate_keyword(local_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len);
-						break ;
-					case QUAGMIRE_2:
-						perturbate_keyword(local_ciphertext_keyword_state, ALPHABET_SIZE, ciphertext_keyword_len);
-						break ;
-					case QUAGMIRE_3:
-						perturbate_keyword(local_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len);
-						vec_copy(local_plaintext_keyword_state, local_ciphertext_keyword_state, ALPHABET_SIZE);
-						break ;
-					case QUAGMIRE_4:
-						if (frand() < 0.5) {
-							perturbate_keyword(local_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len);
-						} else {
-							perturbate_keyword(local_ciphertext_keyword_state, ALPHABET_SIZE, ciphertext_keyword_len);
-						}
-						break ;
-				}
-			} else {
-				perturbate_cycleword(local_cycleword_state, ALPHABET_SIZE, cycleword_len);
-			}
+// Load the keyword list of -keywordsearch into a context (see load_keyword_index), 
+// replacing any loaded before. Returns false (having printed the error) if it cannot be. 
 
+bool quagmire_context_load_keywords(quagmire_context *context, const char *keywords) {
 
-// The following are K4-specific hacks to manually set the ciphertext and plaintext keywords to KRYPTOS and/or KOMITET.
+	keyword_index index;
 
-#if 0
-	local_plaintext_keyword_state[0] = 0;
-	local_plaintext_keyword_state[1] = 13;
-	local_plaintext_keyword_state[2] = 6;
-	local_plaintext_keyword_state[3] = 11;
-	local_plaintext_keyword_state[4] = 4;
-	local_plaintext_keyword_state[5] = 18;
-	local_plaintext_keyword_state[6] = 1;
-	local_plaintext_keyword_state[7] = 2;
-	local_plaintext_keyword_state[8] = 3;
-	local_plaintext_keyword_state[9] = 5;
-	local_plaintext_keyword_state[10] = 7;
-	local_plaintext_keyword_state[11] = 8;
-	local_plaintext_keyword_state[12] = 9;
-	local_plaintext_keyword_state[13] = 10;
-	local_plaintext_keyword_state[14] = 12;
-	local_plaintext_keyword_state[15] = 14;
-	local_plaintext_keyword_state[16] = 15;
-	local_plaintext_keyword_state[17] = 16;
-	local_plaintext_keyword_state[18] = 17;
-	local_plaintext_keyword_state[19] = 19;
-	local_plaintext_keyword_state[20] = 20;
-	local_plaintext_keyword_state[21] = 21;
-	local_plaintext_keyword_state[22] = 22;
-	local_plaintext_keyword_state[23] = 23;
-	local_plaintext_keyword_state[24] = 24;
-	local_plaintext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(local_plaintext_keyword_state, local_ciphertext_keyword_state, ALPHABET_SIZE);
+	if (! load_keyword_index((char *) keywords, &index, context->verbose)) {
+		return false;
 	}
-#endif
-
-#if 0
-	local_ciphertext_keyword_state[0] = 19;
-	local_ciphertext_keyword_state[1] = 8;
-	local_ciphertext_keyword_state[2] = 13;
-	local_ciphertext_keyword_state[3] = 3;
-	local_ciphertext_keyword_state[4] = 4;
-	local_ciphertext_keyword_state[5] = 17;
-	local_ciphertext_keyword_state[6] = 0;
-	local_ciphertext_keyword_state[7] = 1;
-	local_ciphertext_keyword_state[8] = 2;
-	local_ciphertext_keyword_state[9] = 5;
-	local_ciphertext_keyword_state[10] = 6;
-	local_ciphertext_keyword_state[11] = 7;
-	local_ciphertext_keyword_state[12] = 9;
-	local_ciphertext_keyword_state[13] = 10;
-	local_ciphertext_keyword_state[14] = 11;
-	local_ciphertext_keyword_state[15] = 12;
-	local_ciphertext_keyword_state[16] = 14;
-	local_ciphertext_keyword_state[17] = 15;
-	local_ciphertext_keyword_state[18] = 16;
-	local_ciphertext_keyword_state[19] = 18;
-	local_ciphertext_keyword_state[20] = 20;
-	local_ciphertext_keyword_state[21] = 21;
-	local_ciphertext_keyword_state[22] = 22;
-	local_ciphertext_keyword_state[23] = 23;
-	local_ciphertext_keyword_state[24] = 24;
-	local_ciphertext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(local_ciphertext_keyword_state, local_plaintext_keyword_state, ALPHABET_SIZE);
-	}	
-#endif
 
-#if KOMITET_PT
-	// KOMITE[T]
-	local_plaintext_keyword_state[0] = 10;
-	local_plaintext_keyword_state[1] = 14;
-	local_plaintext_keyword_state[2] = 12;
-	local_plaintext_keyword_state[3] = 8;
-	local_plaintext_keyword_state[4] = 19;
-	local_plaintext_keyword_state[5] = 4;
-	local_plaintext_keyword_state[6] = 0;
-	local_plaintext_keyword_state[7] = 1;
-	local_plaintext_keyword_state[8] = 2;
-	local_plaintext_keyword_state[9] = 3;
-	local_plaintext_keyword_state[10] = 5;
-	local_plaintext_keyword_state[11] = 6;
-	local_plaintext_keyword_state[12] = 7;
-	local_plaintext_keyword_state[13] = 9;
-	local_plaintext_keyword_state[14] = 11;
-	local_plaintext_keyword_state[15] = 13;
-	local_plaintext_keyword_state[16] = 15;
-	local_plaintext_keyword_state[17] = 16;
-	local_plaintext_keyword_state[18] = 17;
-	local_plaintext_keyword_state[19] = 18;
-	local_plaintext_keyword_state[20] = 20;
-	local_plaintext_keyword_state[21] = 21;
-	local_plaintext_keyword_state[22] = 22;
-	local_plaintext_keyword_state[23] = 23;
-	local_plaintext_keyword_state[24] = 24;
-	local_plaintext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(local_plaintext_keyword_state, local_ciphertext_keyword_state, ALPHABET_SIZE);
+	if (context->keywords_present) {
+		free_keyword_index(&context->keywords);
 	}
-#endif
-
-#if KOMITET_CT
-	// KOMITE[T]
-	local_ciphertext_keyword_state[0] = 10;
-	local_ciphertext_keyword_state[1] = 14;
-	local_ciphertext_keyword_state[2] = 12;
-	local_ciphertext_keyword_state[3] = 8;
-	local_ciphertext_keyword_state[4] = 19;
-	local_ciphertext_keyword_state[5] = 4;
-	local_ciphertext_keyword_state[6] = 0;
-	local_ciphertext_keyword_state[7] = 1;
-	local_ciphertext_keyword_state[8] = 2;
-	local_ciphertext_keyword_state[9] = 3;
-	local_ciphertext_keyword_state[10] = 5;
-	local_ciphertext_keyword_state[11] = 6;
-	local_ciphertext_keyword_state[12] = 7;
-	local_ciphertext_keyword_state[13] = 9;
-	local_ciphertext_keyword_state[14] = 11;
-	local_ciphertext_keyword_state[15] = 13;
-	local_ciphertext_keyword_state[16] = 15;
-	local_ciphertext_keyword_state[17] = 16;
-	local_ciphertext_keyword_state[18] = 17;
-	local_ciphertext_keyword_state[19] = 18;
-	local_ciphertext_keyword_state[20] = 20;
-	local_ciphertext_keyword_state[21] = 21;
-	local_ciphertext_keyword_state[22] = 22;
-	local_ciphertext_keyword_state[23] = 23;
-	local_ciphertext_keyword_state[24] = 24;
-	local_ciphertext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(local_ciphertext_keyword_state, local_plaintext_keyword_state, ALPHABET_SIZE);
-	}
-#endif
+	context->keywords = index;
+	context->keywords_present = true;
 
+	return true;
+}
 
-#if KRYPTOS_PT
-	// KRYPTOS
-	local_plaintext_keyword_state[0] = 10;
-	local_plaintext_keyword_state[1] = 17;
-	local_plaintext_keyword_state[2] = 24;
-	local_plaintext_keyword_state[3] = 15;
-	local_plaintext_keyword_state[4] = 19;
-	local_plaintext_keyword_state[5] = 14;
-	local_plaintext_keyword_state[6] = 18;
-	local_plaintext_keyword_state[7] = 0; 
-	local_plaintext_keyword_state[8] = 1;
-	local_plaintext_keyword_state[9] = 2;
-	local_plaintext_keyword_state[10] = 3;
-	local_plaintext_keyword_state[11] = 4;
-	local_plaintext_keyword_state[12] = 5; 
-	local_plaintext_keyword_state[13] = 6; 
-	local_plaintext_keyword_state[14] = 7; 
-	local_plaintext_keyword_state[15] = 8;
-	local_plaintext_keyword_state[16] = 9;
-	local_plaintext_keyword_state[17] = 11; 
-	local_plaintext_keyword_state[18] = 12;
-	local_plaintext_keyword_state[19] = 13;
-	local_plaintext_keyword_state[20] = 16;
-	local_plaintext_keyword_state[21] = 20;
-	local_plaintext_keyword_state[22] = 21; 
-	local_plaintext_keyword_state[23] = 22;
-	local_plaintext_keyword_state[24] = 23; 
-	local_plaintext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(local_plaintext_keyword_state, local_ciphertext_keyword_state, ALPHABET_SIZE);
-	}
-#endif
 
-#if KRYPTOS_CT
-	// KRYPTOS
-	local_ciphertext_keyword_state[0] = 10;
-	local_ciphertext_keyword_state[1] = 17;
-	local_ciphertext_keyword_state[2] = 24;
-	local_ciphertext_keyword_state[3] = 15;
-	local_ciphertext_keyword_state[4] = 19;
-	local_ciphertext_keyword_state[5] = 14;
-	local_ciphertext_keyword_state[6] = 18;
-	local_ciphertext_keyword_state[7] = 0; 
-	local_ciphertext_keyword_state[8] = 1;
-	local_ciphertext_keyword_state[9] = 2;
-	local_ciphertext_keyword_state[10] = 3;
-	local_ciphertext_keyword_state[11] = 4;
-	local_ciphertext_keyword_state[12] = 5; 
-	local_ciphertext_keyword_state[13] = 6; 
-	local_ciphertext_keyword_state[14] = 7; 
-	local_ciphertext_keyword_state[15] = 8;
-	local_ciphertext_keyword_state[16] = 9;
-	local_ciphertext_keyword_state[17] = 11; 
-	local_ciphertext_keyword_state[18] = 12;
-	local_ciphertext_keyword_state[19] = 13;
-	local_ciphertext_keyword_state[20] = 16;
-	local_ciphertext_keyword_state[21] = 20;
-	local_ciphertext_keyword_state[22] = 21; 
-	local_ciphertext_keyword_state[23] = 22;
-	local_ciphertext_keyword_state[24] = 23; 
-	local_ciphertext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(local_ciphertext_keyword_state, local_plaintext_keyword_state, ALPHABET_SIZE);
-	}
-#endif
 
-#if SOLUBLE_PT
-	// SOLUB[L]E
-	local_plaintext_keyword_state[0] = 18;
-	local_plaintext_keyword_state[1] = 14;
-	local_plaintext_keyword_state[2] = 11;
-	local_plaintext_keyword_state[3] = 20;
-	local_plaintext_keyword_state[4] = 1;
-	local_plaintext_keyword_state[5] = 4;
-	local_plaintext_keyword_state[6] = 0;
-	local_plaintext_keyword_state[7] = 2; 
-	local_plaintext_keyword_state[8] = 3;
-	local_plaintext_keyword_state[9] = 5;
-	local_plaintext_keyword_state[10] = 6;
-	local_plaintext_keyword_state[11] = 7;
-	local_plaintext_keyword_state[12] = 8; 
-	local_plaintext_keyword_state[13] = 9; 
-	local_plaintext_keyword_state[14] = 10; 
-	local_plaintext_keyword_state[15] = 12;
-	local_plaintext_keyword_state[16] = 13;
-	local_plaintext_keyword_state[17] = 15; 
-	local_plaintext_keyword_state[18] = 16;
-	local_plaintext_keyword_state[19] = 17;
-	local_plaintext_keyword_state[20] = 19;
-	local_plaintext_keyword_state[21] = 21;
-	local_plaintext_keyword_state[22] = 22; 
-	local_plaintext_keyword_state[23] = 23;
-	local_plaintext_keyword_state[24] = 24; 
-	local_plaintext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(local_plaintext_keyword_state, local_ciphertext_keyword_state, ALPHABET_SIZE);
-	}
-#endif
+// Point the settings at the models of a context. 
 
-#if SOLUBLE_CT
-	// SOLUB[L]E
-	local_ciphertext_keyword_state[0] = 18;
-	local_ciphertext_keyword_state[1] = 14;
-	local_ciphertext_keyword_state[2] = 11;
-	local_ciphertext_keyword_state[3] = 20;
-	local_ciphertext_keyword_state[4] = 1;
-	local_ciphertext_keyword_state[5] = 4;
-	local_ciphertext_keyword_state[6] = 0;
-	local_ciphertext_keyword_state[7] = 2; 
-	local_ciphertext_keyword_state[8] = 3;
-	local_ciphertext_keyword_state[9] = 5;
-	local_ciphertext_keyword_state[10] = 6;
-	local_ciphertext_keyword_state[11] = 7;
-	local_ciphertext_keyword_state[12] = 8; 
-	local_ciphertext_keyword_state[13] = 9; 
-	local_ciphertext_keyword_state[14] = 10; 
-	local_ciphertext_keyword_state[15] = 12;
-	local_ciphertext_keyword_state[16] = 13;
-	local_ciphertext_keyword_state[17] = 15; 
-	local_ciphertext_keyword_state[18] = 16;
-	local_ciphertext_keyword_state[19] = 17;
-	local_ciphertext_keyword_state[20] = 19;
-	local_ciphertext_keyword_state[21] = 21;
-	local_ciphertext_keyword_state[22] = 22; 
-	local_ciphertext_keyword_state[23] = 23;
-	local_ciphertext_keyword_state[24] = 24; 
-	local_ciphertext_keyword_state[25] = 25;
-
-	if (cipher_type == VIGENERE || cipher_type == BEAUFORT || cipher_type == QUAGMIRE_3) {
-		vec_copy(local_ciphertext_keyword_state, local_plaintext_keyword_state, ALPHABET_SIZE);
-	}
-#endif
+void quagmire_context_settings(quagmire_context *context, solver_settings *settings) {
 
-			if (cipher_type != VIGENERE && cipher_type != BEAUFORT) {
-				perturbate_keyword_p = false;
-				contradiction = constrain_cycleword(cipher_indices, cipher_len, crib_indices, 
-					crib_positions, n_cribs, 
-					local_plaintext_keyword_state, local_ciphertext_keyword_state, 
-					local_cycleword_state, cycleword_len, variant, verbose);
+	settings->ngram_size = context->ngrams.ngram_size;
+	settings->ngram_data = &context->ngrams;
+	settings->dict = context->dictionary_present ? &context->dict : NULL;
+	settings->keywords = context->keywords_present ? &context->keywords : NULL;
 
-				if (contradiction) {
-					// Cycleword contradiction - must perturbate keyword(s). 
-					n_contradictions += 1; 
-					perturbate_keyword_p = true; 
-				}
-			}
+	return ;
+}
 
-			// Compute score. 
-			local_score = state_score(cipher_indices, cipher_len, 
-				crib_indices, crib_positions, n_cribs, 
-				local_plaintext_keyword_state, local_ciphertext_keyword_state, 
-				local_cycleword_state, cycleword_len, 
-				variant, beaufort, 
-				decrypted, ngram_data, ngram_size,
-				weight_ngram, weight_crib, weight_ioc, weight_entropy);
 
-#if 0
-			printf("\nlocal_score = %.4f\n", local_score);
-			print_text(decrypted, cipher_len);
-			printf("\n");
-			print_text(local_plaintext_keyword_state, ALPHABET_SIZE);
-			printf("\n");
-			print_text(local_ciphertext_keyword_state, ALPHABET_SIZE);
-			printf("\n");
-			print_text(local_cycleword_state, cycleword_len);
-			printf("\n");
-#endif
 
-			if (local_score > current_score) {
-				// printf("improvement\n");
-				current_score = local_score;
-				vec_copy(local_plaintext_keyword_state, current_plaintext_keyword_state, ALPHABET_SIZE);
-				vec_copy(local_ciphertext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
-				vec_copy(local_cycleword_state, current_cycleword_state, cycleword_len);
-			} else if (frand() < slip_probability) {
-				// printf("exploring\n");
-				n_explore += 1;
-				current_score = local_score;
-				vec_copy(local_plaintext_keyword_state, current_plaintext_keyword_state, ALPHABET_SIZE);
-				vec_copy(local_ciphertext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
-				vec_copy(local_cycleword_state, current_cycleword_state, cycleword_len);
-			}
+// Solve a request of the library interface. Everything a search changes is on the 
+// stack or the heap of this call (and the generator is thread-local), so requests may 
+// be solved concurrently on one context. 
 
-			if (current_score > best_score) {
-				best_score = current_score;
-				vec_copy(current_plaintext_keyword_state, best_plaintext_keyword_state, ALPHABET_SIZE);
-				vec_copy(current_ciphertext_keyword_state, best_ciphertext_keyword_state, ALPHABET_SIZE);
-				vec_copy(current_cycleword_state, best_cycleword_state, cycleword_len);
-				if (verbose) {
+bool quagmire_solve(quagmire_context *context, quagmire_request *request, quagmire_result *result) {
 
-					if (variant) {
-						quagmire_encrypt(decrypted, cipher_indices, cipher_len, 
-							best_plaintext_keyword_state, best_ciphertext_keyword_state, 
-							best_cycleword_state, cycleword_len, beaufort);
-					} else {
-						quagmire_decrypt(decrypted, cipher_indices, cipher_len, 
-							best_plaintext_keyword_state, best_ciphertext_keyword_state, 
-							best_cycleword_state, cycleword_len, beaufort);
-					}
+	int i, n, argc = request->n_options;
+	char **argv = (char **) request->options, *plaintext_string;
+	cipher_options options;
+	solver_settings settings;
+	cipher_job *job;
+	progress_reporter *reporter = NULL;
+	uint64_t seed = 0;
+	bool seed_present = false, ok;
 
-					ioc = index_of_coincidence(decrypted, cipher_len);
-					chi = chi_squared(decrypted, cipher_len);
-					entropy_score = entropy(decrypted, cipher_len);
-
-					elapsed = ((double) clock() - start_time)/CLOCKS_PER_SEC;
-					n_iter_per_sec = ((double) n_iterations)/elapsed;
-
-					printf("\n%.2f\t[sec]\n", elapsed);
-					printf("%.0fK\t[it/sec]\n", 1.e-3*n_iter_per_sec);
-					printf("%d\t[backtracks]\n", n_backtracks);
-					printf("%d\t[restarts]\n", n);
-					printf("%d\t[iterations]\n", i);
-					printf("%d\t[slips]\n", n_explore);
-					printf("%.2f\t[contradiction pct]\n", ((double) n_contradictions)/n_iterations);
-					printf("%.4f\t[IOC]\n", ioc);
-					printf("%.4f\t[entropy]\n", entropy_score);
-					printf("%.2f\t[chi-squared]\n", chi);
-					printf("%.2f\t[score]\n", best_score);
-					print_text(best_plaintext_keyword_state, ALPHABET_SIZE);
-					printf("\n");
-					print_text(best_ciphertext_keyword_state, ALPHABET_SIZE);
-					printf("\n");
-					print_text(best_cycleword_state, cycleword_len);
-					printf("\n");
-
-					// Display Quagmire tablau. 
-					printf("\n");
-					for (i = 0; i < cycleword_len; i++) {
-						for (j = 0; j < ALPHABET_SIZE; j++) {
-							indx = (j + best_cycleword_state[i]) % ALPHABET_SIZE;
-							printf("%c", best_ciphertext_keyword_state[indx] + 'A');
-						}
-						printf("\n");
-					}
-					printf("\n");
+	default_cipher_options(&options);
+	default_solver_settings(&settings);
+	settings.verbose = context->verbose;
 
-					print_text(decrypted, cipher_len);
-					printf("\n");
-					fflush(stdout);
-				}
-			}
+	for (i = 0; i < argc; i++) {
+		n = parse_cipher_option(&options, argc, argv, i, false);
+		if (n == 0) {
+			n = parse_solver_option(&settings, argc, argv, i, false);
+		}
+		if (n == 0 && strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+			seed_present = true;
+			seed = strtoull(argv[i + 1], NULL, 10);
+			n = 2;
+		}
+		if (n == INACTIVE) {
+			return false;
+		} else if (n == 0) {
+			printf("\n\nERROR: unknown option '%s'\n\n", argv[i]);
+			return false;
 		}
+		i += n - 1;
 	}
 
-	vec_copy(best_plaintext_keyword_state, plaintext_keyword, ALPHABET_SIZE);
-	vec_copy(best_ciphertext_keyword_state, ciphertext_keyword, ALPHABET_SIZE);
-	vec_copy(best_cycleword_state, cycleword, cycleword_len);
-
-	if (variant) {
-		quagmire_encrypt(decrypted, cipher_indices, cipher_len, 
-						best_plaintext_keyword_state, best_ciphertext_keyword_state, 
-						best_cycleword_state, cycleword_len, beaufort);
-	} else {
-		quagmire_decrypt(decrypted, cipher_indices, cipher_len, 
-						best_plaintext_keyword_state, best_ciphertext_keyword_state, 
-						best_cycleword_state, cycleword_len, beaufort);
+	if (! check_cipher_options(&options) || ! check_solver_settings(&settings)) {
+		return false;
 	}
 
-	return best_score;
-}
-
-
-
-// Does the ciphertext trivially satisfy the cribs? For a given cycleword length, there 
-// should be a one-to-one mapping between the ciphertext and the plaintext. 
+	quagmire_context_settings(context, &settings);
+	seed_rand(seed_present ? seed : default_seed());
 
-bool cribs_satisfied_p(int cipher_indices[], int cipher_len, int crib_indices[], 
-	int crib_positions[], int n_cribs, int cycleword_len, bool verbose) {
+	job = malloc(sizeof(cipher_job));
+	snprintf(job->name, MAX_FILENAME_LEN, "ciphertext");
 
-	int i, j, k, ii, jj, total, column_length, ciphertext_column_indices[MAX_CIPHER_LENGTH], 
-		ciphertext_column[MAX_CIPHER_LENGTH], crib_frequencies[ALPHABET_SIZE][ALPHABET_SIZE];
+	if (settings.verbose) {
+		reporter = malloc(sizeof(progress_reporter));
+		progress_reporter_start(reporter, true, NULL);
+		settings.reporter = reporter;
+	}
 
-	// Check cribs are present. 
+	ok = load_cipher_job(job, (char *) request->ciphertext, &options, true, settings.verbose) 
+		&& solve_cipher(job, &settings);
+	close_reporter(reporter, NULL);
 
-	if (n_cribs == 0) {
-		return true;
+	if (! ok) {
+		free_cipher_job(job);
+		free(job);
+		return false;
 	}
 
-	for (j = 0; j < cycleword_len; j++) {
-
-		if (verbose) {
-			printf("\nCOLUMN = %d \n", j);
-		}
+	plaintext_string = text_string(job->best_decrypted, job->cipher_len);
 
-		// Extract column. 
+	result->score = job->best_score;
+	result->cipher_len = job->cipher_len;
+	result->cycleword_len = job->best_cycleword_len;
+	result->n_words_found = -1;
+#if DICTIONARY
+	if (settings.dict != NULL) {
+		result->n_words_found = find_dictionary_words(plaintext_string, settings.dict, false);
+	}
+#endif
 
-		k = 0;
-		while (cycleword_len*k + j < cipher_len) {
-			ciphertext_column_indices[k] = cycleword_len*k + j;
-			ciphertext_column[k] = cipher_indices[ciphertext_column_indices[k]];
-			k++;
-		}
+	result->plaintext = plaintext_string;
+	result->cycleword = malloc(job->best_cycleword_len + 1);
+	for (i = 0; i < ALPHABET_SIZE; i++) {
+		result->plaintext_keyword[i] = job->best_plaintext_keyword[i] + 'A';
+		result->ciphertext_keyword[i] = job->best_ciphertext_keyword[i] + 'A';
+	}
+	result->plaintext_keyword[ALPHABET_SIZE] = '\0';
+	result->ciphertext_keyword[ALPHABET_SIZE] = '\0';
+	for (i = 0; i < job->best_cycleword_len; i++) {
+		result->cycleword[i] = job->best_cycleword[i] + 'A';
+	}
+	result->cycleword[job->best_cycleword_len] = '\0';
 
-		column_length = k;
+	free_cipher_job(job);
+	free(job);
 
-		// Reset frequencies to zero. 
+	return true;
+}
 
-		for (i = 0; i < ALPHABET_SIZE; i++) {
-			for (k = 0; k < ALPHABET_SIZE; k++) {
-				crib_frequencies[i][k] = 0;
-			}
-		}
 
-		// Check column satisfies the cribs. 
 
-		for (i = 0; i < n_cribs; i++) {
+void quagmire_result_free(quagmire_result *result) {
 
-			// Check the crib corresponds to exactly 1 ciphertext symbol. 
+	free(result->plaintext);
+	free(result->cycleword);
+	result->plaintext = NULL;
+	result->cycleword = NULL;
 
-			for (k = 0; k < column_length; k++) {
+	return ;
+}
 
-				if (crib_positions[i] == ciphertext_column_indices[k]) {
 
-					if (verbose) {
-						printf("CT = %c, PT = %c\n", ciphertext_column[k] + 'A', crib_indices[i] + 'A');
-					}
 
-					crib_frequencies[crib_indices[i]][ciphertext_column[k]] = 1;
-
-					// Check for clash in rows.
-					for (ii = 0; ii < ALPHABET_SIZE; ii++) {
-						total = 0;
-						for (jj = 0; jj < ALPHABET_SIZE; jj++) {
-							total += crib_frequencies[ii][jj];
-							if (total > 1) {
-								printf("\n\nContradiction at col %d, crib char %c\n\n", j, crib_indices[i] + 'A');
-								return false;
-							}
-						}
-					}
+// Defaults of the options that may be set for each cipher. 
 
-					// Check for clash in cols. 
-					for (jj = 0; jj < ALPHABET_SIZE; jj++) {
-						total = 0;
-						for (ii = 0; ii < ALPHABET_SIZE; ii++) {
-							total += crib_frequencies[ii][jj];
-							if (total > 1) {
-								printf("\n\nContradiction at col %d, crib char %c\n\n", j, crib_indices[i] + 'A');
-								return false;
-							}
-						}
-					}					
-				}
-			}
-		}
+void default_cipher_options(cipher_options *options) {
 
-	}
+	options->cipher_type = 3;
+	options->cycleword_len = 0;
+	options->max_cycleword_len = 20;
+	options->plaintext_keyword_len = 5;
+	options->ciphertext_keyword_len = 5;
+	options->plaintext_max_keyword_len = 12;
+	options->ciphertext_max_keyword_len = 12;
+	options->min_keyword_len = 5;
+	options->variant = false;
+	options->crib_present = false;
+	options->cycleword_len_present = false;
+	options->plaintext_keyword_len_present = false;
+	options->ciphertext_keyword_len_present = false;
+	options->solution_present = false;
+	options->crib[0] = '\0';
+	options->solution[0] = '\0';
 
-	return true;
+	return ;
 }
 
 
 
-// For a given candidate keyword - constrain the cycleword based on the cribs. If multiple 
-// cribs produce conflicting cycleword rotations, then we have a conflict and must reject
-// the keyword. 
-
-bool constrain_cycleword(int cipher_indices[], int cipher_len, 
-	int crib_indices[], int crib_positions[], int n_cribs, 
-	int plaintext_keyword_indices[], int ciphertext_keyword_indices[], 
-	int cycleword_indices[], int cycleword_len, 
-	bool variant, bool verbose) {
+// Parse argv[i] if it is one of the options that may be set for each cipher, echoing it 
+// if echo is set. Returns the number of arguments used, 0 if argv[i] is not such an 
+// option, or INACTIVE if its value is missing. 
 
-	int i, j, k, crib_char, ciphertext_char, posn_keyword, posn_cycleword, 
-		indx, crib_cyclewords[MAX_CYCLEWORD_LEN];
+int parse_cipher_option(cipher_options *options, int argc, char **argv, int i, bool echo) {
 
-	// Check cribs are present. 
+	char *arg = argv[i], *value;
 
-	if (n_cribs == 0) {
-		return false; // No contradiction. 
+	if (strcmp(arg, "-variant") == 0) { 
+		options->variant = true;
+		if (echo) printf("\n-variant");
+		return 1;
 	}
 
-	// Set cycleword rotations to inactive. This is used to check for a contradiction 
-	// and thus reject the candidate keyword. 
-	for (i = 0; i < cycleword_len; i++) {
-		crib_cyclewords[i] = INACTIVE; 
+	if (strcmp(arg, "-type") != 0 && strcmp(arg, "-crib") != 0 && strcmp(arg, "-solution") != 0 
+		&& strcmp(arg, "-maxkeywordlen") != 0 && strcmp(arg, "-keywordlen") != 0 
+		&& strcmp(arg, "-plaintextkeywordlen") != 0 && strcmp(arg, "-ciphertextkeywordlen") != 0 
+		&& strcmp(arg, "-maxcyclewordlen") != 0 && strcmp(arg, "-cyclewordlen") != 0) {
+		return 0;
 	}
 
-	for (i = 0; i < cycleword_len; i++) {
+	if (i + 1 >= argc) {
+		printf("\n\nERROR: missing value for '%s'\n\n", arg);
+		return INACTIVE;
+	}
 
-		// Rotate/modify cycleword based on (plaintext and ciphertext) keyword(s) and crib. 
+	value = argv[i + 1];
+
+	if (strcmp(arg, "-type") == 0) {
+		options->cipher_type = atoi(value);
+		if (echo) printf("\n-type %d", options->cipher_type);
+	} else if (strcmp(arg, "-crib") == 0) {
+		options->crib_present = true;
+		snprintf(options->crib, MAX_CIPHER_LENGTH, "%s", value);
+		if (echo) printf("\n-crib %s", options->crib);
+	} else if (strcmp(arg, "-solution") == 0) {
+		options->solution_present = true;
+		snprintf(options->solution, MAX_CIPHER_LENGTH, "%s", value);
+		if (echo) printf("\n-solution %s", options->solution);
+	} else if (strcmp(arg, "-maxkeywordlen") == 0) {
+		options->plaintext_keyword_len = atoi(value);
+		options->ciphertext_keyword_len = options->plaintext_keyword_len;
+		if (echo) printf("\n-maxkeywordlen %d", options->plaintext_keyword_len);
+	} else if (strcmp(arg, "-keywordlen") == 0) {
+		options->plaintext_keyword_len_present = true;
+		options->ciphertext_keyword_len_present = true;
+		options->plaintext_keyword_len = atoi(value);
+		options->ciphertext_keyword_len = options->plaintext_keyword_len;
+		options->plaintext_max_keyword_len = max(options->plaintext_max_keyword_len, 1 + options->plaintext_keyword_len);
+		options->ciphertext_max_keyword_len = max(options->ciphertext_max_keyword_len, 1 + options->ciphertext_keyword_len);
+		options->min_keyword_len = options->plaintext_keyword_len;
+		if (echo) printf("\n-keywordlen %d", options->plaintext_keyword_len);			
+	} else if (strcmp(arg, "-plaintextkeywordlen") == 0) {
+		options->plaintext_keyword_len_present = true;
+		options->plaintext_keyword_len = atoi(value);
+		options->plaintext_max_keyword_len = max(options->plaintext_max_keyword_len, 1 + options->plaintext_keyword_len);
+		options->min_keyword_len = options->plaintext_keyword_len;
+		if (echo) printf("\n-plaintextkeywordlen %d", options->plaintext_keyword_len);
+	} else if (strcmp(arg, "-ciphertextkeywordlen") == 0) {
+		options->ciphertext_keyword_len_present = true;
+		options->ciphertext_keyword_len = atoi(value);
+		options->ciphertext_max_keyword_len = max(options->ciphertext_max_keyword_len, 1 + options->ciphertext_keyword_len);
+		options->min_keyword_len = options->ciphertext_keyword_len;
+		if (echo) printf("\n-ciphertextkeywordlen %d", options->ciphertext_keyword_len);
+	} else if (strcmp(arg, "-maxcyclewordlen") == 0) {
+		options->max_cycleword_len = atoi(value);
+		if (echo) printf("\n-maxcyclewordlen %d", options->max_cycleword_len);
+	} else if (strcmp(arg, "-cyclewordlen") == 0) {
+		options->cycleword_len_present = true;
+		options->cycleword_len = atoi(value);
+		if (options->cycleword_len == 0) {
+			options->cycleword_len_present = false;
+		}
+		options->max_cycleword_len = max(options->max_cycleword_len, 1 + options->cycleword_len);
+		if (echo) printf("\n-cyclewordlen %d", options->cycleword_len);
+	}
 
-		for (j = 0; j < n_cribs; j++) {
-			if (crib_positions[j]%cycleword_len == i) {
-
-				crib_char = crib_indices[j];
-				ciphertext_char = cipher_indices[crib_positions[j]];
-
-				if (variant) {
-					// Find position of ciphertext_char in the ciphertext keyword. 
-					
-					for (k = 0; k < ALPHABET_SIZE; k++) {
-						if (plaintext_keyword_indices[k] == ciphertext_char) {
-							posn_keyword = k;
-							break ;
-						}
-					}
+	return 2;
+}
 
-					// Find position of crib_char in plaintext keyword. 
 
-					for (k = 0; k < ALPHABET_SIZE; k++) {
-						if (ciphertext_keyword_indices[k] == crib_char) {
-							posn_cycleword = k;
-							break ;
-						}
-					}
 
-					// Compute cycleword rotation. 
+// Sense check the options of a cipher. 
 
-					indx = (posn_cycleword - posn_keyword)%ALPHABET_SIZE;
-					if (indx < 0) indx += ALPHABET_SIZE;
-				} else {
-					// Find position of ciphertext_char in the ciphertext keyword. 
-					
-					for (k = 0; k < ALPHABET_SIZE; k++) {
-						if (ciphertext_keyword_indices[k] == ciphertext_char) {
-							posn_keyword = k;
-							break ;
-						}
-					}
+bool check_cipher_options(cipher_options *options) {
 
-					// Find position of crib_char in plaintext keyword. 
+	if (options->cipher_type < VIGENERE || options->cipher_type > BEAUFORT) {
+		printf("\n\nERROR: -type must be between %d and %d.\n\n", VIGENERE, BEAUFORT);
+		return false;
+	}
 
-					for (k = 0; k < ALPHABET_SIZE; k++) {
-						if (plaintext_keyword_indices[k] == crib_char) {
-							posn_cycleword = k;
-							break ;
-						}
-					}
+	if (options->max_cycleword_len < 1 || options->max_cycleword_len > MAX_PERIOD) {
+		printf("\n\nERROR: -maxcyclewordlen must be between 1 and %d.\n\n", MAX_PERIOD);
+		return false;
+	}
 
-					// Compute cycleword rotation. 
+	if (options->cycleword_len_present && (options->cycleword_len < 1 || options->cycleword_len > MAX_CYCLEWORD_LEN)) {
+		printf("\n\nERROR: -cyclewordlen must be between 1 and %d.\n\n", MAX_CYCLEWORD_LEN);
+		return false;
+	}
 
-					indx = (posn_keyword - posn_cycleword)%ALPHABET_SIZE;
-					if (indx < 0) indx += ALPHABET_SIZE;					
-				}
+	return true;
+}
 
-				// Has this cycleword position been previously set? 
 
-				if (crib_cyclewords[i] == INACTIVE) {
-					if (false) {
-						printf("cycleword char %c at %d\n", plaintext_keyword_indices[indx] + 'A', i);
-					}
-					crib_cyclewords[i] = plaintext_keyword_indices[indx];
-					cycleword_indices[i] = plaintext_keyword_indices[indx]; 
-				} else if (crib_cyclewords[i] != plaintext_keyword_indices[indx]) { // Otherwise, do we have a contradiction? 
-					if (false) {
-						printf("\n\nContradiction at crib %c, posn %d; rejecting keyword ", 
-							crib_indices[j] + 'A', 
-							crib_positions[j]);
-						print_text(plaintext_keyword_indices, ALPHABET_SIZE);
-						printf("\n");
-						print_text(ciphertext_keyword_indices, ALPHABET_SIZE);
-						printf("\n");
-					}
-					return true; 
-				}
 
-			}
+// The default search settings, without models. 
 
-		}
+void default_solver_settings(solver_settings *settings) {
 
-	}
+	*settings = (solver_settings) {
+		.ngram_size = 0, .n_hill_climbs = 1000, .n_restarts = 1, .n_batch = 1, .n_threads = 1, .n_jobs = 1, .top_k = 1, 
+		.engine = ENGINE_HILL, .swap_interval = SWAP_INTERVAL, 
+		.start_temperature = START_TEMPERATURE, .end_temperature = END_TEMPERATURE, 
+		.n_confirm = 0, .n_stall = 0, .search_length = 0, .keyword_search = KEYWORD_RANDOM, 
+		.target_score = 0., .time_budget = 0., 
+		.n_sigma_threshold = 1., .ioc_threshold = 0.047, .backtracking_probability = 0.01, 
+		.keyword_permutation_probability = 0.01, .slip_probability = 0.0005, .drop_threshold = 0., 
+		.weight_ngram = 12., .weight_crib = 36., .weight_ioc = 1., .weight_entropy = 1., 
+		.early_abort = false, .period_tests = false, .verbose = false, .resume = false, 
+		.checkpoint_file = NULL, .checkpoint_interval = CHECKPOINT_INTERVAL, 
+		.ngram_data = NULL, .dict = NULL, .keywords = NULL, .stats = NULL, .reporter = NULL};
 
-	return false;
+	return ;
 }
 
 
 
-// Score candidate cipher solution. 
+// Parse argv[i] if it is one of the search options (those that do not name a file or 
+// model), echoing it if echo is set. Returns the number of arguments used, 0 if argv[i] 
+// is not such an option, or INACTIVE if its value is missing or unknown. 
 
-double state_score(int cipher_indices[], int cipher_len, 
-			int crib_indices[], int crib_positions[], int n_cribs, 
-			int plaintext_keyword_state[], int ciphertext_keyword_state[], 
-			int cycleword_state[], int cycleword_len, 
-			bool variant, bool beaufort, 
-			int decrypted[], 
-			float *ngram_data, int ngram_size, 
-			float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy) {
+int parse_solver_option(solver_settings *settings, int argc, char **argv, int i, bool echo) {
 
-	double score, decrypted_ngram_score, decrypted_crib_score;
+	char *arg = argv[i], *value;
 
-	// Decrypt cipher using the candidate keyword and cycleword. 
+	if (strcmp(arg, "-periodtests") == 0) {
+		settings->period_tests = true;
+		if (echo) printf("\n-periodtests");
+		return 1;
+	} else if (strcmp(arg, "-nlocal") == 0) {
+		// TODO: remove me and update all tests/scripts etc. 
+		return 1;
+	} else if (strcmp(arg, "-earlyabort") == 0) {
+		settings->early_abort = true;
+		if (echo) printf("\n-earlyabort");
+		return 1;
+	} else if (strcmp(arg, "-verbose") == 0) {
+		settings->verbose = true;
+		if (echo) printf("\n-verbose ");
+		return 1;
+	}
 
-	if (variant) {
-		quagmire_encrypt(decrypted, cipher_indices, cipher_len, 
-			plaintext_keyword_state, ciphertext_keyword_state, 
-			cycleword_state, cycleword_len, beaufort);
-	} else {
-		quagmire_decrypt(decrypted, cipher_indices, cipher_len, 
-			plaintext_keyword_state, ciphertext_keyword_state, 
-			cycleword_state, cycleword_len, beaufort);
+	if (strcmp(arg, "-nsigmathreshold") != 0 && strcmp(arg, "-nhillclimbs") != 0 
+		&& strcmp(arg, "-nrestarts") != 0 && strcmp(arg, "-batch") != 0 
+		&& strcmp(arg, "-backtrackprob") != 0 && strcmp(arg, "-keywordpermprob") != 0 
+		&& strcmp(arg, "-slipprob") != 0 && strcmp(arg, "-iocthreshold") != 0 
+		&& strcmp(arg, "-weightngram") != 0 && strcmp(arg, "-weightcrib") != 0 
+		&& strcmp(arg, "-weightioc") != 0 && strcmp(arg, "-weightentropy") != 0 
+		&& strcmp(arg, "-threads") != 0 && strcmp(arg, "-jobs") != 0 
+		&& strcmp(arg, "-dropthreshold") != 0 && strcmp(arg, "-topk") != 0 
+		&& strcmp(arg, "-engine") != 0 && strcmp(arg, "-starttemp") != 0 
+		&& strcmp(arg, "-endtemp") != 0 && strcmp(arg, "-swapinterval") != 0 
+		&& strcmp(arg, "-confirm") != 0 && strcmp(arg, "-stall") != 0 
+		&& strcmp(arg, "-targetscore") != 0 && strcmp(arg, "-target-score") != 0 
+		&& strcmp(arg, "-timebudget") != 0 && strcmp(arg, "-time-budget") != 0 
+		&& strcmp(arg, "-searchlength") != 0 && strcmp(arg, "-keywordsearch") != 0) {
+		return 0;
+	}
+
+	if (i + 1 >= argc) {
+		printf("\n\nERROR: missing value for '%s'\n\n", arg);
+		return INACTIVE;
 	}
 
-	// n-gram score. 
+	value = argv[i + 1];
+
+	if (strcmp(arg, "-nsigmathreshold") == 0) {
+		settings->n_sigma_threshold = atof(value);
+		if (echo) printf("\n-nsigmathreshold %.2f", settings->n_sigma_threshold);
+	} else if (strcmp(arg, "-nhillclimbs") == 0) {
+		settings->n_hill_climbs = atoi(value);
+		if (echo) printf("\n-nhillclimbs %d", settings->n_hill_climbs);			
+	} else if (strcmp(arg, "-nrestarts") == 0) {
+		settings->n_restarts = atoi(value);
+		if (echo) printf("\n-nrestarts %d", settings->n_restarts);
+	} else if (strcmp(arg, "-batch") == 0) {
+		settings->n_batch = atoi(value);
+		if (echo) printf("\n-batch %d", settings->n_batch);
+	} else if (strcmp(arg, "-backtrackprob") == 0) {
+		settings->backtracking_probability = atof(value);
+		if (echo) printf("\n-backtrackprob %.4f", settings->backtracking_probability);
+	} else if (strcmp(arg, "-keywordpermprob") == 0) {
+		settings->keyword_permutation_probability = atof(value);
+		if (echo) printf("\n-keywordpermprob %.4f", settings->keyword_permutation_probability);
+	} else if (strcmp(arg, "-slipprob") == 0) {
+		settings->slip_probability = atof(value);
+		if (echo) printf("\n-slipprob %.4f", settings->slip_probability);
+	} else if (strcmp(arg, "-iocthreshold") == 0) {
+		settings->ioc_threshold = atof(value);
+		if (echo) printf("\n-iocthreshold %.4f", settings->ioc_threshold);
+	} else if (strcmp(arg, "-weightngram") == 0) { 
+		settings->weight_ngram = atof(value);
+		if (echo) printf("\n-weightngram %.4f", settings->weight_ngram);
+	} else if (strcmp(arg, "-weightcrib") == 0) { 
+		settings->weight_crib = atof(value);
+		if (echo) printf("\n-weightcrib %.4f", settings->weight_crib);
+	} else if (strcmp(arg, "-weightioc") == 0) { 
+		settings->weight_ioc = atof(value);
+		if (echo) printf("\n-weightioc %.4f", settings->weight_ioc);
+	} else if (strcmp(arg, "-weightentropy") == 0) { 
+		settings->weight_entropy = atof(value);
+		if (echo) printf("\n-weightentropy %.4f", settings->weight_entropy);
+	} else if (strcmp(arg, "-threads") == 0) {
+		settings->n_threads = atoi(value);
+		if (echo) printf("\n-threads %d", settings->n_threads);
+	} else if (strcmp(arg, "-jobs") == 0) {
+		settings->n_jobs = atoi(value);
+		if (echo) printf("\n-jobs %d", settings->n_jobs);
+	} else if (strcmp(arg, "-dropthreshold") == 0) {
+		settings->drop_threshold = atof(value);
+		if (echo) printf("\n-dropthreshold %.4f", settings->drop_threshold);
+	} else if (strcmp(arg, "-topk") == 0) {
+		settings->top_k = atoi(value);
+		if (echo) printf("\n-topk %d", settings->top_k);
+	} else if (strcmp(arg, "-engine") == 0) {
+		settings->engine = search_engine(value);
+		if (echo) printf("\n-engine %s", value);
+		if (settings->engine == INACTIVE) {
+			printf("\n\nERROR: unknown search engine '%s' (hill, anneal or tempering).\n\n", value);
+			return INACTIVE;
+		}
+	} else if (strcmp(arg, "-starttemp") == 0) {
+		settings->start_temperature = atof(value);
+		if (echo) printf("\n-starttemp %.6f", settings->start_temperature);
+	} else if (strcmp(arg, "-endtemp") == 0) {
+		settings->end_temperature = atof(value);
+		if (echo) printf("\n-endtemp %.6f", settings->end_temperature);
+	} else if (strcmp(arg, "-swapinterval") == 0) {
+		settings->swap_interval = atoi(value);
+		if (echo) printf("\n-swapinterval %d", settings->swap_interval);
+	} else if (strcmp(arg, "-confirm") == 0) {
+		settings->n_confirm = atoi(value);
+		if (echo) printf("\n-confirm %d", settings->n_confirm);
+	} else if (strcmp(arg, "-stall") == 0) {
+		settings->n_stall = atoi(value);
+		if (echo) printf("\n-stall %d", settings->n_stall);
+	} else if (strcmp(arg, "-targetscore") == 0 || strcmp(arg, "-target-score") == 0) {
+		settings->target_score = atof(value);
+		if (echo) printf("\n-targetscore %.4f", settings->target_score);
+	} else if (strcmp(arg, "-timebudget") == 0 || strcmp(arg, "-time-budget") == 0) {
+		settings->time_budget = atof(value);
+		if (echo) printf("\n-timebudget %.1f", settings->time_budget);
+	} else if (strcmp(arg, "-searchlength") == 0) {
+		settings->search_length = atoi(value);
+		if (echo) printf("\n-searchlength %d", settings->search_length);
+	} else if (strcmp(arg, "-keywordsearch") == 0) {
+		settings->keyword_search = keyword_search(value);
+		if (echo) printf("\n-keywordsearch %s", value);
+		if (settings->keyword_search == INACTIVE) {
+			printf("\n\nERROR: unknown keyword search '%s' (random, seed or exhaustive).\n\n", value);
+			return INACTIVE;
+		}
+	}
 
-	decrypted_ngram_score = ngram_score(decrypted, cipher_len, ngram_data, ngram_size);
+	return 2;
+}
 
-	// crib score. 
 
-	decrypted_crib_score = crib_score(decrypted, cipher_len, crib_indices, crib_positions, n_cribs);
 
-	// Expected IOC. 
+// Sense check the search settings. 
 
-	double mean_english_ioc, ioc_score;
-	mean_english_ioc = 1.742;
-	ioc_score = ALPHABET_SIZE*index_of_coincidence(decrypted, cipher_len);	
-	// ioc_score = 1./(1. + pow(ioc_score - mean_english_ioc, 2));
-	ioc_score = exp(-pow(ioc_score - mean_english_ioc, 2));
+bool check_solver_settings(solver_settings *settings) {
 
-	// Expected entropy. 
+	if (settings->n_batch < 1 || settings->n_batch > MAX_BATCH) {
+		printf("\n\nERROR: -batch must be between 1 and %d.\n\n", MAX_BATCH);
+		return false;
+	}
 
-	double mean_english_entropy, entropy_score; 
-	mean_english_entropy = 2.85;
-	entropy_score = entropy(decrypted, cipher_len);	
-	// entropy_score = 1./(1. + pow(entropy_score - mean_english_entropy, 2));
-	entropy_score = exp(-pow(entropy_score - mean_english_entropy, 2));
+	if (settings->top_k < 1 || settings->top_k > MAX_TOP_K) {
+		printf("\n\nERROR: -topk must be between 1 and %d.\n\n", MAX_TOP_K);
+		return false;
+	}
 
-	// printf("\n%.4f, %.4f, %.4f, %.4f", decrypted_ngram_score, decrypted_crib_score, ioc_score, entropy_score);
+	if (settings->start_temperature <= 0. || settings->end_temperature <= 0.) {
+		printf("\n\nERROR: -starttemp and -endtemp must be positive.\n\n");
+		return false;
+	}
 
-	score = weight_ngram*decrypted_ngram_score + 
-			weight_crib*decrypted_crib_score + 
-			weight_ioc*ioc_score + 
-			weight_entropy*entropy_score;
+	if (settings->n_confirm < 0 || settings->n_stall < 0 || settings->target_score < 0. || settings->time_budget < 0.) {
+		printf("\n\nERROR: -confirm, -stall, -targetscore and -timebudget cannot be negative.\n\n");
+		return false;
+	}
 
-	score /= weight_ngram + weight_crib + weight_ioc + weight_entropy;
+	if (settings->swap_interval < 1) {
+		printf("\n\nERROR: -swapinterval must be positive.\n\n");
+		return false;
+	}
 
-	score /= 3.41; // score for example cipher of length 97 (using the current weighting scheme). 
+	if (settings->search_length != 0 && (settings->search_length <= MAX_NGRAM_SIZE 
+		|| settings->search_length > MAX_CIPHER_LENGTH)) {
+		printf("\n\nERROR: -searchlength must be 0 or between %d and %d.\n\n", MAX_NGRAM_SIZE + 1, MAX_CIPHER_LENGTH);
+		return false;
+	}
 
-	return score;
+	return true;
 }
 
 
 
+// Read the ciphertext and crib of a cipher. The ciphertext is the first line of the file 
+// cipher_source (leaving further lines for explanation/derivation etc.) and the crib that 
+// of the crib file. With literal_p, as in a manifest, either may instead be given as the 
+// text itself, and the job keeps the name it was given. Returns false (having printed 
+// the error) if they cannot be used. Either way, the job's arrays are freed by 
+// free_cipher_job. 
 
-// Entropy. 
+bool load_cipher_job(cipher_job *job, char *cipher_source, cipher_options *options, 
+	bool literal_p, bool verbose) {
 
-double entropy(int text[], int len) {
+	int i;
+	char *ciphertext, *cribtext;
+	FILE *fp;
 
-	int frequencies[ALPHABET_SIZE];
-	double entropy = 0., freq;
+	job->cipher_indices = NULL;
+	job->crib_indices = NULL;
+	job->crib_positions = NULL;
+	job->best_decrypted = NULL;
+	job->solution_indices = NULL;
+	job->options = *options;
+	job->best_score = 0.;
+	job->best_cycleword_len = 0;
+	job->n_words_found = INACTIVE;
+	atomic_init(&job->solved_time, 0.);
+	solution_heap_init(&job->top, 1);
+	straight_alphabet(job->best_plaintext_keyword, ALPHABET_SIZE);
+	straight_alphabet(job->best_ciphertext_keyword, ALPHABET_SIZE);
+	memset(job->best_cycleword, 0, MAX_CYCLEWORD_LEN);
+
+	// Read ciphertext. 
+
+	if (file_exists(cipher_source)) {
+		fp = fopen(cipher_source, "r");
+		ciphertext = read_word(fp);
+		fclose(fp);
+		snprintf(job->name, MAX_FILENAME_LEN, "%s", cipher_source);
+	} else if (literal_p) {
+		ciphertext = strdup(cipher_source);
+	} else {
+		printf("\nERROR: missing file '%s'\n", cipher_source);
+		return false;
+	}
 
-	// Count frequencies of each plaintext letter. 
-	tally(text, len, frequencies, ALPHABET_SIZE);
+	if (verbose) {
+		printf("ciphertext = \n\'%s\'\n\n", ciphertext);
+	}
 
-	for (int i = 0; i < ALPHABET_SIZE; i++) {
-		if (frequencies[i] > 0) {
-			freq = ((double) frequencies[i])/len;
-			entropy -= freq*log(freq);
+	if (strlen(ciphertext) > MAX_TEXT_LENGTH) {
+		printf("\n\nERROR: ciphertext '%s' is longer than %d letters.\n\n", job->name, MAX_TEXT_LENGTH);
+		free(ciphertext);
+		return false;
+	}
+
+	job->cipher_len = (int) strlen(ciphertext);
+
+	for (i = 0; i < job->cipher_len; i++) {
+		if ((ciphertext[i] < 'A' || ciphertext[i] > 'Z') && literal_p && ! file_exists(cipher_source)) {
+			printf("\n\nERROR: '%s' is neither a file nor a ciphertext of upper case letters.\n\n", cipher_source);
+			free(ciphertext);
+			return false;
+		} else if (ciphertext[i] < 'A' || ciphertext[i] > 'Z') {
+			printf("\n\nERROR: ciphertext '%s' is not all upper case letters.\n\n", job->name);
+			free(ciphertext);
+			return false;
 		}
 	}
-	// printf("entropy = %.4f\n", entropy);
 
-	return entropy;
-}
+	if (job->cipher_len < 2) {
+		printf("\n\nERROR: ciphertext '%s' is too short.\n\n", job->name);
+		free(ciphertext);
+		return false;
+	}
 
+	// Compute ciphertext indices. A -> 0, B -> 1, ..., Z -> 25 (Assuming ALPHABET_SIZE = 26)
 
+	job->cipher_indices = malloc(job->cipher_len*sizeof(uint8_t));
+	job->crib_indices = malloc(job->cipher_len*sizeof(uint8_t));
+	job->crib_positions = malloc(job->cipher_len*sizeof(int));
+	job->best_decrypted = calloc(job->cipher_len, sizeof(uint8_t));
 
-// Chi-squared score. 
+	ord(ciphertext, job->cipher_indices);
+	free(ciphertext);
 
-double chi_squared(int plaintext[], int len) {
+	// Read crib. 
 
-	int i, counts[ALPHABET_SIZE];
-	double frequency, chi2 = 0.;
+	job->n_cribs = 0;
 
-	tally(plaintext, len, counts, ALPHABET_SIZE);
+	if (options->crib_present) {
 
-	for (i = 0; i < ALPHABET_SIZE; i++) {
-		frequency = ((double) counts[i])/len;
-		// printf("%d, %.4f, %.4f\n", i, frequency, english_monograms[i]);
-		chi2 += pow(frequency - english_monograms[i], 2)/english_monograms[i];
-	}
+		if (file_exists(options->crib)) {
+			fp = fopen(options->crib, "r");
+			cribtext = read_word(fp);
+			fclose(fp);
+		} else if (literal_p) {
+			cribtext = strdup(options->crib);
+		} else {
+			printf("\nERROR: missing file '%s'\n", options->crib);
+			return false;
+		}
 
-	return chi2;
-}
+		if (verbose) {
+			printf("cribtext = \n\'%s\'\n\n", cribtext);
+		}
 
+		// Check ciphertext and cribtext are of the same length. 
 
+		if (job->cipher_len != strlen(cribtext)) {
+			printf("\n\nERROR: strlen(ciphertext) = %d, strlen(cribtext) = %lu.\n\n", 
+				job->cipher_len, strlen(cribtext));
+			free(cribtext);
+			return false; 
+		}
 
+		// Extract crib positions and corresponding plaintext. 
 
-// Score for known plaintext. (Naive - not using symmetry of the Vigenere encryption.)
+		if (verbose) {
+			printf("\ncrib indices = \n\n");
+		}
 
-double crib_score(int text[], int len, int crib_indices[], int crib_positions[], int n_cribs) {
+		for (i = 0; i < job->cipher_len; i++) {
+			if (cribtext[i] != '_') {
+				if (cribtext[i] < 'A' || cribtext[i] > 'Z') {
+					printf("\n\nERROR: crib for '%s' is not all upper case letters and '_'.\n\n", job->name);
+					free(cribtext);
+					return false;
+				}
+				job->crib_positions[job->n_cribs] = i;
+				job->crib_indices[job->n_cribs] = cribtext[i] - 'A';
+				job->n_cribs++;
+				if (verbose) {
+					printf("%d, %c, %d\n", i, cribtext[i], cribtext[i] - 'A');
+				}
+			}
+		}
 
-	if (n_cribs == 0) return 0.;
+		if (verbose) {
+			printf("\n");
+		}
 
-	int n_matches = 0;
+		free(cribtext);
+	}
 
-	for (int i = 0; i < n_cribs; i++) {
-		if (text[crib_positions[i]] == crib_indices[i]) {
-			n_matches += 1;
-		}
+	if (options->solution_present && ! read_known_solution(job, options->solution, literal_p)) {
+		return false;
 	}
 
-	return ((double) n_matches)/((double) n_cribs);
+	return true;
 }
 
 
 
-// Score a plaintext based on ngram frequencies. 
+// Free the arrays of a job loaded by load_cipher_job (but not the job itself). 
 
+void free_cipher_job(cipher_job *job) {
 
-double ngram_score(int decrypted[], int cipher_len, float *ngram_data, int ngram_size) {
+	free(job->cipher_indices);
+	free(job->crib_indices);
+	free(job->crib_positions);
+	free(job->best_decrypted);
+	free(job->solution_indices);
+	job->cipher_indices = NULL;
+	job->crib_indices = NULL;
+	job->crib_positions = NULL;
+	job->best_decrypted = NULL;
+	job->solution_indices = NULL;
 
-	int index, base;
-	double score = 0.;
+	return ;
+}
 
-	for (int i = 0; i < cipher_len - ngram_size; i++) {
 
-		index = 0;
-		base = 1;
 
-		for (int j = 0; j < ngram_size; j++) {
-			index += decrypted[i + j]*base;
-			base *= ALPHABET_SIZE;
-		}
+// Read the next whitespace separated word of a file, of any length, as a string to be 
+// freed by the caller. Returns the empty string at the end of the file. 
 
-		score += ngram_data[index];
-	}
+char *read_word(FILE *fp) {
 
-	// Normalise to cipher length and n-gram size. 
+	int c, len = 0, capacity = 256;
+	char *word = malloc(capacity);
 
-	score = pow(ALPHABET_SIZE,ngram_size)*score/(cipher_len - ngram_size);
+	while ((c = fgetc(fp)) != EOF && isspace(c)) ;
 
-	return score;
+	for ( ; c != EOF && ! isspace(c); c = fgetc(fp)) {
+		if (len + 1 == capacity) {
+			capacity *= 2;
+			word = realloc(word, capacity);
+		}
+		word[len++] = c;
+	}
+
+	word[len] = '\0';
+
+	return word;
 }
 
 
-// Old, slow ngram score routine. 
 
-double ngram_score_slow(int decrypted[], int cipher_len, float *ngram_data, int ngram_size) {
+// Read the known plaintext of a job for -solution: the last word of the file 
+// solution_source which is as long as the ciphertext and all upper case letters, 
+// so either a bare plaintext or a *_solution.txt file (whose last line is the plaintext) 
+// will do. With literal_p, as in a manifest, it may instead be the plaintext itself. 
 
-	int indx, ngram[MAX_NGRAM_SIZE];
-	double score = 0.;
+bool read_known_solution(cipher_job *job, char *solution_source, bool literal_p) {
 
-	for (int i = 0; i < cipher_len - ngram_size; i++) {
+	int i;
+	bool found = false;
+	char *word, *solution = NULL;
+	FILE *fp;
 
-		// printf("\n");
-		// Extract slice decrypted[i : i + ngram_size].
-		for (int j = 0; j < ngram_size; j++) {
-			ngram[j] = decrypted[i + j];
-			// printf("%c", ngram[j] + 'A');
+	if (file_exists(solution_source)) {
+		fp = fopen(solution_source, "r");
+		while (*(word = read_word(fp)) != '\0') {
+			for (i = 0; i < job->cipher_len && word[i] >= 'A' && word[i] <= 'Z'; i++) ;
+			if (strlen(word) == job->cipher_len && i == job->cipher_len) {
+				free(solution);
+				solution = word;
+				found = true;
+			} else {
+				free(word);
+			}
 		}
-		// printf("\t");
+		free(word);
+		fclose(fp);
+	} else if (! literal_p) {
+		printf("\nERROR: missing file '%s'\n", solution_source);
+		return false;
+	} else if (strlen(solution_source) == job->cipher_len) {
+		solution = strdup(solution_source);
+		found = true;
+		for (i = 0; i < job->cipher_len; i++) {
+			found = found && solution[i] >= 'A' && solution[i] <= 'Z';
+		}
+	}
 
-		indx = ngram_index_int(ngram, ngram_size);
-		// printf("%.12f", ngram_data[indx]);
-		score += ngram_data[indx];
+	if (! found) {
+		printf("\n\nERROR: no plaintext of the length of '%s' in the solution '%s'.\n\n", 
+			job->name, solution_source);
+		free(solution);
+		return false;
 	}
 
-	return pow(ALPHABET_SIZE,ngram_size)*score/(cipher_len - ngram_size);
+	job->solution_indices = malloc(job->cipher_len*sizeof(uint8_t));
+	ord(solution, job->solution_indices);
+	free(solution);
+
+	return true;
 }
 
 
 
-// Given a ciphertext, keyword and cycleword (all in index form), compute the 
-// Quagmire 4 decryption. 
+// Estimate the cycleword lengths of a cipher, then run the 'shotgun' hill-climber for 
+// each admissible length triple and keep the best solution. The hill climber searches 
+// the first search_length letters (at most MAX_CIPHER_LENGTH) of a longer ciphertext, 
+// and the best solution of each triple, and the top solutions, are then rescored on the 
+// full text (see confirm_score). Returns false if the checkpoint to resume from could 
+// not be read. 
 
-void quagmire_decrypt(int decrypted[], int cipher_indices[], int cipher_len, 
-	int plaintext_keyword_indices[], int ciphertext_keyword_indices[], 
-	int cycleword_indices[], int cycleword_len, bool beaufort) {
-	
-	int i, j, posn_keyword, posn_cycleword, indx, ct_indx, cw_indx; 
+bool solve_cipher(cipher_job *job, solver_settings *settings) {
 
-	for (i = 0; i < cipher_len; i++) {
+	int i, j, k, n, n_cycleword_lengths, n_crib_lengths, n_triples, cycleword_lengths[MAX_PERIOD], 
+		search_len, n_search_cribs;
+	double start_time = wall_clock();
+	cipher_options options = job->options;
+	bool verbose = settings->verbose;
+	climber_shared climber_template;
+	length_triple *triples;
+	solution sorted[MAX_TOP_K];
+	uint8_t *decrypted;
 
-		// Find position of ciphertext char in ciphertext key. 
-		for (j = 0; j < ALPHABET_SIZE; j++) {
-			ct_indx = ciphertext_keyword_indices[j];
-			if (cipher_indices[i] == ct_indx) {
-				posn_keyword = j;
-				break ;
+	if (settings->keyword_search != KEYWORD_RANDOM && settings->keywords == NULL) {
+		printf("\n\nERROR: -keywordsearch %s needs a keyword list.\n\n", keyword_search_names[settings->keyword_search]);
+		return false;
+	}
+
+	if (settings->keyword_search == KEYWORD_EXHAUSTIVE 
+		&& options.cipher_type != QUAGMIRE_1 && options.cipher_type != QUAGMIRE_2 && options.cipher_type != QUAGMIRE_3) {
+		printf("\n\nERROR: -keywordsearch exhaustive is for Quagmire I, II and III ciphers.\n\n");
+		return false;
+	}
+
+	// Estimate cycleword length. 
+
+	estimate_cycleword_lengths(
+			job->cipher_indices, 
+			job->cipher_len, 
+			options.max_cycleword_len, 
+			settings->n_sigma_threshold,
+			settings->ioc_threshold, 
+			settings->period_tests, 
+			&n_cycleword_lengths, 
+			cycleword_lengths, 
+			verbose);
+
+	// User-defined cycleword length. 
+	
+	if (options.cycleword_len_present) {
+		n_cycleword_lengths = 1;
+		cycleword_lengths[0] = options.cycleword_len;
+	}
+
+	// Vigenere cipher case.
+	if (options.cipher_type == VIGENERE) {
+		options.min_keyword_len = 1;
+	}
+
+	// Beaufort cipher case.
+	if (options.cipher_type == BEAUFORT) {
+		options.min_keyword_len = 1;
+		options.plaintext_max_keyword_len = 2;
+		options.plaintext_max_keyword_len = 2;
+	}
+
+	// Check the cipher satisfies the cribs for each cycleword length, once, and drop the 
+	// lengths which cannot. 
+
+	n_crib_lengths = 0;
+
+	for (i = 0; i < n_cycleword_lengths; i++) {
+		if (! cribs_satisfied_p(job->cipher_indices, job->cipher_len, job->crib_indices, job->crib_positions, 
+			job->n_cribs, cycleword_lengths[i], verbose)) {
+			if (verbose) {
+				printf("\n\nCiphertext does not satisfy the cribs for cycleword length %d. \n\n", cycleword_lengths[i]);
+			}
+#if CRIB_CHECK
+			continue ;
+#endif
+		}
+		cycleword_lengths[n_crib_lengths++] = cycleword_lengths[i];
+	}
+
+	if (verbose && n_crib_lengths < n_cycleword_lengths) {
+		printf("\n%d of %d cycleword lengths satisfy the cribs\n", n_crib_lengths, n_cycleword_lengths);
+	}
+
+	n_cycleword_lengths = n_crib_lengths;
+
+	// The search window is the start of the ciphertext, so its columns are those of the 
+	// full text, with the cribs that fall inside it. 
+
+	search_len = min(job->cipher_len, settings->search_length > 0 ? settings->search_length : MAX_CIPHER_LENGTH);
+
+	for (n_search_cribs = 0; n_search_cribs < job->n_cribs && job->crib_positions[n_search_cribs] < search_len; 
+		n_search_cribs++) ;
+
+	if (search_len < job->cipher_len) {
+		printf("\nSearching the first %d of the %d letters of %s\n", search_len, job->cipher_len, job->name);
+	}
+
+	// Collect each admissible cycleword length and keyword length combination. 
+
+	triples = malloc(max(1, n_cycleword_lengths*options.plaintext_max_keyword_len*options.ciphertext_max_keyword_len)*sizeof(length_triple));
+	n_triples = 0;
+
+	for (i = 0; i < n_cycleword_lengths; i++) {
+		for (j = min(options.min_keyword_len, options.plaintext_keyword_len); j < options.plaintext_max_keyword_len; j++) {
+			for (k = min(options.min_keyword_len, options.ciphertext_keyword_len); k < options.ciphertext_max_keyword_len; k++) {
+				
+				// printf("i,j,k = %d, %d, %d", i, j, k);
+
+				// User-specified plaintext keyword length. 
+				if (options.plaintext_keyword_len_present && j != options.plaintext_keyword_len) {
+					continue ;
+				}
+
+				// User-specified ciphertext keyword length. 
+				if (options.ciphertext_keyword_len_present && k != options.ciphertext_keyword_len) {
+					continue ;
+				}
+
+				// Both Vigenere and Quagmire 3 use the same ciphertext and plaintext keywords. 
+				if ((options.cipher_type == VIGENERE || options.cipher_type == QUAGMIRE_3) && j != k) continue ;
+
+				// Vigenere cipher uses same ciphertext, plaintext, and cycleword lengths.
+				if (options.cipher_type == VIGENERE && ! (cycleword_lengths[i] == j && cycleword_lengths[i] == k)) continue ;
+
+				// Beaufort cipher uses a plaintext and ciphertext keyword of 'A'.
+				if (options.cipher_type == BEAUFORT && ! (j == 1 && k == 1)) continue ;
+
+				// An exhaustive keyword search only has the keyword lengths of its keyword list. 
+				n = options.cipher_type == QUAGMIRE_2 ? k : j;
+				if (settings->keyword_search == KEYWORD_EXHAUSTIVE 
+					&& (n > MAX_KEYWORD_LEN || settings->keywords->offsets[n + 1] == settings->keywords->offsets[n])) continue ;
+
+				if (verbose) {
+					printf("\nplaintext, ciphertext, cycleword lengths = %d, %d, %d\n", j, k, cycleword_lengths[i]);
+				}
+
+				// Queue the hill-climber for this length triple. 
+
+				triples[n_triples].cycleword_len = cycleword_lengths[i];
+				triples[n_triples].plaintext_keyword_len = j;
+				triples[n_triples].ciphertext_keyword_len = k;
+				triples[n_triples].n_restarts_done = 0;
+				triples[n_triples].score = 0.;
+				triples[n_triples].dropped = false;
+				triples[n_triples].converged = false;
+				straight_alphabet(triples[n_triples].plaintext_keyword, ALPHABET_SIZE);
+				straight_alphabet(triples[n_triples].ciphertext_keyword, ALPHABET_SIZE);
+				memset(triples[n_triples].cycleword, 0, MAX_CYCLEWORD_LEN);
+				solution_heap_init(&triples[n_triples].top, settings->top_k);
+				n_triples++;
+			}
+		}
+	}
+
+	// Run the 'shotgun' hill-climber for each length triple on the job pool. 
+
+	climber_setup(&climber_template, 
+		options.cipher_type, 
+		job->cipher_indices, 
+		search_len, 
+		job->crib_indices, 
+		job->crib_positions, 
+		n_search_cribs, 
+		0, 
+		0,  
+		0,
+		settings->n_hill_climbs, 
+		settings->n_restarts, 
+		settings->n_batch, 
+		settings->ngram_data, 
+		settings->ngram_size,
+		settings->backtracking_probability,
+		settings->keyword_permutation_probability,
+		settings->slip_probability, 
+		settings->weight_ngram, 
+		settings->weight_crib, 
+		settings->weight_ioc, 
+		settings->weight_entropy,
+		options.variant, 
+		options.cipher_type == BEAUFORT,
+		settings->early_abort, 
+		verbose);
+
+	climber_template.top_k = settings->top_k;
+	climber_template.engine = settings->engine;
+	climber_template.swap_interval = settings->swap_interval;
+	climber_template.start_temperature = settings->start_temperature;
+	climber_template.end_temperature = settings->end_temperature;
+	climber_template.n_confirm = settings->n_confirm;
+	climber_template.n_stall = settings->n_stall;
+	climber_template.keyword_search = settings->keyword_search;
+	climber_template.keywords = settings->keywords;
+	climber_template.target_score = settings->target_score;
+	climber_template.deadline = settings->time_budget > 0. ? wall_clock() + settings->time_budget : 0.;
+	climber_template.stats = settings->stats;
+	climber_template.reporter = settings->reporter;
+	climber_template.name = job->name;
+	if (options.solution_present) {
+		climber_template.solution_indices = job->solution_indices;
+		climber_template.solved_time = &job->solved_time;
+	}
+
+	// Pick up the triples of an interrupted run where it left off. 
+
+	if (settings->resume) {
+		if (! read_checkpoint(settings->checkpoint_file, &climber_template, triples, n_triples)) {
+			free(triples);
+			return false;
+		}
+		printf("\nResuming from checkpoint file %s\n", settings->checkpoint_file);
+	}
+
+	run_length_sweep(&climber_template, triples, n_triples, settings->n_jobs, settings->n_threads, 
+		settings->drop_threshold, settings->checkpoint_file, settings->checkpoint_interval);
+
+	if (settings->reporter != NULL) {
+		progress_reporter_flush(settings->reporter);
+	}
+
+	if (options.solution_present && atomic_load(&job->solved_time) > 0.) {
+		printf("\nKnown solution of %s reached after %.3f seconds\n", job->name, 
+			atomic_load(&job->solved_time) - start_time);
+	} else if (options.solution_present) {
+		printf("\nKnown solution of %s not reached\n", job->name);
+	}
+
+	// Confirm the best solution of each triple on the full text. 
+
+	decrypted = malloc(job->cipher_len*sizeof(uint8_t));
+
+	if (search_len < job->cipher_len) {
+		for (i = 0; i < n_triples; i++) {
+			if (triples[i].score > 0.) {
+				triples[i].score = confirm_score(job, settings, decrypted, triples[i].plaintext_keyword, 
+					triples[i].ciphertext_keyword, triples[i].cycleword, triples[i].cycleword_len);
+			}
+		}
+	}
+
+	// Keep the best solution (the first of any equal scores, in the order the triples were queued). 
+
+	job->best_score = 0.;
+
+	for (i = 0; i < n_triples; i++) {
+		if (triples[i].score > job->best_score) {
+			job->best_score = triples[i].score;
+			job->best_cycleword_len = triples[i].cycleword_len;
+			vec_copy(triples[i].plaintext_keyword, job->best_plaintext_keyword, ALPHABET_SIZE);
+			vec_copy(triples[i].ciphertext_keyword, job->best_ciphertext_keyword, ALPHABET_SIZE);
+			vec_copy(triples[i].cycleword, job->best_cycleword, MAX_CYCLEWORD_LEN);
+		}
+	}
+
+	// No triple climbed a single state (an exhaustive keyword search whose keywords the
+	// cribs all contradict, or a time budget used up first): there is no solution to report.
+
+	if (job->best_score == 0.) {
+		if (settings->keyword_search == KEYWORD_EXHAUSTIVE) {
+			printf("\n\nERROR: no keyword of the list is consistent with the cribs of %s.\n\n", job->name);
+		} else {
+			printf("\n\nERROR: no solution of %s found.\n\n", job->name);
+		}
+		free(decrypted);
+		free(triples);
+		return false;
+	}
+
+	job_decrypt(job, job->best_decrypted, job->best_plaintext_keyword, job->best_ciphertext_keyword,
+		job->best_cycleword, job->best_cycleword_len);
+
+	if (verbose && settings->target_score > 0. && job->best_score >= settings->target_score) {
+		printf("\nTarget score %.2f reached\n", settings->target_score);
+	}
+
+	if (verbose && settings->time_budget > 0. && wall_clock() > climber_template.deadline) {
+		printf("\nTime budget of %.1f seconds used up\n", settings->time_budget);
+	}
+
+	// The best distinct solutions over all the triples. 
+
+	solution_heap_init(&job->top, settings->top_k);
+
+	for (i = 0; i < n_triples; i++) {
+		solution_heap_merge(&job->top, &triples[i].top);
+	}
+
+	if (search_len < job->cipher_len) {
+		n = job->top.n_solutions;
+		solution_heap_sort(&job->top, sorted);
+		solution_heap_init(&job->top, settings->top_k);
+		for (i = 0; i < n; i++) {
+			solution_heap_insert(&job->top, &sorted[i].state, 
+				confirm_score(job, settings, decrypted, sorted[i].state.plaintext_keyword, 
+					sorted[i].state.ciphertext_keyword, sorted[i].state.cycleword, sorted[i].cycleword_len), 
+				sorted[i].hash, sorted[i].cycleword_len);
+		}
+	}
+
+	free(decrypted);
+	free(triples);
+
+	if (settings->stats != NULL) {
+		pthread_mutex_lock(&settings->stats->lock);
+		settings->stats->n_ciphers++;
+		pthread_mutex_unlock(&settings->stats->lock);
+	}
+
+	return true;
+}
+
+
+
+// The score of a solution of a job on its full ciphertext (with every crib), decrypting 
+// it into decrypted. 
+
+double confirm_score(cipher_job *job, solver_settings *settings, uint8_t decrypted[], 
+	uint8_t plaintext_keyword[], uint8_t ciphertext_keyword[], uint8_t cycleword[], int cycleword_len) {
+
+	// As in run_hill_climber, a Vigenere cycleword is a whole alphabet. 
+
+	if (job->options.cipher_type == VIGENERE) {
+		cycleword_len = ALPHABET_SIZE;
+	}
+
+	return state_score(job->cipher_indices, job->cipher_len, job->crib_indices, job->crib_positions, job->n_cribs, 
+		plaintext_keyword, ciphertext_keyword, cycleword, cycleword_len, 
+		job->options.variant, job->options.cipher_type == BEAUFORT, decrypted, 
+		settings->ngram_data, settings->ngram_size, 
+		settings->weight_ngram, settings->weight_crib, settings->weight_ioc, settings->weight_entropy);
+}
+
+
+
+// Decrypt the full ciphertext of a job with the given keywords and cycleword (or, for a 
+// variant, encrypt it). 
+
+void job_decrypt(cipher_job *job, uint8_t decrypted[], uint8_t plaintext_keyword[], 
+	uint8_t ciphertext_keyword[], uint8_t cycleword[], int cycleword_len) {
+
+	bool beaufort = job->options.cipher_type == BEAUFORT;
+
+	if (job->options.cipher_type == VIGENERE) {
+		cycleword_len = ALPHABET_SIZE;
+	}
+
+	if (job->options.variant) {
+		quagmire_encrypt(decrypted, job->cipher_indices, job->cipher_len, plaintext_keyword, 
+			ciphertext_keyword, cycleword, cycleword_len, beaufort);
+	} else {
+		quagmire_decrypt(decrypted, job->cipher_indices, job->cipher_len, plaintext_keyword, 
+			ciphertext_keyword, cycleword, cycleword_len, beaufort);
+	}
+
+	return ;
+}
+
+
+
+// Print the best distinct solutions of a cipher, best first, one per line: the rank, 
+// score, keywords, cycleword and plaintext. 
+
+void print_top_solutions(cipher_job *job) {
+
+	int i;
+	uint8_t *decrypted = malloc(job->cipher_len*sizeof(uint8_t));
+	solution sorted[MAX_TOP_K], *top;
+
+	solution_heap_sort(&job->top, sorted);
+
+	printf("\nTop %d distinct solutions:\n\n", job->top.n_solutions);
+
+	for (i = 0; i < job->top.n_solutions; i++) {
+		top = &sorted[i];
+		job_decrypt(job, decrypted, top->state.plaintext_keyword, top->state.ciphertext_keyword, 
+			top->state.cycleword, top->cycleword_len);
+		printf("%d, %.2f, ", i + 1, top->score);
+		print_text(top->state.plaintext_keyword, ALPHABET_SIZE);
+		printf(", ");
+		print_text(top->state.ciphertext_keyword, ALPHABET_SIZE);
+		printf(", ");
+		print_text(top->state.cycleword, top->cycleword_len);
+		printf(", ");
+		print_text(decrypted, job->cipher_len);
+		printf("\n");
+	}
+
+	free(decrypted);
+
+	return ;
+}
+
+
+
+// Single line summary of the results of a cipher, for subsequent filtering and analysis. 
+
+void print_summary_line(cipher_job *job) {
+
+	if (job->n_words_found != INACTIVE) {
+		printf(">>> %.2f, %d, %d, %s, ", job->best_score, job->n_words_found, job->options.cipher_type, job->name);
+	} else {
+		printf(">>> %.2f, %d, %s, ", job->best_score, job->options.cipher_type, job->name);
+	}
+	print_text(job->cipher_indices, job->cipher_len);
+	printf(", ");
+	print_text(job->best_plaintext_keyword, ALPHABET_SIZE);
+	printf(", ");
+	print_text(job->best_ciphertext_keyword, ALPHABET_SIZE);
+	printf(", ");
+	print_text(job->best_cycleword, job->best_cycleword_len);
+	printf(", ");
+	print_text(job->best_decrypted, job->cipher_len);
+
+#if KRYPTOS
+	char *plaintext_string = text_string(job->best_decrypted, job->cipher_len);
+
+	if (strstr(plaintext_string, "BERLIN") != NULL) {
+		printf(", BERLIN");
+	}
+	if (strstr(plaintext_string, "CLOCK") != NULL) {
+		printf(", CLOCK");
+	}
+	if (strstr(plaintext_string, "EAST") != NULL) {
+		printf(", EAST");
+	}
+	if (strstr(plaintext_string, "NORTH") != NULL) {
+		printf(", NORTH");
+	}
+	if (strstr(plaintext_string, "BERLINCLOCK") != NULL) {
+		printf(", BERLINCLOCK");
+	}
+	if (strstr(plaintext_string, "EASTNORTHEAST") != NULL) {
+		printf(", EASTNORTHEAST");
+	}
+
+	free(plaintext_string);
+#endif
+
+	return ;
+}
+
+
+
+// Micro-benchmarks of the hot path on a job's ciphertext, for -benchmark: n_calls calls 
+// each of quagmire_decrypt, ngram_score, state_score, and the two score cache moves of 
+// the hill climber (a cycleword letter, and a whole new state, each proposed and then 
+// reverted). The calls cycle through BENCHMARK_STATES random states with the job's 
+// keyword and cycleword lengths (7 for a cycleword length that is not given), on (at 
+// most) the first MAX_CIPHER_LENGTH letters of the ciphertext. 
+
+void run_benchmarks(cipher_job *job, solver_settings *settings, int n_calls) {
+
+	int i, column, n_cribs, cipher_type = job->options.cipher_type, cipher_len = min(job->cipher_len, MAX_CIPHER_LENGTH), 
+		cycleword_len = job->options.cycleword_len_present ? job->options.cycleword_len : 7, 
+		plaintext_keyword_len = job->options.plaintext_keyword_len, 
+		ciphertext_keyword_len = job->options.ciphertext_keyword_len;
+	double start, checksum = 0.;
+	bool variant = job->options.variant, beaufort = cipher_type == BEAUFORT;
+	uint8_t decrypted[MAX_CIPHER_LENGTH], *plaintexts;
+	quagmire_state states[BENCHMARK_STATES], *state;
+	climber_shared shared;
+	score_cache *cache = malloc(sizeof(score_cache));
+
+	for (n_cribs = 0; n_cribs < job->n_cribs && job->crib_positions[n_cribs] < cipher_len; n_cribs++) ;
+
+	for (i = 0; i < BENCHMARK_STATES; i++) {
+		state = &states[i];
+		random_keyword(state->plaintext_keyword, ALPHABET_SIZE, plaintext_keyword_len);
+		random_keyword(state->ciphertext_keyword, ALPHABET_SIZE, ciphertext_keyword_len);
+		if (cipher_type == QUAGMIRE_2 || cipher_type == BEAUFORT) {
+			straight_alphabet(state->plaintext_keyword, ALPHABET_SIZE);
+		}
+		if (cipher_type == QUAGMIRE_1 || cipher_type == BEAUFORT) {
+			straight_alphabet(state->ciphertext_keyword, ALPHABET_SIZE);
+		}
+		if (cipher_type == VIGENERE || cipher_type == QUAGMIRE_3) {
+			vec_copy(state->plaintext_keyword, state->ciphertext_keyword, ALPHABET_SIZE);
+		}
+		random_cycleword(state->cycleword, ALPHABET_SIZE, cycleword_len);
+	}
+
+	printf("\nBenchmarks (%d calls each, cycleword length %d):\n\n", n_calls, cycleword_len);
+
+	start = wall_clock();
+	for (i = 0; i < n_calls; i++) {
+		state = &states[i % BENCHMARK_STATES];
+		quagmire_decrypt(decrypted, job->cipher_indices, cipher_len, state->plaintext_keyword, 
+			state->ciphertext_keyword, state->cycleword, cycleword_len, beaufort);
+		checksum += decrypted[i % cipher_len];
+	}
+	report_benchmark("quagmire_decrypt", n_calls, wall_clock() - start, checksum);
+
+	plaintexts = malloc(BENCHMARK_STATES*cipher_len);
+	for (i = 0; i < BENCHMARK_STATES; i++) {
+		quagmire_decrypt(plaintexts + i*cipher_len, job->cipher_indices, cipher_len, states[i].plaintext_keyword, 
+			states[i].ciphertext_keyword, states[i].cycleword, cycleword_len, beaufort);
+	}
+
+	start = wall_clock();
+	for (i = 0; i < n_calls; i++) {
+		checksum += ngram_score(plaintexts + (i % BENCHMARK_STATES)*cipher_len, cipher_len, 
+			settings->ngram_data, settings->ngram_size);
+	}
+	report_benchmark("ngram_score", n_calls, wall_clock() - start, checksum);
+
+	free(plaintexts);
+
+	start = wall_clock();
+	for (i = 0; i < n_calls; i++) {
+		state = &states[i % BENCHMARK_STATES];
+		checksum += state_score(job->cipher_indices, cipher_len, 
+			job->crib_indices, job->crib_positions, n_cribs, 
+			state->plaintext_keyword, state->ciphertext_keyword, state->cycleword, cycleword_len, 
+			variant, beaufort, decrypted, settings->ngram_data, settings->ngram_size, 
+			settings->weight_ngram, settings->weight_crib, settings->weight_ioc, settings->weight_entropy);
+	}
+	report_benchmark("state_score", n_calls, wall_clock() - start, checksum);
+
+	climber_setup(&shared, cipher_type, job->cipher_indices, cipher_len, 
+		job->crib_indices, job->crib_positions, n_cribs, 
+		cycleword_len, plaintext_keyword_len, ciphertext_keyword_len, 
+		settings->n_hill_climbs, settings->n_restarts, settings->n_batch, 
+		settings->ngram_data, settings->ngram_size, 
+		settings->backtracking_probability, settings->keyword_permutation_probability, settings->slip_probability, 
+		settings->weight_ngram, settings->weight_crib, settings->weight_ioc, settings->weight_entropy, 
+		variant, beaufort, settings->early_abort, false);
+	score_cache_setup(cache, &shared);
+	score_cache_init(cache, states[0].plaintext_keyword, states[0].ciphertext_keyword, states[0].cycleword);
+
+	start = wall_clock();
+	for (i = 0; i < n_calls; i++) {
+		column = i % cycleword_len;
+		checksum += score_cache_update_column(cache, column, 
+			(states[0].cycleword[column] + 1 + i % (ALPHABET_SIZE - 1)) % ALPHABET_SIZE, -INFINITY);
+		score_cache_revert(cache);
+	}
+	report_benchmark("score_cache_update_column", n_calls, wall_clock() - start, checksum);
+
+	start = wall_clock();
+	for (i = 0; i < n_calls; i++) {
+		state = &states[i % BENCHMARK_STATES];
+		checksum += score_cache_update_state(cache, state->plaintext_keyword, 
+			state->ciphertext_keyword, state->cycleword, -INFINITY);
+		score_cache_revert(cache);
+	}
+	report_benchmark("score_cache_update_state", n_calls, wall_clock() - start, checksum);
+
+	free(cache);
+
+	return ;
+}
+
+
+
+// Print the mean time per call of a benchmark. The running checksum of the results is 
+// printed too, so that the calls cannot be optimised away. 
+
+void report_benchmark(char *name, int n_calls, double elapsed, double checksum) {
+
+	printf("%-28s %10.1f [ns/call]    (checksum %.4f)\n", name, 1.e9*elapsed/max(1, n_calls), checksum);
+
+	return ;
+}
+
+
+
+// Solve the ciphers of a manifest on n_workers threads. Each line of the manifest is a 
+// ciphertext file name (or the ciphertext itself) followed by any per-cipher options, 
+// which override those on the command line. Blank lines and lines starting with '#' 
+// are skipped. A summary line is printed for each cipher as soon as it is solved. 
+
+void run_manifest(manifest_reader *reader, int n_workers) {
+
+	int t;
+	pthread_t threads[MAX_THREADS];
+
+	pthread_mutex_init(&reader->lock, NULL);
+	reader->n_lines = 0;
+	split_rand(&reader->stream);
+	atomic_init(&reader->n_solved, 0);
+	atomic_init(&reader->n_failed, 0);
+
+	if (n_workers == 1) {
+		manifest_worker(reader);
+	} else {
+		for (t = 0; t < n_workers; t++) {
+			if (pthread_create(&threads[t], NULL, manifest_worker, reader) != 0) {
+				printf("\n\nERROR: failed to create manifest thread %d.\n\n", t);
+				exit(1);
+			}
+		}
+		for (t = 0; t < n_workers; t++) {
+			pthread_join(threads[t], NULL);
+		}
+	}
+
+	pthread_mutex_destroy(&reader->lock);
+
+	return ;
+}
+
+
+
+// Take the next cipher of the manifest, with its line number and its own random stream 
+// (handed out in line order, so that each cipher's run is reproducible from the seed 
+// whichever thread solves it). The line is malloc'ed. Returns false at the end of the 
+// manifest. 
+
+bool read_manifest_line(manifest_reader *reader, char **line, int *n_line, rand_stream *stream) {
+
+	size_t capacity;
+	char *first;
+	bool found = false;
+
+	pthread_mutex_lock(&reader->lock);
+
+	while (! found) {
+		*line = NULL;
+		capacity = 0;
+		if (getline(line, &capacity, reader->fp) < 0) {
+			free(*line);
+			break ;
+		}
+		*n_line = ++reader->n_lines;
+		first = *line + strspn(*line, " \t\r\n");
+		if (*first == '\0' || *first == '#') {
+			free(*line);
+			continue ;
+		}
+		*stream = reader->stream;
+		long_jump_rand(&reader->stream);
+		found = true;
+	}
+
+	pthread_mutex_unlock(&reader->lock);
+
+	return found;
+}
+
+
+
+void *manifest_worker(void *arg) {
+
+	manifest_reader *reader = (manifest_reader *) arg;
+	solver_settings *settings = reader->settings;
+	cipher_options options;
+	cipher_job *job;
+	char *line, *token, *save, **tokens, *plaintext_string;
+	int i, n, n_line, n_tokens;
+	bool ok;
+
+	job = calloc(1, sizeof(cipher_job));
+
+	while (read_manifest_line(reader, &line, &n_line, &rand_state)) {
+
+		// Split the line into the cipher and its options. 
+
+		tokens = malloc((strlen(line)/2 + 1)*sizeof(char *));
+		n_tokens = 0;
+		for (token = strtok_r(line, " \t\r\n", &save); token != NULL; token = strtok_r(NULL, " \t\r\n", &save)) {
+			tokens[n_tokens++] = token;
+		}
+
+		snprintf(job->name, MAX_FILENAME_LEN, "line %d", n_line);
+		options = *reader->defaults;
+		ok = n_tokens > 0;
+		for (i = 1; i < n_tokens && ok; i++) {
+			n = parse_cipher_option(&options, n_tokens, tokens, i, false);
+			if (n == 0) {
+				printf("\n\nERROR: manifest line %d: unknown arg '%s'\n\n", n_line, tokens[i]);
+			}
+			ok = n > 0;
+			i += n - 1;
+		}
+
+		ok = ok && check_cipher_options(&options) 
+			&& load_cipher_job(job, tokens[0], &options, true, settings->verbose) 
+			&& solve_cipher(job, settings);
+
+		if (! ok) {
+			printf("\n\nERROR: manifest line %d skipped.\n\n", n_line);
+			atomic_fetch_add(&reader->n_failed, 1);
+			free_cipher_job(job);
+			free(tokens);
+			free(line);
+			continue ;
+		}
+
+		job->n_words_found = INACTIVE;
+		if (settings->dict != NULL) {
+			plaintext_string = text_string(job->best_decrypted, job->cipher_len);
+			job->n_words_found = find_dictionary_words(plaintext_string, settings->dict, false);
+			free(plaintext_string);
+		}
+
+		report_result(settings, job);
+
+		atomic_fetch_add(&reader->n_solved, 1);
+		free_cipher_job(job);
+		free(tokens);
+		free(line);
+	}
+
+	free(job);
+
+	return NULL;
+}
+
+
+
+// Slippery stochastic shotgun restarted hill climber for Quagmire ciphers. The restarts 
+// are shared between n_threads workers, each with its own scratch buffers and random 
+// number generator. The workers share the best state found so far (which is also the 
+// state that backtracking returns to). 
+
+double quagmire_shotgun_hill_climber(
+	int cipher_type, 
+	uint8_t cipher_indices[], int cipher_len, 
+	uint8_t crib_indices[], int crib_positions[], int n_cribs,
+	int cycleword_len, int plaintext_keyword_len, int ciphertext_keyword_len, 
+	int n_hill_climbs, int n_restarts, int n_batch, 
+	ngram_table *ngram_data, int ngram_size,
+	uint8_t decrypted[MAX_CIPHER_LENGTH], uint8_t plaintext_keyword[ALPHABET_SIZE], 
+	uint8_t ciphertext_keyword[ALPHABET_SIZE], uint8_t cycleword[ALPHABET_SIZE],
+	double backtracking_probability, double keyword_permutation_probability, double slip_probability,
+	float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy, 
+	bool variant, bool beaufort, bool early_abort, int n_threads, bool verbose) {
+
+	climber_shared shared;
+
+	climber_setup(&shared, cipher_type, cipher_indices, cipher_len, 
+		crib_indices, crib_positions, n_cribs, 
+		cycleword_len, plaintext_keyword_len, ciphertext_keyword_len, 
+		n_hill_climbs, n_restarts, n_batch, ngram_data, ngram_size, 
+		backtracking_probability, keyword_permutation_probability, slip_probability, 
+		weight_ngram, weight_crib, weight_ioc, weight_entropy, 
+		variant, beaufort, early_abort, verbose);
+
+	return run_hill_climber(&shared, n_threads, decrypted, plaintext_keyword, ciphertext_keyword, cycleword);
+}
+
+
+
+// Fill in the (read-only) problem description for the hill climbing workers. 
+
+void climber_setup(climber_shared *shared, 
+	int cipher_type, 
+	uint8_t cipher_indices[], int cipher_len, 
+	uint8_t crib_indices[], int crib_positions[], int n_cribs,
+	int cycleword_len, int plaintext_keyword_len, int ciphertext_keyword_len, 
+	int n_hill_climbs, int n_restarts, int n_batch, 
+	ngram_table *ngram_data, int ngram_size,
+	double backtracking_probability, double keyword_permutation_probability, double slip_probability,
+	float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy, 
+	bool variant, bool beaufort, bool early_abort, bool verbose) {
+
+	shared->cipher_type = cipher_type;
+	shared->cipher_indices = cipher_indices;
+	shared->cipher_len = cipher_len;
+	shared->crib_indices = crib_indices;
+	shared->crib_positions = crib_positions;
+	shared->n_cribs = n_cribs;
+	shared->cycleword_len = cycleword_len;
+	shared->plaintext_keyword_len = plaintext_keyword_len;
+	shared->ciphertext_keyword_len = ciphertext_keyword_len;
+	shared->n_hill_climbs = n_hill_climbs;
+	shared->n_restarts = n_restarts;
+	shared->n_batch = n_batch;
+	shared->ngram_data = ngram_data;
+	shared->ngram_size = ngram_size;
+	shared->backtracking_probability = backtracking_probability;
+	shared->keyword_permutation_probability = keyword_permutation_probability;
+	shared->slip_probability = slip_probability;
+	shared->weight_ngram = weight_ngram;
+	shared->weight_crib = weight_crib;
+	shared->weight_ioc = weight_ioc;
+	shared->weight_entropy = weight_entropy;
+	shared->variant = variant;
+	shared->beaufort = beaufort;
+	shared->early_abort = early_abort;
+	shared->verbose = verbose;
+	shared->top_k = 1;
+	shared->engine = ENGINE_HILL;
+	shared->swap_interval = SWAP_INTERVAL;
+	shared->start_temperature = START_TEMPERATURE;
+	shared->end_temperature = END_TEMPERATURE;
+	shared->n_confirm = 0;
+	shared->n_stall = 0;
+	shared->keyword_search = KEYWORD_RANDOM;
+	shared->keywords = NULL;
+	shared->target_score = 0.;
+	shared->deadline = 0.;
+	shared->sweep = NULL;
+	shared->triple = NULL;
+	shared->stats = NULL;
+	shared->solution_indices = NULL;
+	shared->solved_time = NULL;
+	shared->reporter = NULL;
+	shared->name = NULL;
+
+	return ;
+}
+
+
+
+// Run the restarts described by shared on n_threads workers and return the best state. 
+
+double run_hill_climber(climber_shared *shared, int n_threads, 
+	uint8_t decrypted[MAX_CIPHER_LENGTH], uint8_t plaintext_keyword[ALPHABET_SIZE], 
+	uint8_t ciphertext_keyword[ALPHABET_SIZE], uint8_t cycleword[ALPHABET_SIZE]) {
+
+	int t, cycleword_len;
+	climber_worker workers[MAX_THREADS];
+	pthread_t threads[MAX_THREADS];
+
+	if (shared->cipher_type == VIGENERE) {
+		shared->cycleword_len = ALPHABET_SIZE;
+	}
+	cycleword_len = shared->cycleword_len;
+
+	n_threads = max(1, min(n_threads, MAX_THREADS));
+
+	// Shared best state and restart pool. 
+
+	pthread_mutex_init(&shared->lock, NULL);
+	shared->best_score = 0.;
+	straight_alphabet(shared->best_state.plaintext_keyword, ALPHABET_SIZE);
+	straight_alphabet(shared->best_state.ciphertext_keyword, ALPHABET_SIZE);
+	for (t = 0; t < MAX_CYCLEWORD_LEN; t++) shared->best_state.cycleword[t] = 0;
+	solution_heap_init(&shared->top, shared->top_k);
+	tempering_setup(shared, n_threads);
+	shared->confirmed_hash = 0;
+	shared->confirmed_score = -INFINITY;
+	shared->n_confirmations = 0;
+	shared->n_stalled = 0;
+	atomic_init(&shared->next_restart, 0);
+	atomic_init(&shared->n_borrowed, 0);
+	atomic_init(&shared->dropped, false);
+	atomic_init(&shared->converged, false);
+
+	// Continue a triple resumed from a checkpoint from its best state and restart count. 
+
+	if (shared->triple != NULL && shared->triple->n_restarts_done > 0) {
+		shared->best_score = shared->triple->score;
+		vec_copy(shared->triple->plaintext_keyword, shared->best_state.plaintext_keyword, ALPHABET_SIZE);
+		vec_copy(shared->triple->ciphertext_keyword, shared->best_state.ciphertext_keyword, ALPHABET_SIZE);
+		vec_copy(shared->triple->cycleword, shared->best_state.cycleword, cycleword_len);
+		atomic_init(&shared->next_restart, shared->triple->n_restarts_done);
+		atomic_init(&shared->dropped, shared->triple->dropped);
+		atomic_init(&shared->converged, shared->triple->converged);
+		solution_heap_merge(&shared->top, &shared->triple->top);
+	}
+	atomic_init(&shared->n_iterations, 0);
+	atomic_init(&shared->n_backtracks, 0);
+	atomic_init(&shared->n_explore, 0);
+	atomic_init(&shared->n_contradictions, 0);
+	shared->start_time = wall_clock();
+
+	// Run the workers. Each worker gets its own random stream, split from the 
+	// calling thread's generator. 
+
+	for (t = 0; t < n_threads; t++) {
+		workers[t].shared = shared;
+		workers[t].id = t;
+		split_rand(&workers[t].stream);
+	}
+
+	if (n_threads == 1) {
+		quagmire_hill_climber_worker(&workers[0]);
+	} else {
+		for (t = 0; t < n_threads; t++) {
+			if (pthread_create(&threads[t], NULL, quagmire_hill_climber_worker, &workers[t]) != 0) {
+				printf("\n\nERROR: failed to create worker thread %d.\n\n", t);
+				exit(1);
+			}
+		}
+		for (t = 0; t < n_threads; t++) {
+			pthread_join(threads[t], NULL);
+		}
+	}
+
+	pthread_mutex_destroy(&shared->lock);
+
+	if (shared->verbose && shared->engine == ENGINE_TEMPERING) {
+		printf("\n%ld of %ld tempering swaps accepted\n", shared->n_swaps, shared->n_swap_attempts);
+	}
+
+	vec_copy(shared->best_state.plaintext_keyword, plaintext_keyword, ALPHABET_SIZE);
+	vec_copy(shared->best_state.ciphertext_keyword, ciphertext_keyword, ALPHABET_SIZE);
+	vec_copy(shared->best_state.cycleword, cycleword, cycleword_len);
+
+	if (shared->variant) {
+		quagmire_encrypt(decrypted, shared->cipher_indices, shared->cipher_len, 
+						shared->best_state.plaintext_keyword, shared->best_state.ciphertext_keyword, 
+						shared->best_state.cycleword, cycleword_len, shared->beaufort);
+	} else {
+		quagmire_decrypt(decrypted, shared->cipher_indices, shared->cipher_len, 
+						shared->best_state.plaintext_keyword, shared->best_state.ciphertext_keyword, 
+						shared->best_state.cycleword, cycleword_len, shared->beaufort);
+	}
+
+	return shared->best_score;
+}
+
+
+
+// Run the hill climber for each length triple on a work-stealing pool of n_jobs threads, 
+// each of which runs its triples with n_threads restart workers. The triples are dealt 
+// round-robin to per-thread deques; a thread pops from the back of its own deque and, 
+// once it is empty, steals from the front of the others. 
+
+void run_length_sweep(climber_shared *climber_template, length_triple triples[], int n_triples, 
+	int n_jobs, int n_threads, double drop_threshold, char *checkpoint_file, double checkpoint_interval) {
+
+	int t;
+	double leader_score = 0.;
+	length_sweep sweep;
+	sweep_worker workers[MAX_THREADS];
+	pthread_t threads[MAX_THREADS];
+
+	n_jobs = max(1, min(n_jobs, MAX_THREADS));
+
+	// Triples resumed from a checkpoint already contribute to the leading score. 
+
+	for (t = 0; t < n_triples; t++) {
+		leader_score = max(leader_score, triples[t].score);
+	}
+
+	sweep.climber_template = climber_template;
+	sweep.triples = triples;
+	sweep.n_triples = n_triples;
+	sweep.n_deques = n_jobs;
+	sweep.n_threads = n_threads;
+	sweep.drop_threshold = drop_threshold;
+	atomic_init(&sweep.leader_score, leader_score);
+	atomic_init(&sweep.spare_restarts, 0);
+	pthread_mutex_init(&sweep.checkpoint_lock, NULL);
+	sweep.checkpoint_file = checkpoint_file;
+	sweep.checkpoint_interval = checkpoint_interval;
+	sweep.last_checkpoint = wall_clock();
+
+	for (t = 0; t < n_jobs; t++) {
+		pthread_mutex_init(&sweep.deques[t].lock, NULL);
+		sweep.deques[t].jobs = malloc((n_triples/n_jobs + 1)*sizeof(int));
+		sweep.deques[t].head = 0;
+		sweep.deques[t].tail = 0;
+	}
+
+	// Deal the triples in reverse, so that each thread pops its triples in queued order. 
+
+	for (t = n_triples - 1; t >= 0; t--) {
+		job_deque *deque = &sweep.deques[t % n_jobs];
+		deque->jobs[deque->tail++] = t;
+	}
+
+	// Each job thread gets a stream far enough from the next for all of its restart 
+	// workers' streams. A resumed sweep's streams are split from the stream recorded 
+	// here, which lies past all of them. 
+
+	for (t = 0; t < n_jobs; t++) {
+		workers[t].sweep = &sweep;
+		workers[t].id = t;
+		split_rand_jobs(&workers[t].stream);
+	}
+	sweep.stream = rand_state;
+
+	if (n_jobs == 1) {
+		length_sweep_worker(&workers[0]);
+	} else {
+		for (t = 0; t < n_jobs; t++) {
+			if (pthread_create(&threads[t], NULL, length_sweep_worker, &workers[t]) != 0) {
+				printf("\n\nERROR: failed to create job thread %d.\n\n", t);
+				exit(1);
+			}
+		}
+		for (t = 0; t < n_jobs; t++) {
+			pthread_join(threads[t], NULL);
+		}
+	}
+
+	for (t = 0; t < n_jobs; t++) {
+		pthread_mutex_destroy(&sweep.deques[t].lock);
+		free(sweep.deques[t].jobs);
+	}
+
+	if (checkpoint_file != NULL) {
+		write_checkpoint(&sweep);
+	}
+	pthread_mutex_destroy(&sweep.checkpoint_lock);
+
+	return ;
+}
+
+
+
+// Take the next length triple, first from the back of our own deque, then from the 
+// front of any other deque. Returns -1 once every deque is empty. 
+
+int next_length_triple(length_sweep *sweep, int id) {
+
+	int t, job = -1;
+	job_deque *deque;
+
+	for (t = 0; t < sweep->n_deques && job < 0; t++) {
+		deque = &sweep->deques[(id + t) % sweep->n_deques];
+		pthread_mutex_lock(&deque->lock);
+		if (deque->head < deque->tail) {
+			if (t == 0) {
+				job = deque->jobs[--deque->tail];
+			} else {
+				job = deque->jobs[deque->head++];
+			}
+		}
+		pthread_mutex_unlock(&deque->lock);
+	}
+
+	return job;
+}
+
+
+
+void *length_sweep_worker(void *arg) {
+
+	sweep_worker *worker = (sweep_worker *) arg;
+	length_sweep *sweep = worker->sweep;
+	length_triple *triple;
+	climber_shared shared;
+	int job;
+	double score;
+	uint8_t decrypted[MAX_CIPHER_LENGTH], plaintext_keyword[ALPHABET_SIZE], ciphertext_keyword[ALPHABET_SIZE], 
+		cycleword[MAX_CYCLEWORD_LEN];
+
+	rand_state = worker->stream;
+
+	while ((job = next_length_triple(sweep, worker->id)) >= 0) {
+
+		triple = &sweep->triples[job];
+
+		shared = *sweep->climber_template;
+		shared.cycleword_len = triple->cycleword_len;
+		shared.plaintext_keyword_len = triple->plaintext_keyword_len;
+		shared.ciphertext_keyword_len = triple->ciphertext_keyword_len;
+		shared.n_restarts = n_keyword_restarts(&shared);
+		shared.sweep = sweep;
+		shared.triple = triple;
+
+		score = run_hill_climber(&shared, sweep->n_threads, decrypted, 
+			plaintext_keyword, ciphertext_keyword, cycleword);
+
+		pthread_mutex_lock(&sweep->checkpoint_lock);
+		triple->score = score;
+		vec_copy(plaintext_keyword, triple->plaintext_keyword, ALPHABET_SIZE);
+		vec_copy(ciphertext_keyword, triple->ciphertext_keyword, ALPHABET_SIZE);
+		vec_copy(cycleword, triple->cycleword, shared.cycleword_len);
+		triple->dropped = atomic_load(&shared.dropped);
+		triple->converged = atomic_load(&shared.converged);
+		triple->n_restarts_run = min(atomic_load(&shared.next_restart), shared.n_restarts) + atomic_load(&shared.n_borrowed);
+		triple->top = shared.top;
+		pthread_mutex_unlock(&sweep->checkpoint_lock);
+
+		// With the adaptive controller, the restarts a triple stopped early has not used 
+		// go to the triples still running. 
+
+		if ((shared.n_confirm > 0 || shared.n_stall > 0) && (triple->dropped || triple->converged)) {
+			atomic_fetch_add(&sweep->spare_restarts, 
+				max(0, shared.n_restarts + atomic_load(&shared.n_borrowed) - triple->n_restarts_done));
+		}
+
+		if (shared.verbose && triple->converged) {
+			pthread_mutex_lock(&print_lock);
+			printf("\nConverged plaintext, ciphertext, cycleword lengths = %d, %d, %d after %d restarts "
+				"(score %.2f, reached by %d restarts)\n", 
+				triple->plaintext_keyword_len, triple->ciphertext_keyword_len, triple->cycleword_len, 
+				triple->n_restarts_done, triple->score, shared.n_confirmations);
+			pthread_mutex_unlock(&print_lock);
+		}
+
+		if (shared.verbose && triple->dropped) {
+			pthread_mutex_lock(&print_lock);
+			printf("\nDropped plaintext, ciphertext, cycleword lengths = %d, %d, %d after %d restarts "
+				"(score %.2f, leader %.2f)\n", 
+				triple->plaintext_keyword_len, triple->ciphertext_keyword_len, triple->cycleword_len, 
+				triple->n_restarts_run, triple->score, atomic_load(&sweep->leader_score));
+			pthread_mutex_unlock(&print_lock);
+		}
+	}
+
+	return NULL;
+}
+
+
+
+// Raise the sweep's leading score to at least score (lock-free). 
+
+void update_sweep_leader(length_sweep *sweep, double score) {
+
+	double leader = atomic_load(&sweep->leader_score);
+
+	while (score > leader && ! atomic_compare_exchange_weak(&sweep->leader_score, &leader, score)) ;
+
+	return ;
+}
+
+
+
+// Has this length triple fallen so far behind the leading triple that it should be 
+// dropped? Triples are given at least a tenth of their restarts before they are judged. 
+
+bool drop_length_triple_p(climber_shared *shared, int n_restart) {
+
+	length_sweep *sweep = shared->sweep;
+	double best_score;
+
+	if (sweep == NULL || sweep->drop_threshold <= 0.) {
+		return false;
+	}
+
+	if (n_restart < shared->n_restarts/10) {
+		return false;
+	}
+
+	pthread_mutex_lock(&shared->lock);
+	best_score = shared->best_score;
+	pthread_mutex_unlock(&shared->lock);
+
+	return best_score < sweep->drop_threshold*atomic_load(&sweep->leader_score);
+}
+
+
+
+// Count a completed restart of a sweep's length triple, take the triple's best state 
+// so far from the shared best, and write a checkpoint if one is due. 
+
+void record_restart(climber_shared *shared) {
+
+	length_sweep *sweep = shared->sweep;
+	length_triple *triple = shared->triple;
+	double best_score;
+	quagmire_state best_state;
+	solution_heap top;
+
+	pthread_mutex_lock(&shared->lock);
+	best_score = shared->best_score;
+	best_state = shared->best_state;
+	if (shared->top_k > 1) {
+		top = shared->top;
+	}
+	pthread_mutex_unlock(&shared->lock);
+
+	pthread_mutex_lock(&sweep->checkpoint_lock);
+
+	triple->n_restarts_done += 1;
+	if (best_score > triple->score) {
+		triple->score = best_score;
+		vec_copy(best_state.plaintext_keyword, triple->plaintext_keyword, ALPHABET_SIZE);
+		vec_copy(best_state.ciphertext_keyword, triple->ciphertext_keyword, ALPHABET_SIZE);
+		vec_copy(best_state.cycleword, triple->cycleword, shared->cycleword_len);
+	}
+	if (shared->top_k > 1) {
+		triple->top = top;
+	}
+
+	if (sweep->checkpoint_file != NULL 
+		&& wall_clock() - sweep->last_checkpoint >= sweep->checkpoint_interval) {
+		write_checkpoint(sweep);
+		sweep->last_checkpoint = wall_clock();
+	}
+
+	pthread_mutex_unlock(&sweep->checkpoint_lock);
+
+	return ;
+}
+
+
+
+// Empty a heap of at most capacity solutions. 
+
+void solution_heap_init(solution_heap *heap, int capacity) {
+	heap->n_solutions = 0;
+	heap->capacity = max(1, min(capacity, MAX_TOP_K));
+	return ;
+}
+
+
+
+// Add a solution to a heap, unless a solution with the same plaintext hash is already 
+// there (different keys can give the same plaintext), or the heap is full of better 
+// solutions. Returns true if the solution was added. 
+
+bool solution_heap_insert(solution_heap *heap, quagmire_state *state, double score, uint64_t hash, 
+	int cycleword_len) {
+
+	int i, child;
+	solution *solutions = heap->solutions, entry;
+
+	for (i = 0; i < heap->n_solutions; i++) {
+		if (solutions[i].hash == hash) {
+			return false;
+		}
+	}
+
+	entry.state = *state;
+	entry.score = score;
+	entry.hash = hash;
+	entry.cycleword_len = cycleword_len;
+
+	if (heap->n_solutions < heap->capacity) {
+		// Sift up from the new leaf. 
+		i = heap->n_solutions++;
+		while (i > 0 && solutions[(i - 1)/2].score > score) {
+			solutions[i] = solutions[(i - 1)/2];
+			i = (i - 1)/2;
+		}
+		solutions[i] = entry;
+		return true;
+	}
+
+	if (score <= solutions[0].score) {
+		return false;
+	}
+
+	// Replace the worst solution and sift down. 
+
+	i = 0;
+	while ((child = 2*i + 1) < heap->n_solutions) {
+		if (child + 1 < heap->n_solutions && solutions[child + 1].score < solutions[child].score) {
+			child += 1;
+		}
+		if (solutions[child].score >= score) {
+			break ;
+		}
+		solutions[i] = solutions[child];
+		i = child;
+	}
+	solutions[i] = entry;
+
+	return true;
+}
+
+
+
+// Add the solutions of one heap to another. 
+
+void solution_heap_merge(solution_heap *heap, solution_heap *from) {
+
+	int i;
+
+	for (i = 0; i < from->n_solutions; i++) {
+		solution_heap_insert(heap, &from->solutions[i].state, from->solutions[i].score, 
+			from->solutions[i].hash, from->solutions[i].cycleword_len);
+	}
+
+	return ;
+}
+
+
+
+// Copy the solutions of a heap to sorted, best first. 
+
+void solution_heap_sort(solution_heap *heap, solution sorted[]) {
+
+	int i, j;
+	solution entry;
+
+	for (i = 0; i < heap->n_solutions; i++) {
+		entry = heap->solutions[i];
+		for (j = i; j > 0 && sorted[j - 1].score < entry.score; j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = entry;
+	}
+
+	return ;
+}
+
+
+
+// FNV-1a hash of a plaintext, used to tell distinct solutions apart. 
+
+uint64_t plaintext_hash(uint8_t plaintext[], int len) {
+
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		hash = (hash ^ plaintext[i])*0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+
+
+// FNV-1a hash of the problem a checkpoint belongs to: the ciphertext, the cribs, the 
+// cipher type and variant. 
+
+uint64_t checkpoint_hash(climber_shared *shared) {
+
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	int i, values[4] = {shared->cipher_type, shared->variant, shared->cipher_len, shared->n_cribs};
+
+	#define FNV_MIX(x) (hash = (hash ^ (uint64_t) (x))*0x100000001B3ULL)
+
+	for (i = 0; i < 4; i++) FNV_MIX(values[i]);
+	for (i = 0; i < shared->cipher_len; i++) FNV_MIX(shared->cipher_indices[i]);
+	for (i = 0; i < shared->n_cribs; i++) {
+		FNV_MIX(shared->crib_positions[i]);
+		FNV_MIX(shared->crib_indices[i]);
+	}
+
+	#undef FNV_MIX
+
+	return hash;
+}
+
+
+
+// Write the sweep's triples to its checkpoint file (called with checkpoint_lock held). 
+// The checkpoint is written to a temporary file which is then renamed, so an interrupted 
+// write leaves the previous checkpoint intact. 
+
+bool write_checkpoint(length_sweep *sweep) {
+
+	FILE *fp;
+	char tmp_file[MAX_FILENAME_LEN + 8];
+	checkpoint_header header;
+	checkpoint_triple record;
+	length_triple *triple;
+	int i;
+	bool ok;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.hash = checkpoint_hash(sweep->climber_template);
+	header.n_triples = sweep->n_triples;
+	header.stream = sweep->stream;
+
+	snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", sweep->checkpoint_file);
+	fp = fopen(tmp_file, "wb");
+	if (fp == NULL) {
+		printf("\n\nERROR: failed to open checkpoint file %s.\n\n", tmp_file);
+		return false;
+	}
+
+	ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+	for (i = 0; ok && i < sweep->n_triples; i++) {
+		triple = &sweep->triples[i];
+		memset(&record, 0, sizeof(record));
+		record.cycleword_len = triple->cycleword_len;
+		record.plaintext_keyword_len = triple->plaintext_keyword_len;
+		record.ciphertext_keyword_len = triple->ciphertext_keyword_len;
+		record.n_restarts_done = triple->n_restarts_done;
+		record.score = triple->score;
+		record.dropped = triple->dropped;
+		record.converged = triple->converged;
+		vec_copy(triple->plaintext_keyword, record.plaintext_keyword, ALPHABET_SIZE);
+		vec_copy(triple->ciphertext_keyword, record.ciphertext_keyword, ALPHABET_SIZE);
+		vec_copy(triple->cycleword, record.cycleword, MAX_CYCLEWORD_LEN);
+		record.top = triple->top;
+		ok = fwrite(&record, sizeof(record), 1, fp) == 1;
+	}
+
+	ok = (fclose(fp) == 0) && ok;
+
+	if (! ok || rename(tmp_file, sweep->checkpoint_file) != 0) {
+		printf("\n\nERROR: failed to write checkpoint file %s.\n\n", sweep->checkpoint_file);
+		remove(tmp_file);
+		return false;
+	}
+
+	return true;
+}
+
+
+
+// Restore the triples of a sweep from a checkpoint written by write_checkpoint, and the 
+// calling thread's generator from its stream. The checkpoint must be of the same 
+// problem and length triples. 
+
+bool read_checkpoint(char *checkpoint_file, climber_shared *climber_template, 
+	length_triple triples[], int n_triples) {
+
+	FILE *fp;
+	checkpoint_header header;
+	checkpoint_triple *records;
+	length_triple *triple;
+	int i;
+	bool ok;
+
+	fp = fopen(checkpoint_file, "rb");
+	if (fp == NULL) {
+		printf("\n\nERROR: failed to open checkpoint file %s.\n\n", checkpoint_file);
+		return false;
+	}
+
+	if (fread(&header, sizeof(header), 1, fp) != 1 
+		|| memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+		printf("\n\nERROR: %s is not a checkpoint file.\n\n", checkpoint_file);
+		fclose(fp);
+		return false;
+	}
+
+	if (header.hash != checkpoint_hash(climber_template) || header.n_triples != n_triples) {
+		printf("\n\nERROR: checkpoint file %s is of a different cipher, cribs or key lengths.\n\n", 
+			checkpoint_file);
+		fclose(fp);
+		return false;
+	}
+
+	records = malloc(max(1, n_triples)*sizeof(checkpoint_triple));
+	ok = fread(records, sizeof(checkpoint_triple), n_triples, fp) == (size_t) n_triples;
+	fclose(fp);
+
+	for (i = 0; ok && i < n_triples; i++) {
+		ok = records[i].cycleword_len == triples[i].cycleword_len 
+			&& records[i].plaintext_keyword_len == triples[i].plaintext_keyword_len 
+			&& records[i].ciphertext_keyword_len == triples[i].ciphertext_keyword_len;
+	}
+
+	if (! ok) {
+		printf("\n\nERROR: checkpoint file %s is truncated or of different key lengths.\n\n", 
+			checkpoint_file);
+		free(records);
+		return false;
+	}
+
+	for (i = 0; i < n_triples; i++) {
+		triple = &triples[i];
+		triple->n_restarts_done = records[i].n_restarts_done;
+		triple->score = records[i].score;
+		triple->dropped = records[i].dropped;
+		triple->converged = records[i].converged;
+		vec_copy(records[i].plaintext_keyword, triple->plaintext_keyword, ALPHABET_SIZE);
+		vec_copy(records[i].ciphertext_keyword, triple->ciphertext_keyword, ALPHABET_SIZE);
+		vec_copy(records[i].cycleword, triple->cycleword, MAX_CYCLEWORD_LEN);
+		triple->top.n_solutions = 0;
+		solution_heap_merge(&triple->top, &records[i].top);
+	}
+
+	free(records);
+	rand_state = header.stream;
+
+	return true;
+}
+
+
+
+// Returns the index of a search engine name (see engine_names), or INACTIVE. 
+
+int search_engine(char *name) {
+
+	for (int i = 0; i < N_ENGINES; i++) {
+		if (strcmp(name, engine_names[i]) == 0) {
+			return i;
+		}
+	}
+
+	return INACTIVE;
+}
+
+
+
+// Returns the index of a keyword search name (see keyword_search_names), or INACTIVE. 
+
+int keyword_search(char *name) {
+
+	for (int i = 0; i < N_KEYWORD_SEARCHES; i++) {
+		if (strcmp(name, keyword_search_names[i]) == 0) {
+			return i;
+		}
+	}
+
+	return INACTIVE;
+}
+
+
+
+// The number of restarts of a climb. An exhaustive keyword search runs n_restarts for 
+// every keyed alphabet of the keyword list with the searched keyword's length (the 
+// plaintext keyword, or the ciphertext keyword of a Quagmire II). 
+
+int n_keyword_restarts(climber_shared *shared) {
+
+	keyword_index *index = shared->keywords;
+	int keyword_len = shared->cipher_type == QUAGMIRE_2 ? shared->ciphertext_keyword_len : shared->plaintext_keyword_len;
+
+	if (shared->keyword_search != KEYWORD_EXHAUSTIVE || index == NULL || keyword_len > MAX_KEYWORD_LEN) {
+		return shared->n_restarts;
+	}
+
+	return shared->n_restarts*(index->offsets[keyword_len + 1] - index->offsets[keyword_len]);
+}
+
+
+
+// The keyword restart n starts from: with -keywordsearch seed, a random keyed alphabet of 
+// the keyword list with the keyword length, and with -keywordsearch exhaustive, each of 
+// them in turn (so every one is tried once before any is tried again). Otherwise, or if 
+// the list has no keywords of the length, a random keyword. 
+
+void initial_keyword(climber_shared *shared, uint8_t keyword[], int keyword_len, int n) {
+
+	keyword_index *index = shared->keywords;
+	int n_alphabets = 0;
+
+	if (shared->keyword_search != KEYWORD_RANDOM && index != NULL && keyword_len <= MAX_KEYWORD_LEN) {
+		n_alphabets = index->offsets[keyword_len + 1] - index->offsets[keyword_len];
+	}
+
+	if (n_alphabets == 0) {
+		random_keyword(keyword, ALPHABET_SIZE, keyword_len);
+	} else if (shared->keyword_search == KEYWORD_SEED) {
+		vec_copy(index->alphabets[index->offsets[keyword_len] + rand_int(0, n_alphabets)], keyword, ALPHABET_SIZE);
+	} else {
+		vec_copy(index->alphabets[index->offsets[keyword_len] + n%n_alphabets], keyword, ALPHABET_SIZE);
+	}
+
+	return ;
+}
+
+
+
+// Claim the next restart of a climb, or return INACTIVE when there are none left: the 
+// triple has run its restarts and can borrow none of the restarts freed by triples the 
+// adaptive controller stopped early (up to doubling its own), or the search has reached 
+// -targetscore or the -solution, or run out of -timebudget. 
+
+int claim_restart(climber_shared *shared, double known_best_score) {
+
+	length_sweep *sweep = shared->sweep;
+	int n, spare;
+
+	if (shared->target_score > 0. 
+		&& (sweep != NULL ? atomic_load(&sweep->leader_score) : known_best_score) >= shared->target_score) {
+		return INACTIVE;
+	}
+
+	if (shared->deadline > 0. && wall_clock() > shared->deadline) {
+		return INACTIVE;
+	}
+
+	if (shared->solved_time != NULL && atomic_load(shared->solved_time) > 0.) {
+		return INACTIVE;
+	}
+
+	n = atomic_fetch_add(&shared->next_restart, 1);
+	if (n < shared->n_restarts) {
+		return n;
+	}
+
+	if (sweep != NULL && atomic_load(&shared->n_borrowed) < shared->n_restarts) {
+		spare = atomic_load(&sweep->spare_restarts);
+		while (spare > 0) {
+			if (atomic_compare_exchange_weak(&sweep->spare_restarts, &spare, spare - 1)) {
+				atomic_fetch_add(&shared->n_borrowed, 1);
+				return n;
+			}
+		}
+	}
+
+	return INACTIVE;
+}
+
+
+
+// With -solution (called with shared->lock held, for each new shared best state): record 
+// the time the known plaintext is first reached. 
+
+void check_known_solution(climber_shared *shared, quagmire_state *state, uint8_t decrypted[]) {
+
+	double unsolved = 0.;
+
+	if (shared->variant) {
+		quagmire_encrypt(decrypted, shared->cipher_indices, shared->cipher_len, state->plaintext_keyword, 
+			state->ciphertext_keyword, state->cycleword, shared->cycleword_len, shared->beaufort);
+	} else {
+		quagmire_decrypt(decrypted, shared->cipher_indices, shared->cipher_len, state->plaintext_keyword, 
+			state->ciphertext_keyword, state->cycleword, shared->cycleword_len, shared->beaufort);
+	}
+
+	if (memcmp(decrypted, shared->solution_indices, shared->cipher_len) == 0) {
+		atomic_compare_exchange_strong(shared->solved_time, &unsolved, wall_clock());
+	}
+
+	return ;
+}
+
+
+
+// The adaptive controller (called with shared->lock held): record the best plaintext 
+// of a finished restart, given by its hash and score. A triple has converged once its 
+// best plaintext has been reached -confirm times, by the restart which found it and then 
+// by independent restarts (which did not backtrack to a known state), or -stall restarts 
+// have passed without improving on it. 
+
+void update_convergence(climber_shared *shared, uint64_t hash, double score, bool independent) {
+
+	if (hash == shared->confirmed_hash && shared->confirmed_score > -INFINITY) {
+		shared->n_stalled += 1;
+		if (independent) {
+			shared->n_confirmations += 1;
+		}
+	} else if (score > shared->confirmed_score) {
+		shared->confirmed_hash = hash;
+		shared->confirmed_score = score;
+		shared->n_confirmations = 1;
+		shared->n_stalled = 0;
+	} else {
+		shared->n_stalled += 1;
+	}
+
+	if ((shared->n_confirm > 0 && shared->n_confirmations >= shared->n_confirm) 
+		|| (shared->n_stall > 0 && shared->n_stalled >= shared->n_stall)) {
+		atomic_store(&shared->converged, true);
+	}
+
+	return ;
+}
+
+
+
+// Set up the temperature ladder of parallel tempering, one rung per replica (worker), 
+// spaced geometrically from the start (hottest) to the end (coldest) temperature. 
+
+void tempering_setup(climber_shared *shared, int n_replicas) {
+
+	int r;
+
+	shared->n_replicas = n_replicas;
+	shared->n_swaps = 0;
+	shared->n_swap_attempts = 0;
+
+	for (r = 0; r < n_replicas; r++) {
+		shared->replica_slot[r] = r;
+		shared->slot_replica[r] = r;
+		shared->replica_score[r] = -INFINITY;
+		shared->slot_temperature[r] = n_replicas > 1 
+			? shared->start_temperature*pow(shared->end_temperature/shared->start_temperature, r/(n_replicas - 1.)) 
+			: shared->end_temperature;
+	}
+
+	return ;
+}
+
+
+
+// Parallel tempering: publish a replica's current score, then propose exchanging its 
+// temperature with the replica on a neighbouring rung of the ladder, accepted with the 
+// usual probability min(1, exp((s_j - s_i)(1/T_i - 1/T_j))). The replicas run freely, so 
+// the neighbour's score is the one it last published. Returns the replica's temperature. 
+
+double tempering_swap(climber_shared *shared, int replica, double score) {
+
+	int slot, other_slot, other;
+	double delta, temperature;
+
+	pthread_mutex_lock(&shared->lock);
+
+	shared->replica_score[replica] = score;
+	slot = shared->replica_slot[replica];
+	other_slot = slot + (frand() < 0.5 ? -1 : 1);
+
+	if (other_slot >= 0 && other_slot < shared->n_replicas) {
+		other = shared->slot_replica[other_slot];
+		if (shared->replica_score[other] > -INFINITY) {
+			shared->n_swap_attempts += 1;
+			delta = (shared->replica_score[other] - score)
+				*(1./shared->slot_temperature[slot] - 1./shared->slot_temperature[other_slot]);
+			if (delta >= 0. || frand() < exp(delta)) {
+				shared->n_swaps += 1;
+				shared->replica_slot[replica] = other_slot;
+				shared->replica_slot[other] = slot;
+				shared->slot_replica[slot] = other;
+				shared->slot_replica[other_slot] = replica;
+			}
+		}
+	}
+
+	temperature = shared->slot_temperature[shared->replica_slot[replica]];
+
+	pthread_mutex_unlock(&shared->lock);
+
+	return temperature;
+}
+
+
+
+// The score a move from a state of the given score must beat to be accepted at the given 
+// temperature (the Metropolis rule, drawn before the move is scored). 
+
+double metropolis_threshold(double score, double temperature) {
+	return score + temperature*log(1. - frand());
+}
+
+
+
+// Count an entry to the given phase of a move and, if the move is being timed, add the 
+// time since *t to the phase and restart the clock. 
+
+void stats_phase(climber_stats *stats, int phase, bool sampled, double *t) {
+
+	double now;
+
+	stats->phase_calls[phase]++;
+
+	if (sampled) {
+		now = wall_clock();
+		stats->phase_time[phase] += now - *t;
+		stats->phase_samples[phase]++;
+		*t = now;
+	}
+
+	return ;
+}
+
+
+
+void stats_report_init(stats_report *report) {
+
+	pthread_mutex_init(&report->lock, NULL);
+	memset(&report->totals, 0, sizeof(climber_stats));
+	report->n_ciphers = 0;
+	report->n_workers = 0;
+	report->start_time = wall_clock();
+
+	return ;
+}
+
+
+
+// Add a finished worker's counters to the totals of the run. 
+
+void stats_report_merge(stats_report *report, climber_stats *stats) {
+
+	int i, j;
+	climber_stats *totals = &report->totals;
+
+	pthread_mutex_lock(&report->lock);
+
+	for (i = 0; i < N_STATS_PHASES; i++) {
+		totals->phase_calls[i] += stats->phase_calls[i];
+		totals->phase_samples[i] += stats->phase_samples[i];
+		totals->phase_time[i] += stats->phase_time[i];
+	}
+
+	for (i = 0; i < N_MOVE_TYPES; i++) {
+		totals->proposed[i] += stats->proposed[i];
+		totals->contradictions[i] += stats->contradictions[i];
+		for (j = 0; j < N_MOVE_OUTCOMES; j++) {
+			totals->moves[i][j] += stats->moves[i][j];
+		}
+	}
+
+	totals->n_moves += stats->n_moves;
+	totals->n_restarts += stats->n_restarts;
+	totals->n_backtracks += stats->n_backtracks;
+	report->n_workers++;
+
+	pthread_mutex_unlock(&report->lock);
+
+	return ;
+}
+
+
+
+// Write the -stats report as JSON, to stdout if stats_file is "-". The time of each phase 
+// is estimated from its timed moves: mean_ns is the mean time per entry and seconds the 
+// mean times the number of entries. The rates are fractions of the decided moves. 
+
+bool write_stats_report(stats_report *report, char *stats_file, solver_settings *settings) {
+
+	int i, j;
+	long n_decided;
+	double elapsed, mean, seconds, total_seconds;
+	climber_stats *totals = &report->totals;
+	FILE *fp;
+
+	fp = strcmp(stats_file, "-") == 0 ? stdout : fopen(stats_file, "w");
+	if (fp == NULL) {
+		printf("\n\nERROR: cannot write the stats file '%s'.\n\n", stats_file);
+		return false;
+	}
+
+	elapsed = wall_clock() - report->start_time;
+
+	total_seconds = 0.;
+	for (i = 0; i < N_STATS_PHASES; i++) {
+		if (totals->phase_samples[i] > 0) {
+			total_seconds += totals->phase_calls[i]*totals->phase_time[i]/totals->phase_samples[i];
+		}
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"ciphers\": %d,\n", report->n_ciphers);
+	fprintf(fp, "  \"engine\": \"%s\",\n", engine_names[settings->engine]);
+	fprintf(fp, "  \"threads\": %d,\n", settings->n_threads);
+	fprintf(fp, "  \"jobs\": %d,\n", settings->n_jobs);
+	fprintf(fp, "  \"workers\": %d,\n", report->n_workers);
+	fprintf(fp, "  \"wall_seconds\": %.6f,\n", elapsed);
+	fprintf(fp, "  \"restarts\": %ld,\n", totals->n_restarts);
+	fprintf(fp, "  \"backtracks\": %ld,\n", totals->n_backtracks);
+	fprintf(fp, "  \"moves\": %ld,\n", totals->n_moves);
+	fprintf(fp, "  \"moves_per_second\": %.1f,\n", elapsed > 0. ? totals->n_moves/elapsed : 0.);
+	fprintf(fp, "  \"sample_interval\": %d,\n", STATS_SAMPLE_INTERVAL);
+
+	fprintf(fp, "  \"phases\": {\n");
+	for (i = 0; i < N_STATS_PHASES; i++) {
+		mean = totals->phase_samples[i] > 0 ? totals->phase_time[i]/totals->phase_samples[i] : 0.;
+		seconds = mean*totals->phase_calls[i];
+		fprintf(fp, "    \"%s\": {\"calls\": %ld, \"timed\": %ld, \"mean_ns\": %.1f, \"seconds\": %.6f, \"share\": %.4f}%s\n", 
+			stats_phase_names[i], totals->phase_calls[i], totals->phase_samples[i], 1.e9*mean, seconds, 
+			total_seconds > 0. ? seconds/total_seconds : 0., i < N_STATS_PHASES - 1 ? "," : "");
+	}
+	fprintf(fp, "  },\n");
+
+	fprintf(fp, "  \"move_types\": {\n");
+	for (i = 0; i < N_MOVE_TYPES; i++) {
+		n_decided = 0;
+		for (j = 0; j < N_MOVE_OUTCOMES; j++) {
+			n_decided += totals->moves[i][j];
+		}
+		fprintf(fp, "    \"%s\": {\"proposed\": %ld, \"contradictions\": %ld", 
+			move_type_names[i], totals->proposed[i], totals->contradictions[i]);
+		for (j = 0; j < N_MOVE_OUTCOMES; j++) {
+			fprintf(fp, ", \"%s\": %ld", move_outcome_names[j], totals->moves[i][j]);
+		}
+		for (j = 0; j < N_MOVE_OUTCOMES; j++) {
+			fprintf(fp, ", \"%s_rate\": %.6f", move_outcome_names[j], 
+				n_decided > 0 ? (double) totals->moves[i][j]/n_decided : 0.);
+		}
+		fprintf(fp, "}%s\n", i < N_MOVE_TYPES - 1 ? "," : "");
+	}
+	fprintf(fp, "  }\n");
+	fprintf(fp, "}\n");
+
+	if (fp != stdout) {
+		fclose(fp);
+	}
+
+	return true;
+}
+
+
+
+// A single hill climbing worker. Restarts are claimed from the shared pool until 
+// all n_restarts have been run. 
+
+void *quagmire_hill_climber_worker(void *arg) {
+
+	climber_worker *worker = (climber_worker *) arg;
+	climber_shared *shared = worker->shared;
+
+	int i, j, n, n_iterations, n_backtracks, n_explore, n_contradictions, changed_column, n_changed_columns, 
+		cipher_type = shared->cipher_type, cipher_len = shared->cipher_len, 
+		*crib_positions = shared->crib_positions, 
+		n_cribs = shared->n_cribs, cycleword_len = shared->cycleword_len, 
+		plaintext_keyword_len = shared->plaintext_keyword_len, 
+		ciphertext_keyword_len = shared->ciphertext_keyword_len, 
+		n_hill_climbs = shared->n_hill_climbs, 
+		n_batch = shared->n_batch, ngram_size = shared->ngram_size, top_k = shared->top_k, 
+		engine = shared->engine, swap_interval = shared->swap_interval, move_type, outcome;
+
+	// The current and proposed (local) states are copied by assignment. The named 
+	// pointers into them are the arrays the moves and scoring work on. 
+
+	quagmire_state current, local, restart_best;
+	uint8_t *cipher_indices = shared->cipher_indices, *crib_indices = shared->crib_indices, 
+		decrypted[MAX_CIPHER_LENGTH], 
+		*local_plaintext_keyword_state = local.plaintext_keyword, 
+		*current_plaintext_keyword_state = current.plaintext_keyword, 
+		*local_ciphertext_keyword_state = local.ciphertext_keyword, 
+		*current_ciphertext_keyword_state = current.ciphertext_keyword, 
+		*local_cycleword_state = local.cycleword, *current_cycleword_state = current.cycleword;
+	ngram_table *ngram_data = shared->ngram_data;
+	float 
+		weight_ngram = shared->weight_ngram, weight_crib = shared->weight_crib, 
+		weight_ioc = shared->weight_ioc, weight_entropy = shared->weight_entropy;
+	double local_score, current_score, known_best_score, restart_best_score, threshold, 
+		temperature = shared->start_temperature, cooling, t = 0., 
+		backtracking_probability = shared->backtracking_probability, 
+		keyword_permutation_probability = shared->keyword_permutation_probability, 
+		slip_probability = shared->slip_probability;
+	bool perturbate_keyword_p, contradiction, backtrack, full_rescore, slip = false, 
+		variant = shared->variant, beaufort = shared->beaufort, early_abort = shared->early_abort, 
+		verbose = shared->verbose, adaptive = shared->n_confirm > 0 || shared->n_stall > 0, 
+		stats_p = shared->stats != NULL, sampled = false, 
+		exhaustive = shared->keyword_search == KEYWORD_EXHAUSTIVE, infeasible;
+	uint64_t hash;
+
+	// The score cache and the candidate batch are hundreds of kilobytes, too large for the 
+	// stack of a thread created with default attributes on some systems (or of a caller's 
+	// own thread, with one thread), so they are allocated on the heap. 
+
+	score_cache *cache = malloc(sizeof(score_cache));
+	candidate_batch *batch = malloc(sizeof(candidate_batch));
+	keyword_sampler plaintext_sampler, ciphertext_sampler;
+	crib_engine cribs;
+	climber_stats stats;
+
+	rand_state = worker->stream;
+	memset(&stats, 0, sizeof(stats));
+
+	score_cache_setup(cache, shared);
+	crib_engine_setup(&cribs, cipher_indices, crib_indices, crib_positions, n_cribs, cycleword_len, variant);
+	keyword_sampler_init(&plaintext_sampler);
+	keyword_sampler_init(&ciphertext_sampler);
+
+	known_best_score = 0.;
+
+	// Simulated annealing cools geometrically over the n_hill_climbs moves of a restart. 
+
+	cooling = n_hill_climbs > 1 ? pow(shared->end_temperature/shared->start_temperature, 1./(n_hill_climbs - 1)) : 1.;
+
+	while (! atomic_load(&shared->dropped) && ! atomic_load(&shared->converged) 
+		&& (n = claim_restart(shared, known_best_score)) != INACTIVE) {
+
+		if (drop_length_triple_p(shared, n)) {
+			atomic_store(&shared->dropped, true);
+			break ;
+		}
+
+		n_iterations = 0;
+		n_backtracks = 0;
+		n_explore = 0;
+		n_contradictions = 0;
+
+		if (stats_p) {
+			stats.n_restarts++;
+			t = wall_clock();
+		}
+
+		// An exhaustive keyword search never backtracks, as each restart has its own keyword. 
+
+		backtrack = false;
+		infeasible = false;
+		if (! exhaustive && frand() < backtracking_probability) {
+			// Backtrack to the shared best state, or with -topk to any of the best 
+			// distinct restart results. 
+			pthread_mutex_lock(&shared->lock);
+			if (shared->top.n_solutions > 1) {
+				backtrack = true;
+				n_backtracks += 1;
+				j = rand_int(0, shared->top.n_solutions);
+				current_score = shared->top.solutions[j].score;
+				current = shared->top.solutions[j].state;
+			} else if (shared->best_score > 0.) {
+				backtrack = true;
+				n_backtracks += 1;
+				current_score = shared->best_score;
+				current = shared->best_state;
+			}
+			known_best_score = shared->best_score;
+			pthread_mutex_unlock(&shared->lock);
+		}
+
+		if (! backtrack) {
+			// Initialise random state (with -keywordsearch, from the keyword list). 
+			switch (cipher_type) {
+				case VIGENERE:
+					initial_keyword(shared, current_plaintext_keyword_state, plaintext_keyword_len, n);
+					vec_copy(current_plaintext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
+					vec_copy(current_plaintext_keyword_state, current_cycleword_state, ALPHABET_SIZE);
+					break ;
+				case QUAGMIRE_1:
+					initial_keyword(shared, current_plaintext_keyword_state, plaintext_keyword_len, n);
+					straight_alphabet(current_ciphertext_keyword_state, ALPHABET_SIZE);
+					random_cycleword(current_cycleword_state, ALPHABET_SIZE, cycleword_len);
+					break ;
+				case QUAGMIRE_2:
+					straight_alphabet(current_plaintext_keyword_state, ALPHABET_SIZE);
+					initial_keyword(shared, current_ciphertext_keyword_state, ciphertext_keyword_len, n);
+					random_cycleword(current_cycleword_state, ALPHABET_SIZE, cycleword_len);
+					break ;
+				case QUAGMIRE_3:
+					initial_keyword(shared, current_plaintext_keyword_state, plaintext_keyword_len, n);
+					vec_copy(current_plaintext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
+					random_cycleword(current_cycleword_state, ALPHABET_SIZE, cycleword_len);
+					break ;
+				case QUAGMIRE_4:
+					initial_keyword(shared, current_plaintext_keyword_state, plaintext_keyword_len, n);
+					initial_keyword(shared, current_ciphertext_keyword_state, ciphertext_keyword_len, n);
+					random_cycleword(current_cycleword_state, ALPHABET_SIZE, cycleword_len);
+					break ;
+				case BEAUFORT:
+					plaintext_keyword_len = ALPHABET_SIZE;
+					ciphertext_keyword_len = ALPHABET_SIZE;
+					for (i = 0; i < ALPHABET_SIZE; i++) current_plaintext_keyword_state[i] = i;
+					vec_copy(current_plaintext_keyword_state, current_ciphertext_keyword_state, ALPHABET_SIZE);
+					random_cycleword(current_cycleword_state, ALPHABET_SIZE, cycleword_len);
+					break ; 
+			}
+
+			// The keywords of an exhaustive keyword search stay fixed for the restart, so 
+			// one the cribs contradict is not climbed at all. 
+
+			if (exhaustive) {
+				infeasible = crib_engine_constrain(&cribs, 
+					current_plaintext_keyword_state, current_ciphertext_keyword_state, current_cycleword_state);
+				n_contradictions += infeasible;
+			}
+
+			current_score = state_score(cipher_indices, cipher_len, 
+				crib_indices, crib_positions, n_cribs, 
+				current_plaintext_keyword_state, current_ciphertext_keyword_state, 
+				current_cycleword_state, cycleword_len, 
+				variant, beaufort, 
+				decrypted, ngram_data, ngram_size,
+				weight_ngram, weight_crib, weight_ioc, weight_entropy);
+		}
+		score_cache_init(cache, current_plaintext_keyword_state, current_ciphertext_keyword_state, 
+			current_cycleword_state);
+
+		// Restarts are few enough to time every one. 
+
+		if (stats_p) {
+			stats_phase(&stats, STATS_RESTART, true, &t);
+		}
+
+		// The local state is kept equal to the current state between moves. 
+
+		local = current;
+		restart_best = current;
+		restart_best_score = current_score;
+		batch->n_candidates = 0;
+
+		// Annealing starts every restart hot. A tempering replica keeps its rung of the 
+		// temperature ladder from one restart to the next. 
+
+		if (engine == ENGINE_ANNEAL) {
+			temperature = shared->start_temperature;
+		} else if (engine == ENGINE_TEMPERING) {
+			temperature = tempering_swap(shared, worker->id, current_score);
+		}
+
+		perturbate_keyword_p = true;
+
+		for (i = 0; i < n_hill_climbs && ! infeasible; i++) {
+				
+			n_iterations += 1;
+
+			if (stats_p) {
+				sampled = ++stats.n_moves % STATS_SAMPLE_INTERVAL == 0;
+				if (sampled) {
+					t = wall_clock();
+				}
+			}
+
+			if (engine == ENGINE_ANNEAL && i > 0) {
+				temperature *= cooling;
+			} else if (engine == ENGINE_TEMPERING && i > 0 && i % swap_interval == 0) {
+				temperature = tempering_swap(shared, worker->id, current_score);
+			}
+
+			// perturbate.
+			if (cipher_type != BEAUFORT && ! exhaustive 
+				&& (perturbate_keyword_p || cipher_type == VIGENERE || frand() < keyword_permutation_probability)) {
+				full_rescore = true;
+				switch (cipher_type) {
+					case VIGENERE:
+						perturbate_keyword(local_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len, &plaintext_sampler);
+						vec_copy(local_plaintext_keyword_state, local_ciphertext_keyword_state, ALPHABET_SIZE);	
+						vec_copy(local_plaintext_keyword_state, local_cycleword_state, ALPHABET_SIZE);
+						break ; 
+					case QUAGMIRE_1:
+						perturbate_keyword(local_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len, &plaintext_sampler);
+						break ;
+					case QUAGMIRE_2:
+						perturbate_keyword(local_ciphertext_keyword_state, ALPHABET_SIZE, ciphertext_keyword_len, &ciphertext_sampler);
+						break ;
+					case QUAGMIRE_3:
+						perturbate_keyword(local_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len, &plaintext_sampler);
+						vec_copy(local_plaintext_keyword_state, local_ciphertext_keyword_state, ALPHABET_SIZE);
+						break ;
+					case QUAGMIRE_4:
+						if (frand() < 0.5) {
+							perturbate_keyword(local_plaintext_keyword_state, ALPHABET_SIZE, plaintext_keyword_len, &plaintext_sampler);
+						} else {
+							perturbate_keyword(local_ciphertext_keyword_state, ALPHABET_SIZE, ciphertext_keyword_len, &ciphertext_sampler);
+						}
+						break ;
+				}
+			} else {
+				full_rescore = false;
+				perturbate_cycleword(local_cycleword_state, ALPHABET_SIZE, cycleword_len);
+			}
+			move_type = full_rescore ? MOVE_KEYWORD : MOVE_CYCLEWORD;
+
+			if (stats_p) {
+				stats.proposed[move_type]++;
+				stats_phase(&stats, STATS_PERTURB, sampled, &t);
+			}
+
+			if (cipher_type != VIGENERE && cipher_type != BEAUFORT) {
+				perturbate_keyword_p = false;
+				contradiction = crib_engine_constrain(&cribs, 
+					local_plaintext_keyword_state, local_ciphertext_keyword_state, local_cycleword_state);
+
+				if (contradiction) {
+					// Cycleword contradiction - must perturbate keyword(s). 
+					n_contradictions += 1; 
+					perturbate_keyword_p = true; 
+				}
+
+				if (stats_p) {
+					stats.contradictions[move_type] += contradiction;
+					stats_phase(&stats, STATS_CONSTRAIN, sampled, &t);
+				}
+			}
+
+			// Compute score. Only the plaintext positions whose letters change are re-scored: 
+			// for a keyword move these are found from the (column, ciphertext letter) index 
+			// in the score cache, and if only one cycleword letter has changed (the crib 
+			// constraints may have undone the perturbation) it is just that column. 
+
+			// With -batch, n_batch candidate moves from the current state are collected 
+			// instead and scored in one pass, and the best of them is the proposed move. The 
+			// score cache is then only updated if the move is kept. 
+
+			changed_column = INACTIVE;
+			if (n_batch > 1) {
+				batch->states[batch->n_candidates++] = local;
+				local = current;
+				if (batch->n_candidates < n_batch && i < n_hill_climbs - 1) {
+					continue ;
+				}
+				j = score_candidate_batch(batch, cache);
+				local = batch->states[j];
+				local_score = batch->scores[j];
+				batch->n_candidates = 0;
+				full_rescore = false;
+				move_type = MOVE_BATCH;
+				if (stats_p) {
+					stats.proposed[MOVE_BATCH]++;
+					stats_phase(&stats, STATS_SCORE_BATCH, sampled, &t);
+				}
+				threshold = engine == ENGINE_HILL ? current_score : metropolis_threshold(current_score, temperature);
+				// A batch is scored in full, but with -earlyabort the slip is still drawn here.
+				slip = engine == ENGINE_HILL && early_abort && frand() < slip_probability;
+			} else {
+				if (! full_rescore) {
+					n_changed_columns = 0;
+					for (j = 0; j < cycleword_len; j++) {
+						if (local_cycleword_state[j] != current_cycleword_state[j]) {
+							changed_column = j;
+							n_changed_columns++;
+						}
+					}
+					if (n_changed_columns > 1) {
+						changed_column = INACTIVE;
+						full_rescore = true;
+					}
+				}
+
+				// With -earlyabort, whether the move may slip is decided first. If not, it only 
+				// needs scoring until it can no longer beat the current score. Annealing and 
+				// tempering draw the Metropolis threshold the move must beat first instead. 
+
+				if (engine == ENGINE_HILL) {
+					slip = early_abort && frand() < slip_probability;
+					threshold = early_abort && ! slip ? current_score : -INFINITY;
+				} else {
+					threshold = metropolis_threshold(current_score, temperature);
+				}
+
+				if (full_rescore) {
+					local_score = score_cache_update_state(cache, local_plaintext_keyword_state, 
+						local_ciphertext_keyword_state, local_cycleword_state, early_abort ? threshold : -INFINITY);
+					if (stats_p) {
+						stats_phase(&stats, cache->full_pending ? STATS_SCORE_FULL : STATS_SCORE_INCREMENTAL, sampled, &t);
+					}
+				} else if (changed_column != INACTIVE) {
+					local_score = score_cache_update_column(cache, changed_column, local_cycleword_state[changed_column], 
+						early_abort ? threshold : -INFINITY);
+					if (stats_p) {
+						stats_phase(&stats, cache->full_pending ? STATS_SCORE_FULL : STATS_SCORE_INCREMENTAL, sampled, &t);
+					}
+				} else {
+					local_score = current_score;
+				}
+			}
+
+#if 0
+			printf("\nlocal_score = %.4f\n", local_score);
+			print_text(decrypted, cipher_len);
+			printf("\n");
+			print_text(local_plaintext_keyword_state, ALPHABET_SIZE);
+			printf("\n");
+			print_text(local_ciphertext_keyword_state, ALPHABET_SIZE);
+			printf("\n");
+			print_text(local_cycleword_state, cycleword_len);
+			printf("\n");
+#endif
+
+			if (engine == ENGINE_HILL 
+				? local_score > current_score || (early_abort ? slip : frand() < slip_probability) 
+				: local_score > threshold) {
+				outcome = MOVE_IMPROVED;
+				if (local_score <= current_score) {
+					// printf("exploring\n");
+					n_explore += 1;
+					outcome = MOVE_SLIPPED;
+				}
+				current_score = local_score;
+				current = local;
+				if (n_batch > 1) {
+					score_cache_update_state(cache, current_plaintext_keyword_state, 
+						current_ciphertext_keyword_state, current_cycleword_state, -INFINITY);
+				}
+				score_cache_commit(cache);
+			} else {
+				if (full_rescore || changed_column != INACTIVE) {
+					score_cache_revert(cache);
+				}
+				local = current;
+				outcome = MOVE_REJECTED;
+			}
+
+			if (stats_p) {
+				stats.moves[move_type][outcome]++;
+				stats_phase(&stats, STATS_ACCEPT, sampled, &t);
+			}
+
+			// The shared best only ever increases, so a stale known_best_score can only 
+			// cause an unnecessary trip through the lock. 
+
+			if (current_score > known_best_score) {
+				pthread_mutex_lock(&shared->lock);
+				if (current_score > shared->best_score) {
+					shared->best_score = current_score;
+					shared->best_state = current;
+					if (shared->solution_indices != NULL) {
+						check_known_solution(shared, &current, decrypted);
+					}
+					if (verbose && shared->reporter != NULL) {
+						report_climber_progress(shared, n, i, 
+							n_iterations, n_backtracks, n_explore, n_contradictions);
+					}
+				}
+				known_best_score = shared->best_score;
+				pthread_mutex_unlock(&shared->lock);
+				if (shared->sweep != NULL) {
+					update_sweep_leader(shared->sweep, known_best_score);
+				}
+			}
+
+			if ((top_k > 1 || adaptive) && current_score > restart_best_score) {
+				restart_best_score = current_score;
+				restart_best = current;
+			}
+		}
+
+		// Offer the best state of this restart to the best distinct solutions, and to the 
+		// adaptive controller. 
+
+		if ((top_k > 1 || adaptive) && ! infeasible) {
+			if (variant) {
+				quagmire_encrypt(decrypted, cipher_indices, cipher_len, restart_best.plaintext_keyword, 
+					restart_best.ciphertext_keyword, restart_best.cycleword, cycleword_len, beaufort);
+			} else {
+				quagmire_decrypt(decrypted, cipher_indices, cipher_len, restart_best.plaintext_keyword, 
+					restart_best.ciphertext_keyword, restart_best.cycleword, cycleword_len, beaufort);
+			}
+			hash = plaintext_hash(decrypted, cipher_len);
+			pthread_mutex_lock(&shared->lock);
+			if (top_k > 1) {
+				solution_heap_insert(&shared->top, &restart_best, restart_best_score, hash, cycleword_len);
+			}
+			if (adaptive) {
+				update_convergence(shared, hash, restart_best_score, ! backtrack);
+			}
+			pthread_mutex_unlock(&shared->lock);
+		}
+
+		// Publish this restart's counters to the aggregate totals. 
+
+		atomic_fetch_add(&shared->n_iterations, n_iterations);
+		atomic_fetch_add(&shared->n_backtracks, n_backtracks);
+		atomic_fetch_add(&shared->n_explore, n_explore);
+		atomic_fetch_add(&shared->n_contradictions, n_contradictions);
+		stats.n_backtracks += n_backtracks;
+
+		if (shared->triple != NULL) {
+			record_restart(shared);
+		}
+	}
+
+	if (stats_p) {
+		stats_report_merge(shared->stats, &stats);
+	}
+
+	free(batch);
+	free(cache);
+
+	return NULL;
+}
+
+
+
+// Publish the shared best state to the progress reporter (called with shared->lock 
+// held). The counters of the restart in progress have not yet been published, so they 
+// are added to the totals. The decryption and printing are left to the reporter thread. 
+
+void report_climber_progress(climber_shared *shared, int n_restart, int n_iteration, 
+	int n_iterations, int n_backtracks, int n_explore, int n_contradictions) {
+
+	progress_snapshot snapshot;
+
+	snapshot.name = shared->name;
+	snapshot.cipher_indices = shared->cipher_indices;
+	snapshot.cipher_len = shared->cipher_len;
+	snapshot.cycleword_len = shared->cycleword_len;
+	snapshot.plaintext_keyword_len = shared->triple != NULL ? shared->triple->plaintext_keyword_len : INACTIVE;
+	snapshot.ciphertext_keyword_len = shared->triple != NULL ? shared->triple->ciphertext_keyword_len : INACTIVE;
+	snapshot.n_restart = n_restart;
+	snapshot.n_iteration = n_iteration;
+	snapshot.variant = shared->variant;
+	snapshot.beaufort = shared->beaufort;
+	snapshot.n_iterations = atomic_load(&shared->n_iterations) + n_iterations;
+	snapshot.n_backtracks = atomic_load(&shared->n_backtracks) + n_backtracks;
+	snapshot.n_explore = atomic_load(&shared->n_explore) + n_explore;
+	snapshot.n_contradictions = atomic_load(&shared->n_contradictions) + n_contradictions;
+	snapshot.elapsed = wall_clock() - shared->start_time;
+	snapshot.score = shared->best_score;
+	snapshot.state = shared->best_state;
+
+	progress_push(shared->reporter, &snapshot);
+
+	return ;
+}
+
+
+
+// Start the reporter thread, printing progress to the console if console is set and 
+// writing records to records if it is not NULL. 
+
+void progress_reporter_start(progress_reporter *reporter, bool console, FILE *records) {
+
+	int i;
+
+	for (i = 0; i < PROGRESS_QUEUE_SIZE; i++) {
+		atomic_init(&reporter->slots[i].sequence, i);
+	}
+	atomic_init(&reporter->tail, 0);
+	reporter->head = 0;
+	atomic_init(&reporter->n_pushed, 0);
+	atomic_init(&reporter->n_done, 0);
+	atomic_init(&reporter->n_dropped, 0);
+	atomic_init(&reporter->pending, false);
+	atomic_init(&reporter->n_flushing, 0);
+	atomic_init(&reporter->stop, false);
+	reporter->console = console;
+	reporter->records = records;
+	reporter->last_print = 0.;
+
+	pthread_create(&reporter->thread, NULL, progress_reporter_thread, reporter);
+
+	return ;
+}
+
+
+
+// Wait until every snapshot pushed so far has been reported, including the latest, 
+// which is printed without waiting for the rate limit. Snapshots pushed meanwhile (by 
+// the searches of other ciphers of a manifest) are waited for too. 
+
+void progress_reporter_flush(progress_reporter *reporter) {
+
+	struct timespec pause = {0, 1000000};
+
+	atomic_fetch_add(&reporter->n_flushing, 1);
+	while (atomic_load(&reporter->n_done) < atomic_load(&reporter->n_pushed) 
+		|| atomic_load(&reporter->pending)) {
+		nanosleep(&pause, NULL);
+	}
+	atomic_fetch_sub(&reporter->n_flushing, 1);
+
+	return ;
+}
+
+
+
+// Report what is left and stop the reporter thread. 
+
+void progress_reporter_stop(progress_reporter *reporter) {
+
+	atomic_store(&reporter->stop, true);
+	pthread_join(reporter->thread, NULL);
+
+	if (reporter->console && atomic_load(&reporter->n_dropped) > 0) {
+		printf("\n%ld progress snapshots dropped (queue full)\n", atomic_load(&reporter->n_dropped));
+	}
+
+	return ;
+}
+
+
+
+// Stop and free the reporter of a run (if any), and close its results file. 
+
+void close_reporter(progress_reporter *reporter, FILE *results_fp) {
+
+	if (reporter != NULL) {
+		progress_reporter_stop(reporter);
+		free(reporter);
+	}
+
+	if (results_fp != NULL && results_fp != stdout) {
+		fclose(results_fp);
+	}
+
+	return ;
+}
+
+
+
+// Push a snapshot onto the reporter's queue without blocking (a bounded multi-producer 
+// queue: each slot's sequence number says whether it is free for the producer that 
+// claims its position, or full for the consumer). Returns false, dropping the snapshot, 
+// if the queue is full. 
+
+bool progress_push(progress_reporter *reporter, progress_snapshot *snapshot) {
+
+	size_t pos = atomic_load_explicit(&reporter->tail, memory_order_relaxed), sequence;
+	progress_slot *slot;
+
+	for (;;) {
+		slot = &reporter->slots[pos % PROGRESS_QUEUE_SIZE];
+		sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+		if (sequence == pos) {
+			if (atomic_compare_exchange_weak_explicit(&reporter->tail, &pos, pos + 1, 
+				memory_order_relaxed, memory_order_relaxed)) {
+				break ;
+			}
+		} else if ((long) (sequence - pos) < 0) {
+			atomic_fetch_add(&reporter->n_dropped, 1);
+			return false;
+		} else {
+			pos = atomic_load_explicit(&reporter->tail, memory_order_relaxed);
+		}
+	}
+
+	slot->snapshot = *snapshot;
+	atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+	atomic_fetch_add(&reporter->n_pushed, 1);
+
+	return true;
+}
+
+
+
+// Pop the oldest snapshot from the reporter's queue (reporter thread only). Returns false 
+// if the queue is empty. 
+
+bool progress_pop(progress_reporter *reporter, progress_snapshot *snapshot) {
+
+	size_t pos = reporter->head;
+	progress_slot *slot = &reporter->slots[pos % PROGRESS_QUEUE_SIZE];
+
+	if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos + 1) {
+		return false;
+	}
+
+	*snapshot = slot->snapshot;
+	atomic_store_explicit(&slot->sequence, pos + PROGRESS_QUEUE_SIZE, memory_order_release);
+	reporter->head = pos + 1;
+
+	return true;
+}
+
+
+
+// The reporter thread. Every snapshot is written to the records, while the console only 
+// shows the latest snapshot once PROGRESS_INTERVAL has passed since the last one shown 
+// (or on a flush or stop). 
+
+void *progress_reporter_thread(void *arg) {
+
+	progress_reporter *reporter = arg;
+	progress_snapshot snapshot, latest;
+	uint8_t decrypted[MAX_CIPHER_LENGTH];
+	struct timespec pause = {0, 5000000};
+	bool stop, urgent;
+
+	for (;;) {
+
+		stop = atomic_load(&reporter->stop);
+
+		while (progress_pop(reporter, &snapshot)) {
+			if (reporter->records != NULL) {
+				pthread_mutex_lock(&print_lock);
+				write_progress_record(reporter->records, &snapshot, decrypted);
+				pthread_mutex_unlock(&print_lock);
+			}
+			latest = snapshot;
+			atomic_store(&reporter->pending, true);
+			atomic_fetch_add(&reporter->n_done, 1);
+		}
+
+		urgent = stop || atomic_load(&reporter->n_flushing) > 0;
+
+		if (atomic_load(&reporter->pending) 
+			&& (urgent || wall_clock() - reporter->last_print >= PROGRESS_INTERVAL)) {
+			if (reporter->console) {
+				pthread_mutex_lock(&print_lock);
+				print_progress_snapshot(&latest, decrypted);
+				pthread_mutex_unlock(&print_lock);
+			}
+			if (reporter->records != NULL) {
+				fflush(reporter->records);
+			}
+			reporter->last_print = wall_clock();
+			atomic_store(&reporter->pending, false);
+		}
+
+		if (stop) {
+			break ;
+		}
+
+		nanosleep(&pause, NULL);
+	}
+
+	return NULL;
+}
+
+
+
+// Decrypt a snapshot's state into decrypted. 
+
+void snapshot_decrypt(progress_snapshot *snapshot, uint8_t decrypted[]) {
+
+	if (snapshot->variant) {
+		quagmire_encrypt(decrypted, snapshot->cipher_indices, snapshot->cipher_len, 
+			snapshot->state.plaintext_keyword, snapshot->state.ciphertext_keyword, 
+			snapshot->state.cycleword, snapshot->cycleword_len, snapshot->beaufort);
+	} else {
+		quagmire_decrypt(decrypted, snapshot->cipher_indices, snapshot->cipher_len, 
+			snapshot->state.plaintext_keyword, snapshot->state.ciphertext_keyword, 
+			snapshot->state.cycleword, snapshot->cycleword_len, snapshot->beaufort);
+	}
+
+	return ;
+}
+
+
+
+// Print a snapshot of the shared best state (called with print_lock held). 
+
+void print_progress_snapshot(progress_snapshot *snapshot, uint8_t decrypted[]) {
+
+	int i, j, indx, cycleword_len = snapshot->cycleword_len;
+	double ioc, chi, entropy_score;
+
+	if (snapshot->plaintext_keyword_len != INACTIVE) {
+		printf("\nplaintext, ciphertext, cycleword lengths = %d, %d, %d\n", 
+			snapshot->plaintext_keyword_len, snapshot->ciphertext_keyword_len, cycleword_len);
+	}
+
+	snapshot_decrypt(snapshot, decrypted);
+
+	ioc = index_of_coincidence(decrypted, snapshot->cipher_len);
+	chi = chi_squared(decrypted, snapshot->cipher_len);
+	entropy_score = entropy(decrypted, snapshot->cipher_len);
+
+	printf("\n%.2f\t[sec]\n", snapshot->elapsed);
+	printf("%.0fK\t[it/sec]\n", 1.e-3*snapshot->n_iterations/snapshot->elapsed);
+	printf("%ld\t[backtracks]\n", snapshot->n_backtracks);
+	printf("%d\t[restarts]\n", snapshot->n_restart);
+	printf("%d\t[iterations]\n", snapshot->n_iteration);
+	printf("%ld\t[slips]\n", snapshot->n_explore);
+	printf("%.2f\t[contradiction pct]\n", ((double) snapshot->n_contradictions)/snapshot->n_iterations);
+	printf("%.4f\t[IOC]\n", ioc);
+	printf("%.4f\t[entropy]\n", entropy_score);
+	printf("%.2f\t[chi-squared]\n", chi);
+	printf("%.2f\t[score]\n", snapshot->score);
+	print_text(snapshot->state.plaintext_keyword, ALPHABET_SIZE);
+	printf("\n");
+	print_text(snapshot->state.ciphertext_keyword, ALPHABET_SIZE);
+	printf("\n");
+	print_text(snapshot->state.cycleword, cycleword_len);
+	printf("\n");
+
+	// Display Quagmire tablau. 
+	printf("\n");
+	for (i = 0; i < cycleword_len; i++) {
+		for (j = 0; j < ALPHABET_SIZE; j++) {
+			indx = (j + snapshot->state.cycleword[i]) % ALPHABET_SIZE;
+			printf("%c", snapshot->state.ciphertext_keyword[indx] + 'A');
+		}
+		printf("\n");
+	}
+	printf("\n");
+
+	print_text(decrypted, snapshot->cipher_len);
+	printf("\n");
+	fflush(stdout);
+
+	return ;
+}
+
+
+
+// Write a snapshot as an NDJSON progress record (called with print_lock held). 
+
+void write_progress_record(FILE *fp, progress_snapshot *snapshot, uint8_t decrypted[]) {
+
+	snapshot_decrypt(snapshot, decrypted);
+
+	fprintf(fp, "{\"record\": \"progress\", \"cipher\": ");
+	fprint_json_string(fp, snapshot->name);
+	fprintf(fp, ", \"seconds\": %.3f, \"restart\": %d, \"iterations\": %ld, \"score\": %.4f", 
+		snapshot->elapsed, snapshot->n_restart, snapshot->n_iterations, snapshot->score);
+	if (snapshot->plaintext_keyword_len != INACTIVE) {
+		fprintf(fp, ", \"plaintext_keyword_len\": %d, \"ciphertext_keyword_len\": %d", 
+			snapshot->plaintext_keyword_len, snapshot->ciphertext_keyword_len);
+	}
+	fprintf(fp, ", \"cycleword_len\": %d, \"plaintext_keyword\": ", snapshot->cycleword_len);
+	fprint_json_text(fp, snapshot->state.plaintext_keyword, ALPHABET_SIZE);
+	fprintf(fp, ", \"ciphertext_keyword\": ");
+	fprint_json_text(fp, snapshot->state.ciphertext_keyword, ALPHABET_SIZE);
+	fprintf(fp, ", \"cycleword\": ");
+	fprint_json_text(fp, snapshot->state.cycleword, snapshot->cycleword_len);
+	fprintf(fp, ", \"plaintext\": ");
+	fprint_json_text(fp, decrypted, snapshot->cipher_len);
+	fprintf(fp, "}\n");
+
+	return ;
+}
+
+
+
+// Write the result of a cipher as an NDJSON result record (called with print_lock 
+// held). words is only present with a dictionary. 
+
+void write_result_record(FILE *fp, cipher_job *job) {
+
+	fprintf(fp, "{\"record\": \"result\", \"cipher\": ");
+	fprint_json_string(fp, job->name);
+	fprintf(fp, ", \"type\": %d, \"variant\": %s, \"score\": %.4f", 
+		job->options.cipher_type, job->options.variant ? "true" : "false", job->best_score);
+	if (job->n_words_found != INACTIVE) {
+		fprintf(fp, ", \"words\": %d", job->n_words_found);
+	}
+	if (job->options.solution_present) {
+		fprintf(fp, ", \"solved\": %s", atomic_load(&job->solved_time) > 0. ? "true" : "false");
+	}
+	fprintf(fp, ", \"ciphertext\": ");
+	fprint_json_text(fp, job->cipher_indices, job->cipher_len);
+	fprintf(fp, ", \"plaintext_keyword\": ");
+	fprint_json_text(fp, job->best_plaintext_keyword, ALPHABET_SIZE);
+	fprintf(fp, ", \"ciphertext_keyword\": ");
+	fprint_json_text(fp, job->best_ciphertext_keyword, ALPHABET_SIZE);
+	fprintf(fp, ", \"cycleword\": ");
+	fprint_json_text(fp, job->best_cycleword, job->best_cycleword_len);
+	fprintf(fp, ", \"plaintext\": ");
+	fprint_json_text(fp, job->best_decrypted, job->cipher_len);
+	fprintf(fp, "}\n");
+	fflush(fp);
+
+	return ;
+}
+
+
+
+// Report the result of a cipher: a result record with -results, otherwise the '>>>' 
+// summary line. 
+
+void report_result(solver_settings *settings, cipher_job *job) {
+
+	pthread_mutex_lock(&print_lock);
+	if (settings->reporter != NULL && settings->reporter->records != NULL) {
+		write_result_record(settings->reporter->records, job);
+	} else {
+		print_summary_line(job);
+		printf("\n");
+		fflush(stdout);
+	}
+	pthread_mutex_unlock(&print_lock);
+
+	return ;
+}
+
+
+
+// Write a string as a JSON string literal. 
+
+void fprint_json_string(FILE *fp, char *s) {
+
+	fputc('"', fp);
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\') {
+			fprintf(fp, "\\%c", *s);
+		} else if ((unsigned char) *s < 0x20) {
+			fprintf(fp, "\\u%04x", (unsigned char) *s);
+		} else {
+			fputc(*s, fp);
+		}
+	}
+	fputc('"', fp);
+
+	return ;
+}
+
+
+
+// Write a text of letter indices as a JSON string of upper case letters. 
+
+void fprint_json_text(FILE *fp, uint8_t text[], int len) {
+
+	int i;
+
+	fputc('"', fp);
+	for (i = 0; i < len; i++) {
+		fputc(text[i] + 'A', fp);
+	}
+	fputc('"', fp);
+
+	return ;
+}
+
+
+
+// Does the ciphertext trivially satisfy the cribs? For a given cycleword length, there 
+// should be a one-to-one mapping between the ciphertext and the plaintext in each column. 
+// Each column is walked once, keeping the plaintext to ciphertext map and its inverse, 
+// so the check is O(cipher_len + 26*cycleword_len). 
+
+bool cribs_satisfied_p(uint8_t cipher_indices[], int cipher_len, uint8_t crib_indices[], 
+	int crib_positions[], int n_cribs, int cycleword_len, bool verbose) {
+
+	int i, j, pt, ct, *crib_letters, 
+		plaintext_to_ciphertext[ALPHABET_SIZE], ciphertext_to_plaintext[ALPHABET_SIZE];
+
+	// Check cribs are present. 
+
+	if (n_cribs == 0) {
+		return true;
+	}
+
+	crib_letters = malloc(cipher_len*sizeof(int));
+
+	for (i = 0; i < cipher_len; i++) {
+		crib_letters[i] = INACTIVE;
+	}
+
+	for (i = 0; i < n_cribs; i++) {
+		crib_letters[crib_positions[i]] = crib_indices[i];
+	}
+
+	for (j = 0; j < cycleword_len && j < cipher_len; j++) {
+
+		if (verbose) {
+			printf("\nCOLUMN = %d \n", j);
+		}
+
+		for (i = 0; i < ALPHABET_SIZE; i++) {
+			plaintext_to_ciphertext[i] = INACTIVE;
+			ciphertext_to_plaintext[i] = INACTIVE;
+		}
+
+		for (i = j; i < cipher_len; i += cycleword_len) {
+
+			if (crib_letters[i] == INACTIVE) {
+				continue ;
+			}
+
+			pt = crib_letters[i];
+			ct = cipher_indices[i];
+
+			if (verbose) {
+				printf("CT = %c, PT = %c\n", ct + 'A', pt + 'A');
+			}
+
+			// Check for a clash: the crib letter already maps to a different ciphertext 
+			// letter, or the ciphertext letter to a different crib letter. 
+
+			if ((plaintext_to_ciphertext[pt] != INACTIVE && plaintext_to_ciphertext[pt] != ct) 
+				|| (ciphertext_to_plaintext[ct] != INACTIVE && ciphertext_to_plaintext[ct] != pt)) {
+				if (verbose) {
+					printf("\n\nContradiction at col %d, crib char %c\n\n", j, pt + 'A');
+				}
+				free(crib_letters);
+				return false;
+			}
+
+			plaintext_to_ciphertext[pt] = ct;
+			ciphertext_to_plaintext[ct] = pt;
+		}
+	}
+
+	free(crib_letters);
+
+	return true;
+}
+
+
+
+// Crib constraints on the cycleword. For a given candidate keyword, each crib forces the 
+// cycleword letter of its column, and if two cribs in a column force different letters 
+// we have a conflict and must reject the keyword. The cribs are grouped by column once 
+// per cycleword length, keeping only the distinct (ciphertext letter, crib letter) pairs 
+// of each column in the order they first appear. 
+
+void crib_engine_setup(crib_engine *engine, uint8_t cipher_indices[], 
+	uint8_t crib_indices[], int crib_positions[], int n_cribs, int cycleword_len, bool variant) {
+
+	int i, j, c, n = 0;
+	bool seen[ALPHABET_SIZE][ALPHABET_SIZE];
+
+	engine->cycleword_len = cycleword_len;
+	engine->variant = variant;
+	engine->valid = false;
+	engine->n_columns = 0;
+	engine->offsets[0] = 0;
+
+	for (c = 0; c < cycleword_len; c++) {
+
+		for (i = 0; i < ALPHABET_SIZE; i++) {
+			for (j = 0; j < ALPHABET_SIZE; j++) {
+				seen[i][j] = false;
+			}
+		}
+
+		for (j = 0; j < n_cribs; j++) {
+			if (crib_positions[j] % cycleword_len == c 
+				&& ! seen[cipher_indices[crib_positions[j]]][crib_indices[j]]) {
+				seen[cipher_indices[crib_positions[j]]][crib_indices[j]] = true;
+				engine->ciphertext_letters[n] = cipher_indices[crib_positions[j]];
+				engine->crib_letters[n++] = crib_indices[j];
+			}
+		}
+
+		if (n > engine->offsets[engine->n_columns]) {
+			engine->columns[engine->n_columns++] = c;
+			engine->offsets[engine->n_columns] = n;
+		}
+	}
+
+	return ;
+}
+
+
+
+// Constrain the cycleword for the given keywords, returning true on a contradiction. The 
+// keyword positions of the letters come from inverse keyword maps. The cycleword letters 
+// forced by the last pair of keywords are kept, so after a cycleword move they are just 
+// written back. As in a column-by-column scan, on a contradiction the columns before the 
+// contradicting one are constrained, and the contradicting one gets its first crib's letter. 
+
+bool crib_engine_constrain(crib_engine *engine, 
+	uint8_t plaintext_keyword[], uint8_t ciphertext_keyword[], uint8_t cycleword[]) {
+
+	int i, k, indx, letter, plaintext_inverse[ALPHABET_SIZE], ciphertext_inverse[ALPHABET_SIZE];
+
+	if (! engine->valid 
+		|| memcmp(engine->plaintext_keyword, plaintext_keyword, ALPHABET_SIZE) != 0 
+		|| memcmp(engine->ciphertext_keyword, ciphertext_keyword, ALPHABET_SIZE) != 0) {
+
+		invert_alphabet(plaintext_keyword, plaintext_inverse);
+		invert_alphabet(ciphertext_keyword, ciphertext_inverse);
+
+		engine->contradiction = false;
+		engine->n_forced = engine->n_columns;
+
+		for (i = 0; i < engine->n_columns && ! engine->contradiction; i++) {
+			for (k = engine->offsets[i]; k < engine->offsets[i + 1]; k++) {
+				if (engine->variant) {
+					indx = ciphertext_inverse[engine->crib_letters[k]] - plaintext_inverse[engine->ciphertext_letters[k]];
+				} else {
+					indx = ciphertext_inverse[engine->ciphertext_letters[k]] - plaintext_inverse[engine->crib_letters[k]];
+				}
+				if (indx < 0) indx += ALPHABET_SIZE;
+				letter = plaintext_keyword[indx];
+				if (k == engine->offsets[i]) {
+					engine->forced[i] = letter;
+				} else if (letter != engine->forced[i]) {
+					engine->contradiction = true;
+					engine->n_forced = i + 1;
+					break ;
+				}
+			}
+		}
+
+		memcpy(engine->plaintext_keyword, plaintext_keyword, ALPHABET_SIZE);
+		memcpy(engine->ciphertext_keyword, ciphertext_keyword, ALPHABET_SIZE);
+		engine->valid = true;
+	}
+
+	for (i = 0; i < engine->n_forced; i++) {
+		cycleword[engine->columns[i]] = engine->forced[i];
+	}
+
+	return engine->contradiction;
+}
+
+
+
+// Score candidate cipher solution. 
+
+double state_score(uint8_t cipher_indices[], int cipher_len, 
+			uint8_t crib_indices[], int crib_positions[], int n_cribs, 
+			uint8_t plaintext_keyword_state[], uint8_t ciphertext_keyword_state[], 
+			uint8_t cycleword_state[], int cycleword_len, 
+			bool variant, bool beaufort, 
+			uint8_t decrypted[], 
+			ngram_table *ngram_data, int ngram_size, 
+			float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy) {
+
+	int counts[ALPHABET_SIZE], n_crib_matches;
+	double ngram_total;
+	cipher_tables tables;
+	score_terms terms;
+
+	// Decrypt cipher using the candidate keyword and cycleword, scoring as we go. 
+
+	build_cipher_tables(&tables, plaintext_keyword_state, ciphertext_keyword_state, 
+		cycleword_state, cycleword_len, variant, beaufort);
+
+	ngram_total = fused_decrypt(&tables, cipher_indices, cipher_len, cycleword_len, 
+		crib_positions, crib_indices, n_cribs, ngram_data, ngram_size, 
+		decrypted, NULL, counts, &n_crib_matches, -INFINITY);
+
+	score_terms_setup(&terms, cipher_len, n_cribs, ngram_data, ngram_size, 
+		weight_ngram, weight_crib, weight_ioc, weight_entropy);
+
+	return score_from_terms(&terms, ngram_total, n_crib_matches, counts);
+}
+
+
+
+// The hill climbing score is 
+
+// 	(weight_ngram*(mean window score*26^n) + weight_crib*(fraction of cribs matched) 
+// 		+ weight_ioc*exp(-(26*IoC - MEAN_ENGLISH_IOC)^2)
+// 		+ weight_entropy*exp(-(entropy - MEAN_ENGLISH_ENTROPY)^2))/(sum of weights)/SCORE_NORMALISATION 
+
+// Everything but the two exponentials is linear in the n-gram total, the number of crib 
+// matches, sum_x c_x*(c_x - 1) and sum_x c_x*log(c_x) for the letter tallies c_x, so the 
+// constants are worked out once here. 
+
+void score_terms_setup(score_terms *terms, int cipher_len, int n_cribs, 
+	ngram_table *ngram_data, int ngram_size, 
+	float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy) {
+
+	static pthread_once_t count_log_count_once = PTHREAD_ONCE_INIT;
+	double normalisation = SCORE_NORMALISATION*(weight_ngram + weight_crib + weight_ioc + weight_entropy);
+
+	pthread_once(&count_log_count_once, build_count_log_count);
+
+	terms->ngram_coefficient = weight_ngram*ngram_data->window_scale/(cipher_len - ngram_size)/normalisation;
+	terms->crib_coefficient = n_cribs == 0 ? 0. : weight_crib/n_cribs/normalisation;
+	terms->ioc_coefficient = weight_ioc/normalisation;
+	terms->entropy_coefficient = weight_entropy/normalisation;
+	terms->ioc_scale = ((double) ALPHABET_SIZE)/((double) cipher_len*(cipher_len - 1));
+	terms->inverse_len = 1./cipher_len;
+	terms->log_len = log(cipher_len);
+
+	return ;
+}
+
+
+
+// c*log(c) for every letter count c of a search window, so that the entropy of a tally 
+// is log(len) - sum_x count_log_count[c_x]/len. The counts of a longer text (when a 
+// solution is confirmed, see confirm_score) are worked out as they are needed. 
+
+double count_log_count[MAX_CIPHER_LENGTH + 1];
+
+void build_count_log_count() {
+
+	count_log_count[0] = 0.;
+	for (int c = 1; c <= MAX_CIPHER_LENGTH; c++) {
+		count_log_count[c] = c*log(c);
+	}
+
+	return ;
+}
+
+
+
+double score_from_terms(score_terms *terms, double ngram_total, int n_crib_matches, int counts[]) {
+
+	long long coincidences = 0;
+	double sum_count_log_count = 0., ioc_offset, entropy_offset;
+
+	for (int i = 0; i < ALPHABET_SIZE; i++) {
+		coincidences += (long long) counts[i]*(counts[i] - 1);
+		sum_count_log_count += counts[i] <= MAX_CIPHER_LENGTH ? count_log_count[counts[i]] : counts[i]*log(counts[i]);
+	}
+
+	ioc_offset = terms->ioc_scale*coincidences - MEAN_ENGLISH_IOC;
+	entropy_offset = terms->log_len - terms->inverse_len*sum_count_log_count - MEAN_ENGLISH_ENTROPY;
+
+	return terms->ngram_coefficient*ngram_total + terms->crib_coefficient*n_crib_matches 
+		+ terms->ioc_coefficient*exp(-ioc_offset*ioc_offset) 
+		+ terms->entropy_coefficient*exp(-entropy_offset*entropy_offset);
+}
+
+
+
+// Decrypt with the lookup tables, tallying the letters, matching the cribs and totalling 
+// the n-gram scores in the same pass. Returns the n-gram total. The n-gram index is rolled 
+// on as each letter is decrypted, window w being complete at letter w + ngram_size - 1, 
+// and the crib positions (which are in ascending order) are checked as they are reached. 
+// If windows is not NULL, the score of each window is stored there. Every 
+// EARLY_ABORT_INTERVAL letters, if the n-gram total could not exceed ngram_bound even 
+// were every remaining window to score the table's maximum, INACTIVE is returned instead. 
+// The kernel is chosen for the n-gram table when it is loaded (see select_fused_kernels). 
+
+double fused_decrypt(cipher_tables *tables, uint8_t cipher_indices[], int cipher_len, int cycleword_len, 
+	int crib_positions[], uint8_t crib_indices[], int n_cribs, ngram_table *ngram_data, int ngram_size, 
+	uint8_t decrypted[], float windows[], int counts[], int *n_crib_matches, double ngram_bound) {
+
+	return ngram_data->fused_kernels[tables->straight_input](tables, cipher_indices, cipher_len, 
+		cycleword_len, crib_positions, crib_indices, n_cribs, ngram_data, ngram_size, 
+		decrypted, windows, counts, n_crib_matches, ngram_bound);
+}
+
+
+
+// The general fused_decrypt kernel, for any table and n-gram size. 
+
+double fused_decrypt_general(cipher_tables *tables, uint8_t cipher_indices[], int cipher_len, int cycleword_len, 
+	int crib_positions[], uint8_t crib_indices[], int n_cribs, ngram_table *ngram_data, int ngram_size, 
+	uint8_t decrypted[], float windows[], int counts[], int *n_crib_matches, double ngram_bound) {
+
+	int i, c, letter, next_crib, n_windows = cipher_len - ngram_size, *inverse = tables->input_inverse, 
+		next_check = ngram_bound > -INFINITY ? EARLY_ABORT_INTERVAL : cipher_len;
+	long long index, top = 1;
+	float window;
+	double ngram_total = 0.;
+
+	for (i = 1; i < ngram_size; i++) {
+		top *= ALPHABET_SIZE;
+	}
+
+	for (i = 0; i < ALPHABET_SIZE; i++) {
+		counts[i] = 0;
+	}
+
+	*n_crib_matches = 0;
+	next_crib = 0;
+	index = 0;
+	c = 0;
+
+	for (i = 0; i < cipher_len; i++) {
+
+		letter = tables->output_alphabet[tables->shifts[c] + inverse[cipher_indices[i]]];
+		decrypted[i] = letter;
+		counts[letter]++;
+		if (++c == cycleword_len) c = 0;
+
+		if (next_crib < n_cribs && crib_positions[next_crib] == i) {
+			*n_crib_matches += letter == crib_indices[next_crib++];
+		}
+
+		index = index/ALPHABET_SIZE + letter*top;
+		if (i >= ngram_size - 1 && i - ngram_size + 1 < n_windows) {
+			window = ngram_lookup(ngram_data, index);
+			if (windows != NULL) {
+				windows[i - ngram_size + 1] = window;
+			}
+			ngram_total += window;
+		}
+
+		if (i == next_check) {
+			if (ngram_total + (n_windows - min(n_windows, max(0, i - ngram_size + 2)))*(double) ngram_data->max_value < ngram_bound) {
+				return INACTIVE;
+			}
+			next_check += EARLY_ABORT_INTERVAL;
+		}
+	}
+
+	return ngram_total;
+}
+
+
+
+// Specialised fused_decrypt kernels for a dense table backend, n-gram size N and whether 
+// the input keyword is the straight alphabet (the ciphertext keyword of Quagmire I and 
+// Beaufort, the plaintext keyword of variant Quagmire II), in which case its inverse is 
+// not looked up. The loop is split where the first window is complete and at each early 
+// abort check, so the letters in between are decrypted and scored without any tests, the 
+// n-gram index is rolled on with constant divisors, and the cribs are matched afterwards. 
+// The windows are summed in the same order as in fused_decrypt, so the totals are 
+// identical. 
+
+#define FUSED_LETTER(STRAIGHT) \
+	letter = output[shifts[c] + ((STRAIGHT) ? cipher_indices[i] : inverse[cipher_indices[i]])]; \
+	decrypted[i] = letter; \
+	counts[letter]++; \
+	if (++c == cycleword_len) c = 0;
+
+#define FUSED_CHECK(N) \
+	if (i == next_check) { \
+		if (ngram_total + (n_windows - min(n_windows, max(0, i - (N) + 2)))*(double) ngram_data->max_value < ngram_bound) { \
+			return INACTIVE; \
+		} \
+		next_check += EARLY_ABORT_INTERVAL; \
+	}
+
+#define FUSED_KERNEL(name, N, STRAIGHT, TYPE, FIELD, SCALED) \
+double name(cipher_tables *tables, uint8_t cipher_indices[], int cipher_len, int cycleword_len, \
+	int crib_positions[], uint8_t crib_indices[], int n_cribs, ngram_table *ngram_data, int ngram_size, \
+	uint8_t decrypted[], float windows[], int counts[], int *n_crib_matches, double ngram_bound) { \
+	\
+	int i, k, c = 0, end, letter, n_windows = cipher_len - (N), matches = 0, \
+		*inverse = tables->input_inverse, *output = tables->output_alphabet, *shifts = tables->shifts, \
+		next_check = ngram_bound > -INFINITY ? EARLY_ABORT_INTERVAL : cipher_len; \
+	unsigned int index = 0, top = (N) == 3 ? 676 : (N) == 4 ? 17576 : (N) == 5 ? 456976 : 11881376; \
+	TYPE *values = ngram_data->FIELD; \
+	float scale = ngram_data->scale, window; \
+	double ngram_total = 0.; \
+	\
+	(void) inverse; \
+	(void) scale; \
+	\
+	for (k = 0; k < ALPHABET_SIZE; k++) { \
+		counts[k] = 0; \
+	} \
+	\
+	for (i = 0; i < min((N) - 1, cipher_len); i++) { \
+		FUSED_LETTER(STRAIGHT) \
+		index = index/ALPHABET_SIZE + letter*top; \
+		FUSED_CHECK(N) \
+	} \
+	\
+	while (i < cipher_len - 1) { \
+		end = min(next_check + 1, cipher_len - 1); \
+		if (windows == NULL) { \
+			for (; i < end; i++) { \
+				FUSED_LETTER(STRAIGHT) \
+				index = index/ALPHABET_SIZE + letter*top; \
+				ngram_total += SCALED(values[index]); \
+			} \
+		} else { \
+			for (; i < end; i++) { \
+				FUSED_LETTER(STRAIGHT) \
+				index = index/ALPHABET_SIZE + letter*top; \
+				window = SCALED(values[index]); \
+				windows[i - (N) + 1] = window; \
+				ngram_total += window; \
+			} \
+		} \
+		i--; \
+		FUSED_CHECK(N) \
+		i++; \
+	} \
+	\
+	for (; i < cipher_len; i++) { \
+		FUSED_LETTER(STRAIGHT) \
+		FUSED_CHECK(N) \
+	} \
+	\
+	for (k = 0; k < n_cribs; k++) { \
+		matches += decrypted[crib_positions[k]] == crib_indices[k]; \
+	} \
+	*n_crib_matches = matches; \
+	\
+	return ngram_total; \
+}
+
+#define FUSED_UNSCALED(x) (x)
+#define FUSED_SCALED(x) (scale*(x))
+
+#define FUSED_KERNELS(backend, TYPE, FIELD, SCALED) \
+	FUSED_KERNEL(fused_decrypt_##backend##_3, 3, false, TYPE, FIELD, SCALED) \
+	FUSED_KERNEL(fused_decrypt_##backend##_4, 4, false, TYPE, FIELD, SCALED) \
+	FUSED_KERNEL(fused_decrypt_##backend##_5, 5, false, TYPE, FIELD, SCALED) \
+	FUSED_KERNEL(fused_decrypt_##backend##_6, 6, false, TYPE, FIELD, SCALED) \
+	FUSED_KERNEL(fused_decrypt_##backend##_3_straight, 3, true, TYPE, FIELD, SCALED) \
+	FUSED_KERNEL(fused_decrypt_##backend##_4_straight, 4, true, TYPE, FIELD, SCALED) \
+	FUSED_KERNEL(fused_decrypt_##backend##_5_straight, 5, true, TYPE, FIELD, SCALED) \
+	FUSED_KERNEL(fused_decrypt_##backend##_6_straight, 6, true, TYPE, FIELD, SCALED)
+
+FUSED_KERNELS(float, float, values, FUSED_UNSCALED)
+FUSED_KERNELS(uint16, uint16_t, values16, FUSED_SCALED)
+FUSED_KERNELS(uint8, uint8_t, values8, FUSED_SCALED)
+
+#define FUSED_KERNEL_ROW(backend) \
+	{{fused_decrypt_##backend##_3, fused_decrypt_##backend##_4, fused_decrypt_##backend##_5, fused_decrypt_##backend##_6}, \
+	{fused_decrypt_##backend##_3_straight, fused_decrypt_##backend##_4_straight, \
+		fused_decrypt_##backend##_5_straight, fused_decrypt_##backend##_6_straight}}
+
+// Dispatch table of the specialised kernels by dense backend, straight input and n-gram 
+// size (see select_fused_kernels). 
+
+fused_decrypt_kernel fused_kernels[NGRAM_SPARSE][2][MAX_SPECIALISED_NGRAM_SIZE - MIN_SPECIALISED_NGRAM_SIZE + 1] = {
+	FUSED_KERNEL_ROW(float), FUSED_KERNEL_ROW(uint16), FUSED_KERNEL_ROW(uint8)};
+
+
+
+// Pick the fused_decrypt kernels of a table, for a keyed and a straight input keyword: 
+// the specialised kernels for a dense table of an n-gram size they are generated for, and 
+// the general loop otherwise. 
+
+void select_fused_kernels(ngram_table *table) {
+
+	int straight;
+
+	for (straight = 0; straight < 2; straight++) {
+		if (table->backend != NGRAM_SPARSE && table->ngram_size >= MIN_SPECIALISED_NGRAM_SIZE 
+			&& table->ngram_size <= MAX_SPECIALISED_NGRAM_SIZE) {
+			table->fused_kernels[straight] = 
+				fused_kernels[table->backend][straight][table->ngram_size - MIN_SPECIALISED_NGRAM_SIZE];
+		} else {
+			table->fused_kernels[straight] = fused_decrypt_general;
+		}
+	}
+
+	return ;
+}
+
+
+
+// Incremental scoring. The cache holds the decryption of the current state together with 
+// each n-gram window's contribution, the letter tallies and the number of crib matches. A 
+// move that only changes some plaintext positions (e.g. a new cycleword letter changes a 
+// single column) is applied with score_cache_apply, which re-decrypts just those positions 
+// and re-scores just the windows overlapping them, recording what it overwrote. The move 
+// is then either kept with score_cache_commit or undone with score_cache_revert. 
+
+// Per-problem data, set up once per worker. 
+
+void score_cache_setup(score_cache *cache, climber_shared *shared) {
+
+	int i;
+
+	cache->cipher_indices = shared->cipher_indices;
+	cache->crib_indices = shared->crib_indices;
+	cache->crib_positions = shared->crib_positions;
+	cache->cipher_len = shared->cipher_len;
+	cache->cycleword_len = shared->cycleword_len;
+	cache->ngram_data = shared->ngram_data;
+	cache->ngram_size = shared->ngram_size;
+	cache->n_windows = shared->cipher_len - shared->ngram_size;
+	cache->n_cribs = shared->n_cribs;
+	score_terms_setup(&cache->terms, shared->cipher_len, shared->n_cribs, 
+		shared->ngram_data, shared->ngram_size, 
+		shared->weight_ngram, shared->weight_crib, shared->weight_ioc, shared->weight_entropy);
+	cache->variant = shared->variant;
+	cache->beaufort = shared->beaufort;
+
+	for (i = 0; i < cache->cipher_len; i++) {
+		cache->crib_letters[i] = INACTIVE;
+		cache->window_stamps[i] = 0;
+		cache->position_stamps[i] = 0;
+	}
+	for (i = 0; i < shared->n_cribs; i++) {
+		cache->crib_letters[shared->crib_positions[i]] = shared->crib_indices[i];
+	}
+	cache->stamp = 0;
+
+	cache->tables = &cache->table_store[0];
+	cache->proposed_tables = &cache->table_store[1];
+	cache->tables_pending = false;
+	cache->full_pending = false;
+
+	build_column_letter_index(cache);
+
+	cache->n_undo_letters = 0;
+	cache->n_undo_windows = 0;
+	cache->undo_column = INACTIVE;
+
+	return ;
+}
+
+
+
+// Inverted index from (column, ciphertext letter) to the ciphertext positions holding that 
+// letter in that column, stored contiguously (positions of letter x in column c are 
+// column_letter_positions[column_letter_offsets[c][x] ... column_letter_offsets[c][x + 1] - 1]). 
+// The letters present in each column are also listed, so that empty entries can be skipped. 
+
+void build_column_letter_index(score_cache *cache) {
+
+	int i, c, x, offset, L = cache->cycleword_len, 
+		next[MAX_CYCLEWORD_LEN][ALPHABET_SIZE];
+
+	for (c = 0; c < L; c++) {
+		for (x = 0; x <= ALPHABET_SIZE; x++) {
+			cache->column_letter_offsets[c][x] = 0;
+		}
+	}
+
+	for (i = 0; i < cache->cipher_len; i++) {
+		cache->column_letter_offsets[i % L][cache->cipher_indices[i] + 1]++;
+	}
+
+	offset = 0;
+	for (c = 0; c < L; c++) {
+		cache->n_column_letters[c] = 0;
+		for (x = 0; x < ALPHABET_SIZE; x++) {
+			if (cache->column_letter_offsets[c][x + 1] > 0) {
+				cache->column_letters[c][cache->n_column_letters[c]++] = x;
+			}
+			next[c][x] = offset;
+			cache->column_letter_offsets[c][x] = offset;
+			offset += cache->column_letter_offsets[c][x + 1];
+		}
+		cache->column_letter_offsets[c][ALPHABET_SIZE] = offset;
+	}
+
+	for (i = 0; i < cache->cipher_len; i++) {
+		c = i % L;
+		cache->column_letter_positions[next[c][cache->cipher_indices[i]]++] = i;
+	}
+
+	return ;
+}
+
+
+
+// Decrypt and score a new current state. 
+
+void score_cache_init(score_cache *cache, 
+	uint8_t plaintext_keyword_state[], uint8_t ciphertext_keyword_state[], uint8_t cycleword_state[]) {
+
+	build_cipher_tables(cache->tables, plaintext_keyword_state, ciphertext_keyword_state, 
+		cycleword_state, cache->cycleword_len, cache->variant, cache->beaufort);
+
+	score_cache_decrypt(cache);
+
+	return ;
+}
+
+
+
+// Decrypt and score with the current lookup tables. 
+
+void score_cache_decrypt(score_cache *cache) {
+
+	cache->ngram_total = fused_decrypt(cache->tables, cache->cipher_indices, cache->cipher_len, 
+		cache->cycleword_len, cache->crib_positions, cache->crib_indices, cache->n_cribs, 
+		cache->ngram_data, cache->ngram_size, cache->decrypted, cache->windows, 
+		cache->counts, &cache->n_crib_matches, -INFINITY);
+
+	cache->tables_pending = false;
+	cache->full_pending = false;
+	cache->n_undo_letters = 0;
+	cache->n_undo_windows = 0;
+	cache->undo_column = INACTIVE;
+
+	return ;
+}
+
+
+
+// Score of the cached decryption (equal to state_score for the same state). 
+
+double score_cache_score(score_cache *cache) {
+
+	return score_cache_tally_score(cache, cache->ngram_total, cache->n_crib_matches, cache->counts);
+}
+
+
+
+double score_cache_tally_score(score_cache *cache, double ngram_total, int n_crib_matches, int counts[]) {
+
+	return score_from_terms(&cache->terms, ngram_total, n_crib_matches, counts);
+}
+
+
+
+// Score of the decryption with the given lookup tables, without changing the cache. If 
+// the score cannot exceed threshold, scoring may stop early and return threshold: the crib 
+// matches are counted first, the IoC and entropy terms are at most their weights, and the 
+// windows not yet scored are at most the table's largest score. 
+
+double score_cache_full_score(score_cache *cache, cipher_tables *tables, double threshold) {
+
+	int i, p, n_crib_matches, counts[ALPHABET_SIZE];
+	uint8_t decrypted[MAX_CIPHER_LENGTH];
+	double ngram_total, ngram_bound = -INFINITY;
+	score_terms *terms = &cache->terms;
+
+	if (threshold > -INFINITY && terms->ngram_coefficient > 0.) {
+		n_crib_matches = 0;
+		for (i = 0; i < cache->n_cribs; i++) {
+			p = cache->crib_positions[i];
+			n_crib_matches += tables->output_alphabet[tables->shifts[p % cache->cycleword_len] 
+				+ tables->input_inverse[cache->cipher_indices[p]]] == cache->crib_indices[i];
+		}
+		ngram_bound = (threshold - terms->crib_coefficient*n_crib_matches 
+			- terms->ioc_coefficient - terms->entropy_coefficient)/terms->ngram_coefficient;
+	}
+
+	ngram_total = fused_decrypt(tables, cache->cipher_indices, cache->cipher_len, cache->cycleword_len, 
+		cache->crib_positions, cache->crib_indices, cache->n_cribs, cache->ngram_data, cache->ngram_size, 
+		decrypted, NULL, counts, &n_crib_matches, ngram_bound);
+
+	if (ngram_total == INACTIVE) {
+		return threshold;
+	}
+
+	return score_cache_tally_score(cache, ngram_total, n_crib_matches, counts);
+}
+
+
+
+// Replace the plaintext letters at positions[] with letters[] and update the windows, 
+// tallies and crib matches. Any previous move must have been committed or reverted. 
+
+void score_cache_apply(score_cache *cache, int n, int positions[], uint8_t letters[]) {
+
+	int i, p, w, w_min, w_max, old_letter, last_changed, ngram_size = cache->ngram_size;
+
+	cache->undo_ngram_total = cache->ngram_total;
+	cache->undo_n_crib_matches = cache->n_crib_matches;
+
+	// Plaintext letters, tallies and cribs. 
+
+	for (i = 0; i < n; i++) {
+		p = positions[i];
+		old_letter = cache->decrypted[p];
+		if (old_letter == letters[i]) continue ;
+
+		cache->undo_positions[cache->n_undo_letters] = p;
+		cache->undo_letters[cache->n_undo_letters++] = old_letter;
+
+		cache->decrypted[p] = letters[i];
+		cache->counts[old_letter]--;
+		cache->counts[letters[i]]++;
+
+		if (cache->crib_letters[p] != INACTIVE) {
+			cache->n_crib_matches += (letters[i] == cache->crib_letters[p]) - (old_letter == cache->crib_letters[p]);
+		}
+	}
+
+	// n-gram windows overlapping the changed positions, each re-scored once. 
+
+	if (++cache->stamp == INT_MAX) {
+		for (w = 0; w < cache->n_windows; w++) cache->window_stamps[w] = 0;
+		for (p = 0; p < cache->cipher_len; p++) cache->position_stamps[p] = 0;
+		cache->stamp = 1;
+	}
+
+	if (cache->n_undo_letters*ngram_size > cache->n_windows) {
+
+		// Many changes (typically a keyword move): a single pass over the plaintext, tracking 
+		// the last changed position, is cheaper than visiting the windows of each change. 
+
+		for (i = 0; i < cache->n_undo_letters; i++) {
+			cache->position_stamps[cache->undo_positions[i]] = cache->stamp;
+		}
+
+		last_changed = -ngram_size;
+		for (p = 0; p < cache->n_windows + ngram_size - 1; p++) {
+			if (cache->position_stamps[p] == cache->stamp) last_changed = p;
+			w = p - ngram_size + 1;
+			if (w < 0 || last_changed < w) continue ;
+			cache->undo_window_indices[cache->n_undo_windows] = w;
+			cache->undo_windows[cache->n_undo_windows++] = cache->windows[w];
+			cache->ngram_total -= cache->windows[w];
+			cache->windows[w] = ngram_lookup(cache->ngram_data, ngram_index_int(cache->decrypted + w, ngram_size));
+			cache->ngram_total += cache->windows[w];
+		}
+
+		return ;
+	}
+
+	for (i = 0; i < cache->n_undo_letters; i++) {
+		p = cache->undo_positions[i];
+		w_min = max(0, p - ngram_size + 1);
+		w_max = min(p, cache->n_windows - 1);
+		for (w = w_min; w <= w_max; w++) {
+			if (cache->window_stamps[w] == cache->stamp) continue ;
+			cache->window_stamps[w] = cache->stamp;
+			cache->undo_window_indices[cache->n_undo_windows] = w;
+			cache->undo_windows[cache->n_undo_windows++] = cache->windows[w];
+			cache->ngram_total -= cache->windows[w];
+			cache->windows[w] = ngram_lookup(cache->ngram_data, ngram_index_int(cache->decrypted + w, ngram_size));
+			cache->ngram_total += cache->windows[w];
+		}
+	}
+
+	return ;
+}
+
+
+
+// Move: the cycleword letter of column is changed to cw_indx. Only the positions 
+// i = column (mod cycleword_len) are re-decrypted, unless their windows are so large a 
+// fraction of all the windows (a cycleword that is short against the n-gram size) that 
+// the fused full re-score is cheaper, as in score_cache_update_state. 
+
+double score_cache_update_column(score_cache *cache, int column, int cw_indx, double threshold) {
+
+	int i, n, *shifted_alphabet, *positions = cache->move_positions;
+	uint8_t *letters = cache->move_letters;
+
+	cache->undo_column = column;
+	cache->undo_shift = cache->tables->shifts[column];
+	cache->tables->shifts[column] = column_shift(cache->tables, cw_indx);
+
+	n = (cache->cipher_len - column + cache->cycleword_len - 1)/cache->cycleword_len;
+
+	if (n*cache->ngram_size*INCREMENTAL_WINDOW_FRACTION > cache->n_windows) {
+		cache->full_pending = true;
+		return score_cache_full_score(cache, cache->tables, threshold);
+	}
+
+	shifted_alphabet = cache->tables->output_alphabet + cache->tables->shifts[column];
+
+	n = 0;
+	for (i = column; i < cache->cipher_len; i += cache->cycleword_len) {
+		positions[n] = i;
+		letters[n++] = shifted_alphabet[cache->tables->input_inverse[cache->cipher_indices[i]]];
+	}
+
+	score_cache_apply(cache, n, positions, letters);
+
+	return score_cache_score(cache);
+}
+
+
+
+// Plaintext positions that change if the current state is replaced by the state with 
+// lookup tables proposed (typically after a keyword move). For each column, only the 
+// ciphertext letters present in that column are remapped, and the positions of those 
+// whose plaintext letter changes are taken from the inverted index. Returns the number 
+// of changed positions, writing them and their new letters to positions[] and letters[], 
+// or INACTIVE as soon as there are more than max_changes. 
+
+int changed_positions(score_cache *cache, cipher_tables *proposed, int max_changes, 
+	int positions[], uint8_t letters[]) {
+
+	int c, k, x, p, n = 0, old_letter, new_letter, *old_alphabet, *new_alphabet, 
+		*index = cache->column_letter_positions;
+	cipher_tables *current = cache->tables;
+
+	for (c = 0; c < cache->cycleword_len; c++) {
+		old_alphabet = current->output_alphabet + current->shifts[c];
+		new_alphabet = proposed->output_alphabet + proposed->shifts[c];
+		for (k = 0; k < cache->n_column_letters[c]; k++) {
+			x = cache->column_letters[c][k];
+			old_letter = old_alphabet[current->input_inverse[x]];
+			new_letter = new_alphabet[proposed->input_inverse[x]];
+			if (old_letter != new_letter) {
+				if (n + cache->column_letter_offsets[c][x + 1] - cache->column_letter_offsets[c][x] > max_changes) {
+					return INACTIVE;
+				}
+				for (p = cache->column_letter_offsets[c][x]; p < cache->column_letter_offsets[c][x + 1]; p++) {
+					positions[n] = index[p];
+					letters[n++] = new_letter;
+				}
+			}
+		}
+	}
+
+	return n;
+}
+
+
+
+// Move: replace the current state by an arbitrary new state. Only the plaintext positions 
+// that change (see changed_positions) and the n-gram windows overlapping them are re-scored, 
+// unless so many change that re-scoring the whole decryption is cheaper (typically for 
+// short ciphers), in which case the cache itself is only rebuilt if the move is kept, and 
+// scoring may stop early if the move cannot beat threshold (see score_cache_full_score). 
+
+double score_cache_update_state(score_cache *cache, 
+	uint8_t plaintext_keyword_state[], uint8_t ciphertext_keyword_state[], uint8_t cycleword_state[], 
+	double threshold) {
+
+	int n, *positions = cache->move_positions;
+	uint8_t *letters = cache->move_letters;
+
+	build_cipher_tables(cache->proposed_tables, plaintext_keyword_state, ciphertext_keyword_state, 
+		cycleword_state, cache->cycleword_len, cache->variant, cache->beaufort);
+	cache->tables_pending = true;
+
+	n = changed_positions(cache, cache->proposed_tables, 
+		cache->n_windows/(cache->ngram_size*INCREMENTAL_WINDOW_FRACTION), positions, letters);
+
+	if (n == INACTIVE) {
+		cache->full_pending = true;
+		return score_cache_full_score(cache, cache->proposed_tables, threshold);
+	}
+
+	score_cache_apply(cache, n, positions, letters);
+
+	return score_cache_score(cache);
+}
+
+
+
+// Score a batch of candidate states with one pass over the ciphertext, returning the 
+// index of the best. Each ciphertext letter is loaded once for all the candidates, and 
+// the rolling n-gram indices of the candidates advance together through the windows, 
+// so the inner loops run across candidates. Scores equal score_cache_full_score. 
+
+int score_candidate_batch(candidate_batch *batch, score_cache *cache) {
+
+	int i, k, c, x, letter, best, n = batch->n_candidates, crib_letter, 
+		cycleword_len = cache->cycleword_len, ngram_size = cache->ngram_size;
+	long long top = 1, indices[MAX_BATCH];
+	cipher_tables *tables;
+
+	for (k = 0; k < n; k++) {
+		tables = &batch->tables[k];
+		build_cipher_tables(tables, batch->states[k].plaintext_keyword, batch->states[k].ciphertext_keyword, 
+			batch->states[k].cycleword, cycleword_len, cache->variant, cache->beaufort);
+		for (x = 0; x < ALPHABET_SIZE; x++) {
+			batch->counts[k][x] = 0;
+		}
+		batch->n_crib_matches[k] = 0;
+		batch->ngram_totals[k] = 0.;
+	}
+
+	// Decrypt, tally and match cribs. 
+
+	c = 0;
+	for (i = 0; i < cache->cipher_len; i++) {
+		x = cache->cipher_indices[i];
+		for (k = 0; k < n; k++) {
+			tables = &batch->tables[k];
+			letter = tables->output_alphabet[tables->shifts[c] + tables->input_inverse[x]];
+			batch->plaintext[i][k] = letter;
+			batch->counts[k][letter]++;
+		}
+		crib_letter = cache->crib_letters[i];
+		if (crib_letter != INACTIVE) {
+			for (k = 0; k < n; k++) {
+				batch->n_crib_matches[k] += batch->plaintext[i][k] == crib_letter;
+			}
+		}
+		if (++c == cycleword_len) c = 0;
+	}
+
+	// n-gram windows, with the index of each candidate's next window rolled on from the 
+	// last (as in ngram_score_rolling). 
+
+	for (i = 1; i < ngram_size; i++) {
+		top *= ALPHABET_SIZE;
+	}
+
+	for (k = 0; k < n; k++) {
+		indices[k] = 0;
+		for (i = ngram_size - 1; i >= 0; i--) {
+			indices[k] = indices[k]*ALPHABET_SIZE + batch->plaintext[i][k];
+		}
+	}
+
+	for (i = 0; i < cache->n_windows; i++) {
+		for (k = 0; k < n; k++) {
+			batch->ngram_totals[k] += ngram_lookup(cache->ngram_data, indices[k]);
+			indices[k] = indices[k]/ALPHABET_SIZE + batch->plaintext[i + ngram_size][k]*top;
+		}
+	}
+
+	best = 0;
+	for (k = 0; k < n; k++) {
+		batch->scores[k] = score_cache_tally_score(cache, batch->ngram_totals[k], 
+			batch->n_crib_matches[k], batch->counts[k]);
+		if (batch->scores[k] > batch->scores[best]) {
+			best = k;
+		}
+	}
+
+	return best;
+}
+
+
+
+// Keep the pending move. 
+
+void score_cache_commit(score_cache *cache) {
+
+	cipher_tables *tables;
+
+	if (cache->tables_pending) {
+		tables = cache->tables;
+		cache->tables = cache->proposed_tables;
+		cache->proposed_tables = tables;
+	}
+
+	if (cache->full_pending) {
+		score_cache_decrypt(cache);
+	}
+
+	cache->tables_pending = false;
+	cache->full_pending = false;
+	cache->n_undo_letters = 0;
+	cache->n_undo_windows = 0;
+	cache->undo_column = INACTIVE;
+
+	return ;
+}
+
+
+
+// Undo the pending move. 
+
+void score_cache_revert(score_cache *cache) {
+
+	int i, p;
+
+	for (i = cache->n_undo_windows - 1; i >= 0; i--) {
+		cache->windows[cache->undo_window_indices[i]] = cache->undo_windows[i];
+	}
+
+	for (i = cache->n_undo_letters - 1; i >= 0; i--) {
+		p = cache->undo_positions[i];
+		cache->counts[cache->decrypted[p]]--;
+		cache->counts[cache->undo_letters[i]]++;
+		cache->decrypted[p] = cache->undo_letters[i];
+	}
+
+	if (cache->undo_column != INACTIVE) {
+		cache->tables->shifts[cache->undo_column] = cache->undo_shift;
+	}
+
+	if (! cache->full_pending) {
+		cache->ngram_total = cache->undo_ngram_total;
+		cache->n_crib_matches = cache->undo_n_crib_matches;
+	}
+
+	cache->tables_pending = false;
+	cache->full_pending = false;
+	score_cache_commit(cache);
+
+	return ;
+}
+
+
+
+
+// Entropy. 
+
+double entropy(uint8_t text[], int len) {
+
+	int frequencies[ALPHABET_SIZE];
+
+	// Count frequencies of each plaintext letter. 
+	tally(text, len, frequencies, ALPHABET_SIZE);
+
+	return entropy_from_tally(frequencies, len);
+}
+
+
+
+double entropy_from_tally(int frequencies[], int len) {
+
+	double entropy = 0., freq;
+
+	for (int i = 0; i < ALPHABET_SIZE; i++) {
+		if (frequencies[i] > 0) {
+			freq = ((double) frequencies[i])/len;
+			entropy -= freq*log(freq);
+		}
+	}
+	// printf("entropy = %.4f\n", entropy);
+
+	return entropy;
+}
+
+
+
+// Chi-squared score. 
+
+double chi_squared(uint8_t plaintext[], int len) {
+
+	int i, counts[ALPHABET_SIZE];
+	double frequency, chi2 = 0.;
+
+	tally(plaintext, len, counts, ALPHABET_SIZE);
+
+	for (i = 0; i < ALPHABET_SIZE; i++) {
+		frequency = ((double) counts[i])/len;
+		// printf("%d, %.4f, %.4f\n", i, frequency, english_monograms[i]);
+		chi2 += pow(frequency - english_monograms[i], 2)/english_monograms[i];
+	}
+
+	return chi2;
+}
+
+
+
+
+// Score for known plaintext. (Naive - not using symmetry of the Vigenere encryption.)
+
+double crib_score(uint8_t text[], int len, uint8_t crib_indices[], int crib_positions[], int n_cribs) {
+
+	if (n_cribs == 0) return 0.;
+
+	int n_matches = 0;
+
+	for (int i = 0; i < n_cribs; i++) {
+		if (text[crib_positions[i]] == crib_indices[i]) {
+			n_matches += 1;
+		}
+	}
+
+	return ((double) n_matches)/((double) n_cribs);
+}
+
+
+
+// Score a plaintext based on ngram frequencies, with the kernel chosen for the table 
+// (see select_ngram_score_kernel). 
+
+double ngram_score(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size) {
+
+	return ngram_data->score_kernel(decrypted, cipher_len, ngram_data, ngram_size);
+}
+
+
+
+// Pick the n-gram scoring kernel: a vector gather from a dense float table where the 
+// CPU supports it, and the rolling index scorer otherwise. 
+
+void select_ngram_score_kernel(ngram_table *table) {
+
+	table->window_scale = pow(ALPHABET_SIZE, table->ngram_size);
+	table->score_kernel = ngram_score_rolling;
+	table->score_kernel_name = "rolling";
+
+#if NGRAM_SIMD
+	if (table->backend == NGRAM_FLOAT && table->ngram_size <= MAX_DENSE_NGRAM_SIZE) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) {
+			table->score_kernel = ngram_score_avx512;
+			table->score_kernel_name = "avx512";
+		} else if (__builtin_cpu_supports("avx2")) {
+			table->score_kernel = ngram_score_avx2;
+			table->score_kernel_name = "avx2";
+		}
+	}
+#endif
+
+	select_fused_kernels(table);
+
+	return ;
+}
+
+
+
+// Consecutive windows share ngram_size - 1 letters, and the first letter of a window 
+// is the least significant digit of its index, so the index of the next window is 
+// index/26 + (next letter)*26^(ngram_size - 1). 
+
+double ngram_score_rolling(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size) {
+
+	int i, n_windows = cipher_len - ngram_size;
+	long long index, top = 1;
+	double score = 0.;
+
+	if (n_windows > 0) {
+		for (i = 1; i < ngram_size; i++) {
+			top *= ALPHABET_SIZE;
+		}
+		index = ngram_index_int(decrypted, ngram_size);
+		for (i = 0; i < n_windows; i++) {
+			score += ngram_lookup(ngram_data, index);
+			index = index/ALPHABET_SIZE + decrypted[i + ngram_size]*top;
+		}
+	}
+
+	return ngram_data->window_scale*score/n_windows;
+}
+
+
+
+#if NGRAM_SIMD
+
+// Eight windows at a time: the indices are built by Horner's rule from widened byte loads 
+// of the plaintext at offsets 0, ..., ngram_size - 1, and the scores gathered from the 
+// dense float table. Scores are accumulated in double precision, as in the scalar code. 
+
+__attribute__((target("avx2")))
+double ngram_score_avx2(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size) {
+
+	int i, j, n_windows = cipher_len - ngram_size;
+	float *values = ngram_data->values;
+	double score, partial[4];
+	__m256i index, base = _mm256_set1_epi32(ALPHABET_SIZE);
+	__m256 gathered;
+	__m256d total = _mm256_setzero_pd();
+
+	for (i = 0; i + 8 <= n_windows; i += 8) {
+		index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i *) (decrypted + i + ngram_size - 1)));
+		for (j = ngram_size - 2; j >= 0; j--) {
+			index = _mm256_add_epi32(_mm256_mullo_epi32(index, base), 
+				_mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i *) (decrypted + i + j))));
+		}
+		gathered = _mm256_i32gather_ps(values, index, sizeof(float));
+		total = _mm256_add_pd(total, _mm256_cvtps_pd(_mm256_castps256_ps128(gathered)));
+		total = _mm256_add_pd(total, _mm256_cvtps_pd(_mm256_extractf128_ps(gathered, 1)));
+	}
+
+	_mm256_storeu_pd(partial, total);
+	score = partial[0] + partial[1] + partial[2] + partial[3];
+
+	for (; i < n_windows; i++) {
+		score += values[ngram_index_int(decrypted + i, ngram_size)];
+	}
+
+	return ngram_data->window_scale*score/n_windows;
+}
+
+
+
+// As ngram_score_avx2, sixteen windows at a time, with the remainder done in one 
+// masked step. 
+
+__attribute__((target("avx512f")))
+double ngram_score_avx512(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size) {
+
+	int i, j, n_windows = cipher_len - ngram_size;
+	uint8_t tail[16 + MAX_NGRAM_SIZE] = {0};
+	float *values = ngram_data->values;
+	double score;
+	__m512i index, base = _mm512_set1_epi32(ALPHABET_SIZE);
+	__m512 gathered;
+	__mmask16 mask;
+	__m512d total = _mm512_setzero_pd();
+
+	for (i = 0; i + 16 <= n_windows; i += 16) {
+		index = _mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i *) (decrypted + i + ngram_size - 1)));
+		for (j = ngram_size - 2; j >= 0; j--) {
+			index = _mm512_add_epi32(_mm512_mullo_epi32(index, base), 
+				_mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i *) (decrypted + i + j))));
+		}
+		gathered = _mm512_i32gather_ps(index, values, sizeof(float));
+		total = _mm512_add_pd(total, _mm512_cvtps_pd(_mm512_castps512_ps256(gathered)));
+		total = _mm512_add_pd(total, _mm512_cvtps_pd(_mm256_castpd_ps(
+			_mm512_extractf64x4_pd(_mm512_castps_pd(gathered), 1))));
+	}
+
+	// The last few windows, from a zero-padded copy of the remaining letters so that the 
+	// loads stay in bounds, with a masked gather (masked-off lanes gather 0). 
+
+	if (i < n_windows) {
+		mask = (__mmask16) ((1u << (n_windows - i)) - 1);
+		memcpy(tail, decrypted + i, cipher_len - i);
+		index = _mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i *) (tail + ngram_size - 1)));
+		for (j = ngram_size - 2; j >= 0; j--) {
+			index = _mm512_add_epi32(_mm512_mullo_epi32(index, base), 
+				_mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i *) (tail + j))));
+		}
+		gathered = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, index, values, sizeof(float));
+		total = _mm512_add_pd(total, _mm512_cvtps_pd(_mm512_castps512_ps256(gathered)));
+		total = _mm512_add_pd(total, _mm512_cvtps_pd(_mm256_castpd_ps(
+			_mm512_extractf64x4_pd(_mm512_castps_pd(gathered), 1))));
+	}
+
+	score = _mm512_reduce_add_pd(total);
+
+	return ngram_data->window_scale*score/n_windows;
+}
+
+#endif
+
+
+
+// Score a plaintext based on ngram frequencies, computing each window's index afresh. 
+
+double ngram_score_direct(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size) {
+
+	long long index, base;
+	double score = 0.;
+
+	for (int i = 0; i < cipher_len - ngram_size; i++) {
+
+		index = 0;
+		base = 1;
+
+		for (int j = 0; j < ngram_size; j++) {
+			index += decrypted[i + j]*base;
+			base *= ALPHABET_SIZE;
+		}
+
+		score += ngram_lookup(ngram_data, index);
+	}
+
+	// Normalise to cipher length and n-gram size. 
+
+	score = pow(ALPHABET_SIZE,ngram_size)*score/(cipher_len - ngram_size);
+
+	return score;
+}
+
+
+// Old, slow ngram score routine. 
+
+double ngram_score_slow(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size) {
+
+	uint8_t ngram[MAX_NGRAM_SIZE];
+	long long indx;
+	double score = 0.;
+
+	for (int i = 0; i < cipher_len - ngram_size; i++) {
+
+		// printf("\n");
+		// Extract slice decrypted[i : i + ngram_size].
+		for (int j = 0; j < ngram_size; j++) {
+			ngram[j] = decrypted[i + j];
+			// printf("%c", ngram[j] + 'A');
+		}
+		// printf("\t");
+
+		indx = ngram_index_int(ngram, ngram_size);
+		// printf("%.12f", ngram_data[indx]);
+		score += ngram_lookup(ngram_data, indx);
+	}
+
+	return pow(ALPHABET_SIZE,ngram_size)*score/(cipher_len - ngram_size);
+}
+
+
+
+// Given a ciphertext, keyword and cycleword (all in index form), compute the 
+// Quagmire 4 decryption. 
+
+void quagmire_decrypt(uint8_t decrypted[], uint8_t cipher_indices[], int cipher_len, 
+	uint8_t plaintext_keyword_indices[], uint8_t ciphertext_keyword_indices[], 
+	uint8_t cycleword_indices[], int cycleword_len, bool beaufort) {
+	
+	cipher_tables tables;
+
+	build_cipher_tables(&tables, plaintext_keyword_indices, ciphertext_keyword_indices, 
+		cycleword_indices, cycleword_len, false, beaufort);
+
+	polyalphabetic_gather(decrypted, cipher_indices, cipher_len, 
+		tables.input_inverse, tables.output_alphabet, tables.shifts, cycleword_len);
+
+	return ;
+}
+
+
+
+// Given a ciphertext, keyword and cycleword (all in index form), compute the 
+// Quagmire 4 encryption. 
+
+void quagmire_encrypt(uint8_t encrypted[], uint8_t plaintext_indices[], int cipher_len, 
+	uint8_t plaintext_keyword_indices[], uint8_t ciphertext_keyword_indices[], 
+	uint8_t cycleword_indices[], int cycleword_len, bool beaufort) {
+	
+	cipher_tables tables;
+
+	build_cipher_tables(&tables, plaintext_keyword_indices, ciphertext_keyword_indices, 
+		cycleword_indices, cycleword_len, true, beaufort);
+
+	polyalphabetic_gather(encrypted, plaintext_indices, cipher_len, 
+		tables.input_inverse, tables.output_alphabet, tables.shifts, cycleword_len);
+
+	return ;
+}
+
+
+
+// Lookup tables for decryption (or encryption, for variants) with a given state. 
+
+// The position of each input char in the input keyword comes from the inverse of that 
+// keyword, and the position of the cycleword char in the ciphertext keyword only depends 
+// on the column (i % cycleword_len), so both are computed once up front and decryption 
+// is a straight gather (see polyalphabetic_gather). 
+
+void build_cipher_tables(cipher_tables *tables, 
+	uint8_t plaintext_keyword_indices[], uint8_t ciphertext_keyword_indices[], 
+	uint8_t cycleword_indices[], int cycleword_len, bool variant, bool beaufort) {
+
+	int i;
+
+	tables->variant = variant;
+	tables->beaufort = beaufort;
+
+	invert_alphabet(ciphertext_keyword_indices, tables->ciphertext_keyword_inverse);
+
+	if (variant) {
+		invert_alphabet(plaintext_keyword_indices, tables->input_inverse);
+		doubled_alphabet(ciphertext_keyword_indices, tables->output_alphabet, beaufort);
+	} else {
+		memcpy(tables->input_inverse, tables->ciphertext_keyword_inverse, sizeof(tables->input_inverse));
+		doubled_alphabet(plaintext_keyword_indices, tables->output_alphabet, beaufort);
+	}
+
+	tables->straight_input = true;
+	for (i = 0; i < ALPHABET_SIZE && tables->straight_input; i++) {
+		tables->straight_input = tables->input_inverse[i] == i;
+	}
+
+	for (int i = 0; i < cycleword_len; i++) {
+		tables->shifts[i] = column_shift(tables, cycleword_indices[i]);
+	}
+
+	return ;
+}
+
+
+
+// Offset into the doubled output alphabet for a column with cycleword char cw_indx. 
+
+int column_shift(cipher_tables *tables, int cw_indx) {
+
+	if (tables->beaufort) {
+		cw_indx = ALPHABET_SIZE - cw_indx - 1; // Atbash
+	}
+
+	if (tables->variant) {
+		// posn_keyword + posn_cycleword. 
+		return tables->ciphertext_keyword_inverse[cw_indx];
+	}
+
+	// posn_keyword - posn_cycleword = posn_keyword + (ALPHABET_SIZE - posn_cycleword) (mod ALPHABET_SIZE).
+	return ALPHABET_SIZE - tables->ciphertext_keyword_inverse[cw_indx];
+}
+
+
+
+// output[i] = alphabet[inverse[input[i]] + shifts[i % cycleword_len]], where alphabet 
+// holds two copies of the output keyword so that no modular reduction is needed. The 
+// text is walked column by column so the shift is fixed in the inner loop. 
+
+void polyalphabetic_gather(uint8_t output[], uint8_t input[], int len, 
+	int inverse[], int alphabet[], int shifts[], int cycleword_len) {
+
+	int i, j, *shifted_alphabet;
+
+	for (i = 0; i < cycleword_len && i < len; i++) {
+		shifted_alphabet = alphabet + shifts[i];
+		for (j = i; j < len; j += cycleword_len) {
+			output[j] = shifted_alphabet[inverse[input[j]]];
+		}
+	}
+
+	return ;
+}
+
+
+
+// Inverse of a keyed alphabet, i.e. inverse[keyword[i]] = i. 
+
+void invert_alphabet(uint8_t keyword[], int inverse[]) {
+
+	for (int i = 0; i < ALPHABET_SIZE; i++) {
+		inverse[keyword[i]] = i;
+	}
+
+	return ;
+}
+
+
+
+// Two consecutive copies of a keyed alphabet (Atbash'ed for the Beaufort cipher). 
+
+void doubled_alphabet(uint8_t keyword[], int doubled[], bool beaufort) {
+
+	for (int i = 0; i < ALPHABET_SIZE; i++) {
+		doubled[i] = beaufort ? ALPHABET_SIZE - keyword[i] - 1 : keyword[i]; // Atbash
+		doubled[i + ALPHABET_SIZE] = doubled[i];
+	}
+
+	return ;
+}
+
+
+
+// perturbate a cycleword. 
+
+void perturbate_cycleword(uint8_t state[], int max, int len) {
+
+	int i; 
+	i = rand_int(0, len);
+	state[i] = rand_int(0, max);
+}
+
+
+
+// perturbate a key - Ref: http://www.mountainvistasoft.com/cryptoden/articles/Q3%20Keyspace.pdf
+
+void perturbate_keyword(uint8_t state[], int len, int keyword_len, keyword_sampler *sampler) {
+
+	int i, j, k, l, temp;
+
+	if (frand() < 0.2) {
+		// Once in 5, swap two letters within the keyspace.  
+		i = rand_int(0, keyword_len);
+		j = rand_int(0, keyword_len);
+		temp = state[i];
+		state[i] = state[j];
+		state[j] = temp;
+	} else {
+		// Four times in 5, swap a letter in the keyspace with 
+		// a letter outside and remake the letters following the 
+		// keyspace in normal order.
+
+#if FREQUENCY_WEIGHTED_SELECTION
+		keyword_sampler_sync(sampler, state, keyword_len);
+		i = rand_int_frequency_weighted(sampler, state, keyword_len, true);
+		j = rand_int_frequency_weighted(sampler, state, keyword_len, false);
+#else
+		i = rand_int(0, keyword_len);
+		j = rand_int(keyword_len, len);
+#endif
+
+		// printf("\ni,j = %d,%d\n", i, j);
+
+		temp = state[i];
+		state[i] = state[j];
+
+		// Re-order - delete state[j]. 
+
+		for (k = j + 1; k < len; k++) {
+			state[k - 1] = state[k];
+		}
+		
+		// Re-order - insert state[i]. 
+		for (k = keyword_len; k < len; k++) {
+			// Find insertion point. 
+			if (state[k] > temp || k == len - 1) {
+				// Shunt along. 
+				for (l = len - 1; l > k; l--) {
+					state[l] = state[l - 1];
+				}
+				// Insert. 
+				state[k] = temp;
+				break ;
 			}
 		}
 
-		// Find the position of cycleword char in keyword. 
-		for (j = 0; j < ALPHABET_SIZE; j++) {
-			cw_indx = cycleword_indices[i%cycleword_len];
-			if (beaufort) {
-				cw_indx = ALPHABET_SIZE - cw_indx - 1; // Atbash
+	}
+
+	return ;
+}
+
+
+
+// Random keyword initialisation routine. 
+
+void random_keyword(uint8_t keyword[], int len, int keyword_len) {
+
+	int i, j, candidate, indx, n_chars;
+	bool distinct, present;
+
+	// Get keyword_len distinct letters in [0 - ALPHABET_SIZE). 
+
+	n_chars = 0;
+	while (n_chars < keyword_len) {
+
+		distinct = true;
+		candidate = rand_int(0, ALPHABET_SIZE);
+
+		for (i = 0; i < n_chars; i++) {
+			if (keyword[i] == candidate) {
+				distinct = false;
+				break ;
 			}
-			if (cw_indx == ciphertext_keyword_indices[j]) {
-				posn_cycleword = j; 
+		}
+
+		if (distinct) {
+			keyword[n_chars++] = candidate;
+		}
+	}
+
+	// Pad out the rest of the chars. Eg. if we have "KRYPTOS", then here we 
+	// generate "ABCDEFGHIJLMNQUVWXZ" (in index form). 
+
+	indx = keyword_len;
+	for (i = 0; i < ALPHABET_SIZE; i++) {
+
+		present = false;
+		for (j = 0; j < keyword_len; j++) {
+			if (keyword[j] == i) {
+				present = true; 
 				break ;
 			}
 		}
 
-		indx = (posn_keyword - posn_cycleword)%ALPHABET_SIZE;
-		if (indx < 0) indx += ALPHABET_SIZE;
-		decrypted[i] = plaintext_keyword_indices[indx];
-		if (beaufort) {
-			decrypted[i] = ALPHABET_SIZE - decrypted[i] - 1; // Atbash
+		if (! present) {
+			keyword[indx++] = i;
+		}
+	}
+
+	return ;
+}
+
+
+
+void random_cycleword(uint8_t cycleword[], int max, int keyword_len) {
+
+	for (int i = 0; i < keyword_len; i++) {
+		cycleword[i] = rand_int(0, max);
+	}
+
+	return ;
+}
+
+
+
+// Start a sampler with every letter outside the keyspace. The monogram frequencies are 
+// scaled to integers, so the trees never drift however many updates they see. 
+
+void keyword_sampler_init(keyword_sampler *sampler) {
+
+	int i;
+
+	sampler->in_keyspace = 0;
+	sampler->in_total = 0;
+	sampler->out_total = 0;
+
+	for (i = 0; i <= ALPHABET_SIZE; i++) {
+		sampler->in_tree[i] = 0;
+		sampler->out_tree[i] = 0;
+	}
+
+	for (i = 0; i < ALPHABET_SIZE; i++) {
+		sampler->weights[i] = max(1, (int) round(1.e6*english_monograms[i]));
+		sampler->positions[i] = INACTIVE;
+		fenwick_add(sampler->out_tree, i, sampler->weights[i]);
+		sampler->out_total += sampler->weights[i];
+	}
+
+	return ;
+}
+
+
+
+// Bring the sampler up to date with the keyspace of state. A keyword move changes 
+// the keyspace by at most one letter in and one out, and accepting or rejecting moves 
+// only copies states, so usually this is a single pass over the keyspace. 
+
+void keyword_sampler_sync(keyword_sampler *sampler, uint8_t state[], int keyword_len) {
+
+	int i, letter;
+	uint32_t in_keyspace = 0, changed;
+
+	for (i = 0; i < keyword_len; i++) {
+		in_keyspace |= 1u << state[i];
+		sampler->positions[state[i]] = i;
+	}
+
+	changed = in_keyspace ^ sampler->in_keyspace;
+
+	while (changed) {
+		letter = __builtin_ctz(changed);
+		changed &= changed - 1;
+		if (in_keyspace & (1u << letter)) {
+			fenwick_add(sampler->out_tree, letter, -sampler->weights[letter]);
+			fenwick_add(sampler->in_tree, letter, sampler->weights[letter]);
+			sampler->out_total -= sampler->weights[letter];
+			sampler->in_total += sampler->weights[letter];
+		} else {
+			fenwick_add(sampler->in_tree, letter, -sampler->weights[letter]);
+			fenwick_add(sampler->out_tree, letter, sampler->weights[letter]);
+			sampler->in_total -= sampler->weights[letter];
+			sampler->out_total += sampler->weights[letter];
+		}
+	}
+
+	sampler->in_keyspace = in_keyspace;
+
+	return ;
+}
+
+
+
+void fenwick_add(int tree[], int letter, int delta) {
+	for (int i = letter + 1; i <= ALPHABET_SIZE; i += i & -i) {
+		tree[i] += delta;
+	}
+	return ;
+}
+
+
+
+// The letter whose cumulative weight interval contains target, by descending the tree. 
+
+int fenwick_search(int tree[], int target) {
+
+	int i = 0, step;
+
+	for (step = 1; 2*step <= ALPHABET_SIZE; step *= 2) ;
+
+	for (; step > 0; step /= 2) {
+		if (i + step <= ALPHABET_SIZE && tree[i + step] <= target) {
+			i += step;
+			target -= tree[i];
+		}
+	}
+
+	return i;
+}
+
+
+
+// English monogram frequency-weighted pseudo-random selection of a position in the 
+// keyspace, or in the rest of the keyword, of a state synced with the sampler. The 
+// letters after the keyspace are in alphabetical order, so the position of a letter 
+// there is given by the number of smaller letters also outside the keyspace. 
+
+int rand_int_frequency_weighted(keyword_sampler *sampler, uint8_t state[], int keyword_len, bool in_keyspace) {
+
+	int letter;
+
+	if (in_keyspace) {
+		if (sampler->in_total == 0) {
+			return keyword_len - 1;
+		}
+		letter = fenwick_search(sampler->in_tree, rand_int(0, sampler->in_total));
+		return sampler->positions[letter];
+	}
+
+	if (sampler->out_total == 0) {
+		return ALPHABET_SIZE - 1;
+	}
+	letter = fenwick_search(sampler->out_tree, rand_int(0, sampler->out_total));
+
+	return keyword_len + __builtin_popcount(~sampler->in_keyspace & ((1u << letter) - 1));
+}
+
+
+
+// Load n-gram data from file into a table with the given backend. The log-scaled, 
+// normalised table is cached in binary form next to the text file (ngram_file + 
+// "." + backend name + NGRAM_CACHE_SUFFIX) the first time it is built, and later runs 
+// map the cache read-only instead of re-parsing. 
+
+void load_ngrams(ngram_table *table, char *ngram_file, int ngram_size, int backend, bool verbose) {
+
+	char cache_file[MAX_FILENAME_LEN + sizeof(NGRAM_CACHE_SUFFIX) + 16];
+	long long n_entries, *keys;
+	float *values;
+	struct stat source;
+
+	if (verbose) {
+		printf("\nLoading ngrams...");
+	}
+
+	sprintf(cache_file, "%s.%s%s", ngram_file, ngram_backend_names[backend], NGRAM_CACHE_SUFFIX);
+
+	if (stat(ngram_file, &source) == 0 && map_ngram_cache(table, cache_file, &source, ngram_size, backend)) {
+		select_ngram_score_kernel(table);
+		if (verbose) {
+			printf("...mapped '%s' (%s scoring).\n\n", cache_file, table->score_kernel_name);
+		}
+		return ;
+	}
+
+	n_entries = parse_ngrams(ngram_file, ngram_size, &keys, &values);
+
+	build_ngram_table(table, backend, ngram_size, keys, values, n_entries);
+	select_ngram_score_kernel(table);
+
+	if (stat(ngram_file, &source) == 0 && write_ngram_cache(cache_file, &source, table)) {
+		if (verbose) {
+			printf("...wrote '%s'", cache_file);
 		}
 	}
 
+	if (verbose) {
+		printf("...finished (%s scoring).\n\n", table->score_kernel_name);
+	}
+
 	return ;
 }
 
 
 
-// Given a ciphertext, keyword and cycleword (all in index form), compute the 
-// Quagmire 4 encryption. 
+// Parse, log-scale and normalise an n-gram frequency file. The observed n-grams are 
+// returned sorted by index (a repeated n-gram keeps its last frequency), and their 
+// scores are normalised by the total over all 26^n n-grams, unobserved ones scoring 
+// log(1 + 0) = 0. The sum runs in index order, so every backend sees the same scores. 
 
-void quagmire_encrypt(int encrypted[], int plaintext_indices[], int cipher_len, 
-	int plaintext_keyword_indices[], int ciphertext_keyword_indices[], 
-	int cycleword_indices[], int cycleword_len, bool beaufort) {
-	
-	int i, j, posn_keyword, posn_cycleword, indx, pt_indx, cw_indx;
+long long parse_ngrams(char *ngram_file, int ngram_size, long long **keys, float **values) {
 
-	for (i = 0; i < cipher_len; i++) {
+	FILE *fp;
+	int freq;
+	long long i, n_entries, n_lines, max_lines;
+	char ngram[64];
+	float total;
+	ngram_entry *entries;
 
-		// Find position of plaintext char in the plaintext keyword. 
-		for (j = 0; j < ALPHABET_SIZE; j++) {
-			pt_indx = plaintext_indices[i];
-			if (pt_indx == plaintext_keyword_indices[j]) {
-				posn_keyword = j;
-				break ;
-			}
-		}
+	// Read raw data from file. 
 
-		// Find the position of cycleword char in the ciphertext keyword. 
-		for (j = 0; j < ALPHABET_SIZE; j++) {
-			cw_indx = cycleword_indices[i%cycleword_len];
-			if (beaufort) {
-				cw_indx = ALPHABET_SIZE - cw_indx - 1; // Atbash
-			}
-			if (cw_indx == ciphertext_keyword_indices[j]) {
-				posn_cycleword = j; 
-				break ;
-			}
-		}
+	max_lines = 1024;
+	entries = malloc(max_lines*sizeof(ngram_entry));
+	n_lines = 0;
 
-		indx = (posn_keyword + posn_cycleword)%ALPHABET_SIZE;
-		if (indx < 0) indx += ALPHABET_SIZE;
-		encrypted[i] = ciphertext_keyword_indices[indx];
-		if (beaufort) {
-			encrypted[i] = ALPHABET_SIZE - encrypted[i] - 1; // Atbash
+	fp = fopen(ngram_file, "r");
+
+	while (fscanf(fp, "%63s\t%d", ngram, &freq) == 2) {
+		if ((int) strlen(ngram) < ngram_size) continue ;
+		if (n_lines == max_lines) {
+			max_lines *= 2;
+			entries = realloc(entries, max_lines*sizeof(ngram_entry));
 		}
+		entries[n_lines].key = ngram_index_str(ngram, ngram_size);
+		entries[n_lines].line = n_lines;
+		entries[n_lines].freq = freq;
+		n_lines++;
 	}
 
-	return ;
+	fclose(fp);
+
+	qsort(entries, n_lines, sizeof(ngram_entry), compare_ngram_entries);
+
+	// Log-scale. 
+
+	*keys = malloc(max(n_lines, 1)*sizeof(long long));
+	*values = malloc(max(n_lines, 1)*sizeof(float));
+
+	n_entries = 0;
+	for (i = 0; i < n_lines; i++) {
+		if (i + 1 < n_lines && entries[i + 1].key == entries[i].key) continue ;
+		(*keys)[n_entries] = entries[i].key;
+		(*values)[n_entries++] = log(1. + (float) entries[i].freq);
+	}
+
+	free(entries);
+
+	// Normalise. 
+
+	total = 0.;
+	for (i = 0; i < n_entries; i++) {
+		total += (*values)[i];
+	}
+
+	for (i = 0; i < n_entries; i++) {
+		(*values)[i] /= total;
+	}
+
+	return n_entries;
 }
 
 
 
-// perturbate a cycleword. 
+int compare_ngram_entries(const void *a, const void *b) {
 
-void perturbate_cycleword(int state[], int max, int len) {
+	const ngram_entry *x = a, *y = b;
 
-	int i; 
-	i = rand_int(0, len);
-	state[i] = rand_int(0, max);
+	if (x->key != y->key) {
+		return x->key < y->key ? -1 : 1;
+	}
+
+	return x->line < y->line ? -1 : (x->line > y->line);
 }
 
 
 
-// perturbate a key - Ref: http://www.mountainvistasoft.com/cryptoden/articles/Q3%20Keyspace.pdf
+// Build a table with the given backend from the sorted, observed n-grams, which are 
+// consumed. The quantised tables round each score to the nearest multiple of 
+// max score/65535 or max score/255. 
 
-void perturbate_keyword(int state[], int len, int keyword_len) {
+void build_ngram_table(ngram_table *table, int backend, int ngram_size, 
+	long long *keys, float *values, long long n_entries) {
 
-	int i, j, k, l, temp;
+	long long i, slot, n_ngrams = 1;
+	float max_value = 0.;
 
-	if (frand() < 0.2) {
-		// Once in 5, swap two letters within the keyspace.  
-#if KRYPTOS_PT_SCRAMBLE
-		i = rand_int(7, keyword_len);
-		j = rand_int(7, keyword_len);
-#else
-		i = rand_int(0, keyword_len);
-		j = rand_int(0, keyword_len);
-#endif
-		temp = state[i];
-		state[i] = state[j];
-		state[j] = temp;
-	} else {
-		// Four times in 5, swap a letter in the keyspace with 
-		// a letter outside and remake the letters following the 
-		// keyspace in normal order.
+	for (i = 0; i < ngram_size; i++) {
+		n_ngrams *= ALPHABET_SIZE;
+	}
 
-#if KRYPTOS_PT_SCRAMBLE
-		i = rand_int(7, len);	
-		j = rand_int(7, len);	
-#else
-#if FREQUENCY_WEIGHTED_SELECTION
-		i = rand_int_frequency_weighted(state, 0, keyword_len);
-		j = rand_int_frequency_weighted(state, keyword_len, len);
-#else
-		i = rand_int(0, keyword_len);
-		j = rand_int(keyword_len, len);
-#endif
-#endif
+	table->backend = backend;
+	table->ngram_size = ngram_size;
+	table->keys = NULL;
+	table->values = NULL;
+	table->values16 = NULL;
+	table->values8 = NULL;
+	table->scale = 1.;
+	table->max_value = 0.;
+	table->mapping = NULL;
+	table->mapping_len = 0;
+
+	for (i = 0; i < n_entries; i++) {
+		max_value = max(max_value, values[i]);
+	}
+	table->max_value = max_value;
 
-		// printf("\ni,j = %d,%d\n", i, j);
+	if (backend == NGRAM_SPARSE) {
 
-		temp = state[i];
-		state[i] = state[j];
+		// Open addressing with linear probing, at most half full. 
 
-		// Re-order - delete state[j]. 
+		table->n_entries = 2;
+		while (table->n_entries < 2*n_entries) table->n_entries *= 2;
 
-		for (k = j + 1; k < len; k++) {
-			state[k - 1] = state[k];
+		table->keys = malloc(table->n_entries*sizeof(long long));
+		table->values = malloc(table->n_entries*sizeof(float));
+		for (i = 0; i < table->n_entries; i++) {
+			table->keys[i] = INACTIVE;
+			table->values[i] = 0.;
 		}
-		
-		// Re-order - insert state[i]. 
-		for (k = keyword_len; k < len; k++) {
-			// Find insertion point. 
-			if (state[k] > temp || k == len - 1) {
-				// Shunt along. 
-				for (l = len - 1; l > k; l--) {
-					state[l] = state[l - 1];
-				}
-				// Insert. 
-				state[k] = temp;
-				break ;
-			}
+
+		for (i = 0; i < n_entries; i++) {
+			slot = ngram_hash(keys[i], table->n_entries);
+			while (table->keys[slot] != INACTIVE) slot = (slot + 1) & (table->n_entries - 1);
+			table->keys[slot] = keys[i];
+			table->values[slot] = values[i];
 		}
 
+		free(keys);
+		free(values);
+
+		return ;
 	}
 
+	table->n_entries = n_ngrams;
+
+	switch (backend) {
+		case NGRAM_FLOAT:
+			table->values = calloc(n_ngrams, sizeof(float));
+			for (i = 0; i < n_entries; i++) {
+				table->values[keys[i]] = values[i];
+			}
+			break ;
+		case NGRAM_UINT16:
+			table->scale = max_value > 0. ? max_value/UINT16_MAX : 1.;
+			table->max_value = table->scale*UINT16_MAX;
+			table->values16 = calloc(n_ngrams, sizeof(uint16_t));
+			for (i = 0; i < n_entries; i++) {
+				table->values16[keys[i]] = (uint16_t) lrintf(values[i]/table->scale);
+			}
+			break ;
+		case NGRAM_UINT8:
+			table->scale = max_value > 0. ? max_value/UINT8_MAX : 1.;
+			table->max_value = table->scale*UINT8_MAX;
+			table->values8 = calloc(n_ngrams, sizeof(uint8_t));
+			for (i = 0; i < n_entries; i++) {
+				table->values8[keys[i]] = (uint8_t) lrintf(values[i]/table->scale);
+			}
+			break ;
+	}
+
+	free(keys);
+	free(values);
+
 	return ;
 }
 
 
 
-// Random keyword initialisation routine. 
+// Score of the n-gram with the given index (see ngram_index_int). 
 
-void random_keyword(int keyword[], int len, int keyword_len) {
+float ngram_lookup(ngram_table *table, long long index) {
 
-	int i, j, candidate, indx, n_chars;
-	bool distinct, present;
+	long long slot;
 
-	// Get keyword_len distinct letters in [0 - ALPHABET_SIZE). 
+	switch (table->backend) {
+		case NGRAM_FLOAT:
+			return table->values[index];
+		case NGRAM_UINT16:
+			return table->scale*table->values16[index];
+		case NGRAM_UINT8:
+			return table->scale*table->values8[index];
+	}
 
-	n_chars = 0;
-	while (n_chars < keyword_len) {
+	// Sparse: probe from the hashed slot until the n-gram or an empty slot is found. 
 
-		distinct = true;
-		candidate = rand_int(0, ALPHABET_SIZE);
+	slot = ngram_hash(index, table->n_entries);
+	while (table->keys[slot] != index) {
+		if (table->keys[slot] == INACTIVE) return 0.;
+		slot = (slot + 1) & (table->n_entries - 1);
+	}
 
-		for (i = 0; i < n_chars; i++) {
-			if (keyword[i] == candidate) {
-				distinct = false;
-				break ;
-			}
-		}
+	return table->values[slot];
+}
 
-		if (distinct) {
-			keyword[n_chars++] = candidate;
-		}
-	}
 
-	// Pad out the rest of the chars. Eg. if we have "KRYPTOS", then here we 
-	// generate "ABCDEFGHIJLMNQUVWXZ" (in index form). 
 
-	indx = keyword_len;
-	for (i = 0; i < ALPHABET_SIZE; i++) {
+// Slot of an n-gram index in a sparse table with n_slots (a power of two) slots. 
 
-		present = false;
-		for (j = 0; j < keyword_len; j++) {
-			if (keyword[j] == i) {
-				present = true; 
-				break ;
-			}
-		}
+long long ngram_hash(long long index, long long n_slots) {
 
-		if (! present) {
-			keyword[indx++] = i;
-		}
+	return (long long) (((unsigned long long) index*0x9E3779B97F4A7C15ULL) >> 17) & (n_slots - 1);
+}
+
+
+
+// Bytes in the body of a table with the given backend and number of entries. 
+
+size_t ngram_table_size(int backend, long long n_entries) {
+
+	switch (backend) {
+		case NGRAM_FLOAT:
+			return n_entries*sizeof(float);
+		case NGRAM_UINT16:
+			return n_entries*sizeof(uint16_t);
+		case NGRAM_UINT8:
+			return n_entries*sizeof(uint8_t);
 	}
 
-	return ;
+	return n_entries*(sizeof(long long) + sizeof(float));
 }
 
 
 
-void random_cycleword(int cycleword[], int max, int keyword_len) {
+// Map a binary n-gram cache read-only. Fails (returning false) if the cache is missing, 
+// was built for a different n-gram size, alphabet, normalisation or backend, or is older 
+// than the text file it was built from. 
 
-	for (int i = 0; i < keyword_len; i++) {
-		cycleword[i] = rand_int(0, max);
+bool map_ngram_cache(ngram_table *table, char *cache_file, struct stat *source, int ngram_size, int backend) {
+
+	int fd;
+	size_t mapping_len;
+	struct stat cache;
+	void *mapping;
+	ngram_cache_header header;
+	char *body;
+
+	fd = open(cache_file, O_RDONLY);
+	if (fd < 0) {
+		return false;
 	}
 
-	return ;
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header) 
+		|| memcmp(header.magic, NGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0 
+		|| header.ngram_size != ngram_size 
+		|| header.alphabet_size != ALPHABET_SIZE 
+		|| header.normalisation != NGRAM_LOG_NORMALISED 
+		|| header.backend != backend 
+		|| header.source_size != (long long) source->st_size 
+		|| header.source_mtime != (long long) source->st_mtime) {
+		close(fd);
+		return false;
+	}
+
+	mapping_len = sizeof(ngram_cache_header) + ngram_table_size(backend, header.n_entries);
+
+	if (fstat(fd, &cache) != 0 || (size_t) cache.st_size != mapping_len) {
+		close(fd);
+		return false;
+	}
+
+	mapping = mmap(NULL, mapping_len, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+
+	body = (char *) mapping + sizeof(ngram_cache_header);
+
+	table->backend = backend;
+	table->ngram_size = ngram_size;
+	table->n_entries = header.n_entries;
+	table->scale = header.scale;
+	table->max_value = header.max_value;
+	table->keys = NULL;
+	table->values = NULL;
+	table->values16 = NULL;
+	table->values8 = NULL;
+
+	switch (backend) {
+		case NGRAM_FLOAT:
+			table->values = (float *) body;
+			break ;
+		case NGRAM_UINT16:
+			table->values16 = (uint16_t *) body;
+			break ;
+		case NGRAM_UINT8:
+			table->values8 = (uint8_t *) body;
+			break ;
+		case NGRAM_SPARSE:
+			table->keys = (long long *) body;
+			table->values = (float *) (table->keys + header.n_entries);
+			break ;
+	}
+
+	table->mapping = mapping;
+	table->mapping_len = mapping_len;
+
+	return true;
 }
 
 
 
-// English monogram frequency-weighted pseudo-random selection. 
+// Write a binary n-gram cache. The table is written to a temporary file and renamed into 
+// place, so that concurrent processes never map a partially written cache. 
 
-int rand_int_frequency_weighted(int state[], int min_index, int max_index) {
+bool write_ngram_cache(char *cache_file, struct stat *source, ngram_table *table) {
 
-	double total, rnd, cumsum;
+	char tmp_file[MAX_FILENAME_LEN + sizeof(NGRAM_CACHE_SUFFIX) + 48];
+	long long n = table->n_entries;
+	FILE *fp;
+	bool ok;
+	ngram_cache_header header;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NGRAM_CACHE_MAGIC, sizeof(header.magic));
+	header.ngram_size = table->ngram_size;
+	header.alphabet_size = ALPHABET_SIZE;
+	header.normalisation = NGRAM_LOG_NORMALISED;
+	header.backend = table->backend;
+	header.n_entries = n;
+	header.source_size = (long long) source->st_size;
+	header.source_mtime = (long long) source->st_mtime;
+	header.scale = table->scale;
+	header.max_value = table->max_value;
+
+	sprintf(tmp_file, "%s.%d.tmp", cache_file, (int) getpid());
+
+	fp = fopen(tmp_file, "wb");
+	if (fp == NULL) {
+		return false;
+	}
 
-	total = 0.;
-	for (int i = min_index; i < max_index; i++) {
-		total += english_monograms[state[i]];
+	ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	switch (table->backend) {
+		case NGRAM_FLOAT:
+			ok = ok && fwrite(table->values, sizeof(float), n, fp) == (size_t) n;
+			break ;
+		case NGRAM_UINT16:
+			ok = ok && fwrite(table->values16, sizeof(uint16_t), n, fp) == (size_t) n;
+			break ;
+		case NGRAM_UINT8:
+			ok = ok && fwrite(table->values8, sizeof(uint8_t), n, fp) == (size_t) n;
+			break ;
+		case NGRAM_SPARSE:
+			ok = ok && fwrite(table->keys, sizeof(long long), n, fp) == (size_t) n 
+				&& fwrite(table->values, sizeof(float), n, fp) == (size_t) n;
+			break ;
+	}
+	ok = (fclose(fp) == 0) && ok;
+
+	if (! ok || rename(tmp_file, cache_file) != 0) {
+		remove(tmp_file);
+		return false;
+	}
+
+	return true;
+}
+
+
+
+void free_ngrams(ngram_table *table) {
+
+	if (table->mapping != NULL) {
+		munmap(table->mapping, table->mapping_len);
+	} else {
+		free(table->keys);
+		free(table->values);
+		free(table->values16);
+		free(table->values8);
 	}
 
-	rnd = frand();
-	cumsum = 0.;
-	for (int i = min_index; i < max_index; i++) {
-		cumsum += english_monograms[state[i]]/total;
-		if (cumsum > rnd) {
+	return ;
+}
+
+
+
+// Index of a named n-gram table backend, or INACTIVE. 
+
+int ngram_backend(char *name) {
+
+	for (int i = 0; i < N_NGRAM_BACKENDS; i++) {
+		if (strcmp(name, ngram_backend_names[i]) == 0) {
 			return i;
 		}
 	}
 
-	return max_index - 1;
+	return INACTIVE;
+}
+
+
+
+// Returns the index of an n-gram. For example, the index of 'TH' would be 
+// 19 + 7*26 = 201, as 'T' and 'H' and the 19th and 7th letters of the alphabet 
+// respectively. 
+ 
+long long ngram_index_str(char *ngram, int ngram_size) {
+
+	int c;
+	long long index = 0, base = 1;
+
+	for (int i = 0; i < ngram_size; i++) {
+		c = toupper(ngram[i]) - 'A';
+		index += c*base;
+		base *= ALPHABET_SIZE;
+	}
+
+	return index;
+}
+
+long long ngram_index_int(uint8_t *ngram, int ngram_size) {
+
+	long long index = 0, base = 1;
+
+	for (int i = 0; i < ngram_size; i++) {
+		index += ngram[i]*base;
+		base *= ALPHABET_SIZE;
+	}
+
+	return index;
 }
 
 
 
-// Load n-gram data from file. 
+// Load dictionary. The words are inserted into a trie, and a breadth-first pass then 
+// adds the failure links, folding them into next[][] so that matching never backtracks. 
+// Words shorter than MIN_DICT_WORD_LEN, or containing anything but letters, are skipped. 
 
-float* load_ngrams(char *ngram_file, int ngram_size, bool verbose) {
+void load_dictionary(char *filename, dictionary *dict, bool verbose) {
 
 	FILE *fp;
-	int i, n_ngrams, freq, indx;
-	char ngram[MAX_NGRAM_SIZE];
-	float *ngram_data, total;
+	int i, len, node, child, letter, n_words, max_word_len, total_len, head, tail, *queue, *fail;
+	char word[MAX_DICT_WORD_LEN];
+	bool letters_p;
 
 	if (verbose) {
-		printf("\nLoading ngrams...");
+		printf("\nLoading dictionary...\n\n");
 	}
 
-	// Allocate memory for the ngram data.
+	// Count the words in the file, which bounds the number of trie nodes. 
+
+	fp = fopen(filename, "r");
+
+	n_words = 0;
+	max_word_len = 0;
+	total_len = 0;
+	while (fscanf(fp, "%29s", word) == 1) {
+		n_words++;
+		len = strlen(word);
+		total_len += len;
+		if (len > max_word_len) {
+			max_word_len = len;
+		}
+	}
 
-	n_ngrams = int_pow(ALPHABET_SIZE, ngram_size);
-	ngram_data = malloc(n_ngrams*sizeof(float));
+	if (verbose) {
+		printf("%d words in dictionary, ", n_words);
+		printf("longest word has %d chars.\n", max_word_len);
+	}
 
-	// Initialise. 
+	dict->next = malloc((total_len + 1)*sizeof(*dict->next));
+	dict->word_len = malloc((total_len + 1)*sizeof(int));
+	dict->match_link = malloc((total_len + 1)*sizeof(int));
+	dict->n_nodes = 1;
+	dict->n_words = 0;
+	dict->max_word_len = 0;
 
-	for (i = 0; i < n_ngrams; i++) {
-		ngram_data[i] = 0.;
+	for (letter = 0; letter < ALPHABET_SIZE; letter++) {
+		dict->next[0][letter] = 0;
 	}
+	dict->word_len[0] = 0;
+	dict->match_link[0] = 0;
 
-	// Read raw data from file. 
+	// Build the trie. 
 
-	fp = fopen(ngram_file, "r");
+	rewind(fp);
+
+	while (fscanf(fp, "%29s", word) == 1) {
+
+		len = strlen(word);
+		letters_p = len >= MIN_DICT_WORD_LEN;
+		for (i = 0; i < len && letters_p; i++) {
+			letters_p = isalpha((unsigned char) word[i]);
+		}
+		if (! letters_p) {
+			continue ;
+		}
+
+		node = 0;
+		for (i = 0; i < len; i++) {
+			letter = toupper((unsigned char) word[i]) - 'A';
+			if (dict->next[node][letter] == 0) {
+				child = dict->n_nodes++;
+				for (int k = 0; k < ALPHABET_SIZE; k++) {
+					dict->next[child][k] = 0;
+				}
+				dict->word_len[child] = 0;
+				dict->match_link[child] = 0;
+				dict->next[node][letter] = child;
+			}
+			node = dict->next[node][letter];
+		}
 
-	while(!feof (fp)) {
-		fscanf(fp, "%s\t%d", ngram, &freq);
-		indx = ngram_index_str(ngram, ngram_size);
-		ngram_data[indx] = freq;
+		if (dict->word_len[node] == 0) {
+			dict->word_len[node] = len;
+			dict->n_words++;
+			dict->max_word_len = max(dict->max_word_len, len);
+		}
 	}
 
 	fclose(fp);
 
-	// Log-scale.
+	// Breadth-first, so a node's failure link and edges are complete before its children 
+	// are visited. A missing edge goes where the failure link's edge goes. 
 
-	total = 0.;
-	for (i = 0; i < n_ngrams; i++) {
-		ngram_data[i] = log(1. + ngram_data[i]);
-		total += ngram_data[i];
+	queue = malloc(dict->n_nodes*sizeof(int));
+	fail = malloc(dict->n_nodes*sizeof(int));
+
+	head = 0;
+	tail = 0;
+	for (letter = 0; letter < ALPHABET_SIZE; letter++) {
+		child = dict->next[0][letter];
+		if (child != 0) {
+			fail[child] = 0;
+			queue[tail++] = child;
+		}
+	}
+
+	while (head < tail) {
+		node = queue[head++];
+		for (letter = 0; letter < ALPHABET_SIZE; letter++) {
+			child = dict->next[node][letter];
+			if (child != 0) {
+				fail[child] = dict->next[fail[node]][letter];
+				dict->match_link[child] = dict->word_len[fail[child]] > 0 ? fail[child] : dict->match_link[fail[child]];
+				queue[tail++] = child;
+			} else {
+				dict->next[node][letter] = dict->next[fail[node]][letter];
+			}
+		}
 	}
 
-	// Normalise.
+	free(fail);
+	free(queue);
 
-	for (i = 0; i < n_ngrams; i++) {
-		ngram_data[i] /= total;
-	}	
+	dict->next = realloc(dict->next, dict->n_nodes*sizeof(*dict->next));
+	dict->word_len = realloc(dict->word_len, dict->n_nodes*sizeof(int));
+	dict->match_link = realloc(dict->match_link, dict->n_nodes*sizeof(int));
 
 	if (verbose) {
-		printf("...finished.\n\n");
+		printf("%d words of at least %d letters, %d automaton states.\n", 
+			dict->n_words, MIN_DICT_WORD_LEN, dict->n_nodes);
+		printf("\n...finished.\n");
 	}
 
-	return ngram_data;
+	return ;
 }
 
 
 
-// Returns the index of an n-gram. For example, the index of 'TH' would be 
-// 19 + 7*26 = 201, as 'T' and 'H' and the 19th and 7th letters of the alphabet 
-// respectively. 
- 
-int ngram_index_str(char *ngram, int ngram_size) {
+// Deallocate dictionary. 
+
+void free_dictionary(dictionary *dict) {
+
+	free(dict->next);
+	free(dict->word_len);
+	free(dict->match_link);
+
+	return ;
+}
+
 
-	int c, index = 0, base = 1;
 
-	for (int i = 0; i < ngram_size; i++) {
-		c = toupper(ngram[i]) - 'A';
-		index += c*base;
-		base *= ALPHABET_SIZE;
+// Find dictionary words in plaintext, in one pass through the automaton. Every word 
+// ending at a position is on the match_link chain of the state reached there. With 
+// print_words, the words are printed in order of their starting position and then 
+// length. The number of them (counting each occurrence) is returned. 
+
+int find_dictionary_words(char *plaintext, dictionary *dict, bool print_words) {
+
+	int i, node, match, n_matches = 0, capacity = 0, plaintext_len = strlen(plaintext);
+	dictionary_match *matches = NULL;
+
+	// The matches are only kept (in a growing array) to be printed. 
+
+	node = 0;
+	for (i = 0; i < plaintext_len; i++) {
+		node = dict->next[node][plaintext[i] - 'A'];
+		match = dict->word_len[node] > 0 ? node : dict->match_link[node];
+		while (match != 0) {
+			if (print_words && n_matches == capacity) {
+				capacity = max(2*capacity, 256);
+				matches = realloc(matches, capacity*sizeof(dictionary_match));
+			}
+			if (print_words) {
+				matches[n_matches].start = i - dict->word_len[match] + 1;
+				matches[n_matches].len = dict->word_len[match];
+			}
+			n_matches++;
+			match = dict->match_link[match];
+		}
+	}
+
+	if (print_words) {
+		qsort(matches, n_matches, sizeof(dictionary_match), compare_dictionary_matches);
+		for (i = 0; i < n_matches; i++) {
+			printf("%.*s\n", matches[i].len, plaintext + matches[i].start);
+		}
 	}
 
-	return index;
+	free(matches);
+
+	return n_matches;
 }
 
-int ngram_index_int(int *ngram, int ngram_size) {
 
-	int index = 0, base = 1;
 
-	for (int i = 0; i < ngram_size; i++) {
-		index += ngram[i]*base;
-		base *= ALPHABET_SIZE;
+int compare_dictionary_matches(const void *a, const void *b) {
+
+	const dictionary_match *x = a, *y = b;
+
+	if (x->start != y->start) {
+		return x->start < y->start ? -1 : 1;
 	}
 
-	return index;
+	return x->len < y->len ? -1 : (x->len > y->len);
 }
 
 
 
-// Load dictionary. 
+// Build the keyed alphabets of a keyword list: the file source, one word per line, or 
+// if there is no such file, source itself as comma separated words (e.g. KRYPTOS,KOMITET). 
+// Words that are not all letters are skipped. Keyed alphabets are kept once for each 
+// keyword length, since different words can give the same one (ENIGMA and ENIGMAS, say). 
+// Returns false (having printed the error) if no word can be used. 
 
-void load_dictionary(char *filename, char ***dict, int *n_dict_words, int *max_dict_word_len, bool verbose) {
+bool load_keyword_index(char *source, keyword_index *index, bool verbose) {
 
-	FILE *fp;
-	int i, n_words, max_word_len;
-	char word[MAX_DICT_WORD_LEN];
+	int i, n, len, capacity = 1024, n_entries = 0;
+	char *word, *words = NULL, *save = NULL;
+	uint8_t (*entries)[ALPHABET_SIZE + 1];
+	FILE *fp = NULL;
 
-	if (verbose) {
-		printf("\nLoading dictionary...\n\n");
-	}
+	// Each entry is the keyword length followed by its keyed alphabet, so sorting the 
+	// entries as bytes groups them by length. 
 
-	// Count the number of words in the file. 
+	entries = malloc(capacity*sizeof(*entries));
 
-	fp = fopen(filename, "r");
+	if (file_exists(source)) {
+		fp = fopen(source, "r");
+		word = read_word(fp);
+	} else {
+		words = strdup(source);
+		word = strtok_r(words, ",", &save);
+	}
 
-	n_words = 0;
-	max_word_len = 0;
-	while(!feof (fp)) {
-		fscanf(fp, "%s\n", word);
-		n_words++;
-		if (strlen(word) > max_word_len) {
-			max_word_len = strlen(word);
+	while (word != NULL && *word != '\0') {
+		len = keyed_alphabet(word, &entries[n_entries][1]);
+		if (len > 0) {
+			entries[n_entries][0] = len;
+			if (++n_entries == capacity) {
+				capacity *= 2;
+				entries = realloc(entries, capacity*sizeof(*entries));
+			}
+		}
+		if (fp != NULL) {
+			free(word);
+			word = read_word(fp);
+		} else {
+			word = strtok_r(NULL, ",", &save);
 		}
 	}
 
-	*max_dict_word_len = max_word_len;
-	*n_dict_words = n_words;
-
-	fclose(fp);
+	if (fp != NULL) {
+		free(word);
+		fclose(fp);
+	}
+	free(words);
 
-	if (verbose) {
-		printf("%d words in dictionary, ", n_words);
-		printf("longest word has %d chars.\n", max_word_len);
+	if (n_entries == 0) {
+		printf("\n\nERROR: no keywords in '%s'.\n\n", source);
+		free(entries);
+		return false;
 	}
 
-	// Allocate memory for array of words. 
+	qsort(entries, n_entries, sizeof(*entries), compare_keyed_alphabets);
 
-	*dict = malloc(n_words*sizeof(char*));
-	for (i = 0; i < n_words; i++) {
-		(*dict)[i] = malloc((max_word_len + 1)*sizeof(char));
+	index->alphabets = malloc(n_entries*sizeof(*index->alphabets));
+	index->n_alphabets = 0;
+	for (len = 0; len <= MAX_KEYWORD_LEN + 1; len++) {
+		index->offsets[len] = 0;
 	}
 
-	// Fill array with words from dictionary. 
+	for (i = 0; i < n_entries; i++) {
+		if (i > 0 && compare_keyed_alphabets(entries[i], entries[i - 1]) == 0) {
+			continue ;
+		}
+		memcpy(index->alphabets[index->n_alphabets++], &entries[i][1], ALPHABET_SIZE);
+		index->offsets[entries[i][0] + 1] = index->n_alphabets;
+	}
 
-	fp = fopen(filename, "r");
+	// Lengths without keywords start where the previous length ends. 
 
-	i = 0; 
-	while(!feof (fp)) {
-		fscanf(fp, "%s\n", word);
-		strcpy((*dict)[i], word);
-		i++; 
+	for (len = 1; len <= MAX_KEYWORD_LEN + 1; len++) {
+		index->offsets[len] = max(index->offsets[len], index->offsets[len - 1]);
 	}
 
-	fclose(fp);
+	free(entries);
 
 	if (verbose) {
-		printf("\n...finished.\n");
+		printf("\n%d keyed alphabets from %s, by keyword length:\n\n", index->n_alphabets, source);
+		for (len = 1; len <= MAX_KEYWORD_LEN; len++) {
+			n = index->offsets[len + 1] - index->offsets[len];
+			if (n > 0) {
+				printf("%d\t%d\n", len, n);
+			}
+		}
+		printf("\n");
 	}
+
+	return true;
 }
 
 
 
-// Deallocate dictionary. 
+void free_keyword_index(keyword_index *index) {
 
-void free_dictionary(char **dict, int n_dict_words) {
+	free(index->alphabets);
 
-	for (int i = 0; i < n_dict_words; i++) {
-		free(dict[i]);
-	}
-	free(dict);
+	return ;
 }
 
 
 
-// Find dictionary words in plaintext. 
+// The keyed alphabet of a word (its distinct letters in order, then the rest of the 
+// alphabet in order), returning the keyword length, the number of distinct letters, or 0 
+// if the word is not all letters. 
 
-int find_dictionary_words(char *plaintext, char **dict, int n_dict_words, int max_dict_word_len) {
+int keyed_alphabet(char *word, uint8_t alphabet[]) {
 
-	int n_matches = 0, plaintext_len, min_word_len;
-	char fragment[MAX_DICT_WORD_LEN], *dict_word;
+	int i, letter, keyword_len = 0, indx;
+	bool present[ALPHABET_SIZE] = {false};
 
-	// printf("\nn_dict_words, max_dict_word_len = %d, %d\n", n_dict_words, max_dict_word_len);
-
-	plaintext_len = strlen(plaintext);
-	min_word_len = 3;
-
-	for (int i = 0; i < plaintext_len - min_word_len; i++) {
-		for (int word_len = min_word_len; word_len < min(max_dict_word_len, plaintext_len - i); word_len++) {
+	for (i = 0; word[i] != '\0'; i++) {
+		if (! isalpha((unsigned char) word[i])) {
+			return 0;
+		}
+		letter = toupper((unsigned char) word[i]) - 'A';
+		if (! present[letter]) {
+			present[letter] = true;
+			alphabet[keyword_len++] = letter;
+		}
+	}
 
-			//  fragment = plaintext[i : i + word_len]
+	indx = keyword_len;
+	for (letter = 0; letter < ALPHABET_SIZE; letter++) {
+		if (! present[letter]) {
+			alphabet[indx++] = letter;
+		}
+	}
 
-			for (int j = 0; j < word_len; j++) {
-				fragment[j] = plaintext[i + j];
-			}
-			fragment[word_len] = '\0'; 
+	return keyword_len;
+}
 
-			// Check if fragment is in dictionary. 
 
-			for (int k = 0; k < n_dict_words; k++) {
-				dict_word = dict[k];
-				if (strlen(dict_word) > word_len) {
-					continue ;
-				} else if (strlen(dict_word) < word_len) {
-					break ;
-				} else if (strcmp(dict_word, fragment) == 0 ) {
-					printf("%s\n", fragment);
-					n_matches++;
-					break ;
-				}
-			}
 
-		}
-	}
+int compare_keyed_alphabets(const void *a, const void *b) {
 
-	return n_matches;
+	return memcmp(a, b, ALPHABET_SIZE + 1);
 }
 
 
 // Estimate the cycleword length from the ciphertext. 
 
 void estimate_cycleword_lengths(
-	int text[], 
+	uint8_t text[], 
 	int len, 
 	int max_cycleword_len, 
 	double n_sigma_threshold,
 	double ioc_threshold,
+	bool period_tests, 
 	int *n_cycleword_lengths, 
 	int cycleword_lengths[], 
 	bool verbose) {
 
-	int i, j, caesar_column[MAX_CIPHER_LENGTH]; 
-	double mu, std, max_ioc, current_ioc, 
-		mu_ioc[MAX_CYCLEWORD_LEN], mu_ioc_normalised[MAX_CYCLEWORD_LEN], word_len_norm_ioc[MAX_CYCLEWORD_LEN];
+	int i, j, n;
+	double max_ioc, current_ioc, 
+		mu_ioc[MAX_PERIOD], mu_ioc_normalised[MAX_PERIOD], word_len_norm_ioc[MAX_PERIOD], 
+		kappas[MAX_PERIOD], kappas_normalised[MAX_PERIOD], 
+		factors[MAX_PERIOD], factors_normalised[MAX_PERIOD], scores[MAX_PERIOD];
 	bool threshold;
 
+	// Every column needs at least two letters for its IoC. 
+
+	max_cycleword_len = min(max_cycleword_len, len/2);
+
 	// Compute the mean IOC for each candidate cycleword length. 
 
-	for (i = 1; i <= max_cycleword_len; i++) {
-		mu_ioc[i - 1] = mean_ioc(text, len, i, caesar_column);
-	}
+	periodic_ioc(text, len, max_cycleword_len, mu_ioc);
 
 	// Normalise (Z-score). 
 
-	mu = vec_mean(mu_ioc, max_cycleword_len);
-	std = vec_stddev(mu_ioc, max_cycleword_len);
+	z_scores(mu_ioc, max_cycleword_len, mu_ioc_normalised);
 
 	if (verbose) {
-		printf("\ncycleword mu,std = %.3f, %.6f\n", mu, std);
+		printf("\ncycleword mu,std = %.3f, %.6f\n", 
+			vec_mean(mu_ioc, max_cycleword_len), vec_stddev(mu_ioc, max_cycleword_len));
 	}
 
+	// Optionally, combine the IoC with the autocorrelation at each lag and the Kasiski 
+	// factor counts. The Z-scores are summed and rescaled to unit variance, so 
+	// n_sigma_threshold keeps its meaning. A test that is the same at every length (no 
+	// repeated trigrams for Kasiski, say) has no Z-scores, and is left out. 
+
 	for (i = 0; i < max_cycleword_len; i++) {
-		mu_ioc_normalised[i] = (mu_ioc[i] - mu)/std;
+		scores[i] = mu_ioc_normalised[i];
+	}
+
+	if (period_tests) {
+		periodic_autocorrelation(text, len, max_cycleword_len, kappas);
+		kasiski_factors(text, len, max_cycleword_len, factors);
+		n = 1;
+		n += z_scores(kappas, max_cycleword_len, kappas_normalised);
+		n += z_scores(factors, max_cycleword_len, factors_normalised);
+		for (i = 0; i < max_cycleword_len; i++) {
+			scores[i] = (mu_ioc_normalised[i] + kappas_normalised[i] + factors_normalised[i])/sqrt(n);
+		}
 	}
 
-	// Select only those above n_sigma_threshold and sort by mean IOC. 
+	// Select only those above n_sigma_threshold and sort by score. 
 
 	// TODO: the sorting by max IOC makes this code ugly - rewrite! 
 
@@ -2309,9 +6676,9 @@ void estimate_cycleword_lengths(
 		threshold = false;
 		max_ioc = 0.;
 		for (j = 0; j < max_cycleword_len; j++) {
-			if (mu_ioc_normalised[j] > n_sigma_threshold && mu_ioc[j] > ioc_threshold && mu_ioc_normalised[j] > max_ioc && mu_ioc_normalised[j] < current_ioc) {
+			if (scores[j] > n_sigma_threshold && mu_ioc[j] > ioc_threshold && scores[j] > max_ioc && scores[j] < current_ioc) {
 				threshold = true;
-				max_ioc = mu_ioc_normalised[j];
+				max_ioc = scores[j];
 				cycleword_lengths[i] = j + 1;
 			}
 		}
@@ -2333,22 +6700,35 @@ void estimate_cycleword_lengths(
 
 	// Normalise (Z-score). 
 
-	mu = vec_mean(word_len_norm_ioc, max_cycleword_len);
-	std = vec_stddev(word_len_norm_ioc, max_cycleword_len);
-
-	for (i = 0; i < max_cycleword_len; i++) {
-		word_len_norm_ioc[i] = (word_len_norm_ioc[i] - mu)/std;
-	}
+	z_scores(word_len_norm_ioc, max_cycleword_len, word_len_norm_ioc);
 
 	if (verbose) {
-		printf("\nlen\tmean IOC\n");
-		for (i = 0; i < max_cycleword_len; i++) {
-			if (verbose) {
+		if (period_tests) {
+			printf("\nFriedman estimate = %.2f\n", friedman_period(text, len));
+			printf("\nlen\tmean IOC\tkappa\tKasiski\tscore\n");
+			for (i = 0; i < max_cycleword_len; i++) {
+				printf("%d\t%.4f\t\t%.4f\t%.3f\t%.3f\n", i + 1, mu_ioc[i], kappas[i], factors[i], scores[i]);
+			}
+		} else {
+			printf("\nlen\tmean IOC\n");
+			for (i = 0; i < max_cycleword_len; i++) {
 				printf("%d\t%.4f\n", i + 1, mu_ioc[i]);
 			}
 		}
 	}
 
+	// The hill climber is limited to cycleword lengths of MAX_CYCLEWORD_LEN. 
+
+	n = 0;
+	for (i = 0; i < *n_cycleword_lengths; i++) {
+		if (cycleword_lengths[i] <= MAX_CYCLEWORD_LEN) {
+			cycleword_lengths[n++] = cycleword_lengths[i];
+		} else if (verbose) {
+			printf("\nSkipping cycleword length %d (longer than %d)\n", cycleword_lengths[i], MAX_CYCLEWORD_LEN);
+		}
+	}
+	*n_cycleword_lengths = n;
+
 	if (verbose) {
 		printf("\ncycleword_lengths =\t");
 		for (i = 0; i < *n_cycleword_lengths; i++) {
@@ -2362,25 +6742,130 @@ void estimate_cycleword_lengths(
 
 
 
-// Given the cycleword length, compute the mean IOC. 
+// The mean IoC of the columns of the text for each period from 1 to max_period. The 
+// columns are tallied in place with a strided walk, rather than copied out first. 
 
-double mean_ioc(int text[], int len, int len_cycleword, int *caesar_column) {
+void periodic_ioc(uint8_t text[], int len, int max_period, double mean_iocs[]) {
 
-	int i, k;
-	double weighted_ioc = 0.;
+	int i, k, p, column_len, frequencies[ALPHABET_SIZE];
+	double weighted_ioc;
 
-	for (k = 0; k < len_cycleword; k++) {
+	for (p = 1; p <= max_period; p++) {
 
-		i = 0;
-		while (len_cycleword*i + k < len) {
-			caesar_column[i] = text[len_cycleword*i + k];
-			i++;
+		weighted_ioc = 0.;
+
+		for (k = 0; k < p; k++) {
+
+			for (i = 0; i < ALPHABET_SIZE; i++) {
+				frequencies[i] = 0;
+			}
+
+			column_len = 0;
+			for (i = k; i < len; i += p) {
+				frequencies[text[i]]++;
+				column_len++;
+			}
+
+			weighted_ioc += ioc_from_tally(frequencies, column_len);
+		}
+
+		mean_iocs[p - 1] = weighted_ioc/p;
+	}
+
+	return ;
+}
+
+
+
+// The fraction of positions where the text agrees with itself shifted by each lag from 
+// 1 to max_period. Periodic ciphers agree more often at multiples of the period. 
+
+void periodic_autocorrelation(uint8_t text[], int len, int max_period, double kappas[]) {
+
+	int i, d, coincidences;
+
+	for (d = 1; d <= max_period; d++) {
+		coincidences = 0;
+		for (i = 0; i < len - d; i++) {
+			coincidences += text[i] == text[i + d];
+		}
+		kappas[d - 1] = (double) coincidences/(len - d);
+	}
+
+	return ;
+}
+
+
+
+// Kasiski examination. The distances between successive repeats of each trigram are 
+// collected, and for each period we count the distances it divides, scaled so that a 
+// random text scores 1 for every period. 
+
+void kasiski_factors(uint8_t text[], int len, int max_period, double factors[]) {
+
+	int i, p, d, trigram, n_distances = 0, *last_seen, 
+		n_trigrams = ALPHABET_SIZE*ALPHABET_SIZE*ALPHABET_SIZE;
+
+	last_seen = malloc(n_trigrams*sizeof(int));
+
+	for (p = 0; p < max_period; p++) {
+		factors[p] = 0.;
+	}
+
+	for (i = 0; i < n_trigrams; i++) {
+		last_seen[i] = INACTIVE;
+	}
+
+	for (i = 0; i + 2 < len; i++) {
+		trigram = (text[i]*ALPHABET_SIZE + text[i + 1])*ALPHABET_SIZE + text[i + 2];
+		if (last_seen[trigram] != INACTIVE) {
+			d = i - last_seen[trigram];
+			for (p = 1; p <= min(d, max_period); p++) {
+				if (d%p == 0) {
+					factors[p - 1] += 1.;
+				}
+			}
+			n_distances++;
 		}
+		last_seen[trigram] = i;
+	}
+
+	for (p = 1; p <= max_period && n_distances > 0; p++) {
+		factors[p - 1] *= (double) p/n_distances;
+	}
+
+	free(last_seen);
+
+	return ;
+}
+
+
+
+// Friedman's estimate of the period from the IoC of the whole text, taking the IoC of 
+// English as MEAN_ENGLISH_IOC/26 and of random text as 1/26. 
+
+double friedman_period(uint8_t text[], int len) {
+
+	double kappa_plaintext = MEAN_ENGLISH_IOC/ALPHABET_SIZE, kappa_random = 1./ALPHABET_SIZE, 
+		kappa_text = index_of_coincidence(text, len);
+
+	return (kappa_plaintext - kappa_random)*len/((len - 1)*kappa_text - kappa_random*len + kappa_plaintext);
+}
+
+
+
+// Z-scores of a vector (scores may alias vec). A constant vector has Z-scores of zero, 
+// and false is returned. 
 
-		weighted_ioc += index_of_coincidence(caesar_column, i);
+bool z_scores(double vec[], int len, double scores[]) {
+
+	double mu = vec_mean(vec, len), std = vec_stddev(vec, len);
+
+	for (int i = 0; i < len; i++) {
+		scores[i] = std > 0. ? (vec[i] - mu)/std : 0.;
 	}
 
-	return weighted_ioc/len_cycleword;
+	return std > 0.;
 }
 
 
@@ -2414,7 +6899,7 @@ double vec_stddev(double vec[], int len) {
 }
 
 
-void vec_print(int vec[], int len) {
+void vec_print(uint8_t vec[], int len) {
 	for (int i = 0; i < len; i++) {
 		printf("%d ", vec[i]);
 	}
@@ -2424,7 +6909,7 @@ void vec_print(int vec[], int len) {
 
 // Print plaintext from indices. 
 
-void print_text(int indices[], int len) {
+void print_text(uint8_t indices[], int len) {
 
 	for (int i = 0; i < len; i++) {
 		printf("%c", indices[i] + 'A');
@@ -2436,9 +6921,11 @@ void print_text(int indices[], int len) {
 
 // Compute the index of each char. A -> 0, B -> 1, ..., Z -> 25
 
-void ord(char *text, int indices[]) {
+void ord(char *text, uint8_t indices[]) {
+
+	int len = strlen(text);
 
-	for (int i = 0; i < strlen(text); i++) {
+	for (int i = 0; i < len; i++) {
 		indices[i] = toupper(text[i]) - 'A';
 	}
 
@@ -2447,9 +6934,25 @@ void ord(char *text, int indices[]) {
 
 
 
+// The upper case string of a text of indices, to be freed by the caller. 
+
+char *text_string(uint8_t indices[], int len) {
+
+	char *text = malloc(len + 1);
+
+	for (int i = 0; i < len; i++) {
+		text[i] = indices[i] + 'A';
+	}
+	text[len] = '\0';
+
+	return text;
+}
+
+
+
 // Count the frequencies of char in plaintext. 
 
-void tally(int plaintext[], int len, int frequencies[], int n_frequencies) {
+void tally(uint8_t plaintext[], int len, int frequencies[], int n_frequencies) {
 
 	int i;
 
@@ -2470,19 +6973,27 @@ void tally(int plaintext[], int len, int frequencies[], int n_frequencies) {
 
 // Friedman's Index of Coincidence. 
 
-float index_of_coincidence(int plaintext[], int len) {
+float index_of_coincidence(uint8_t plaintext[], int len) {
 
-	int i, frequencies[ALPHABET_SIZE];
-	double ioc = 0.;
+	int frequencies[ALPHABET_SIZE];
 
 	// Compute plaintext char frequencies. 
 	tally(plaintext, len, frequencies, ALPHABET_SIZE);
 
-	for (i = 0; i < ALPHABET_SIZE; i++) {
-        ioc += frequencies[i]*(frequencies[i] - 1);
+	return ioc_from_tally(frequencies, len);
+}
+
+
+
+float ioc_from_tally(int frequencies[], int len) {
+
+	double ioc = 0.;
+
+	for (int i = 0; i < ALPHABET_SIZE; i++) {
+        ioc += (double) frequencies[i]*(frequencies[i] - 1);
     }
 
-    ioc /= len*(len - 1);
+    ioc /= (double) len*(len - 1);
     return ioc;
 }
 
@@ -2490,7 +7001,7 @@ float index_of_coincidence(int plaintext[], int len) {
 
 // Straight alphabet - ABCDEFGHIJKLMNOPQRSTUVWXYZ
 
-void straight_alphabet(int keyword[], int len) {
+void straight_alphabet(uint8_t keyword[], int len) {
 	for (int i = 0; i < len; i++) {
 		keyword[i] = i;
 	}
@@ -2512,6 +7023,154 @@ bool file_exists(const char *filename) {
 
 
 
+// Serialises console output from concurrent workers. 
+
+pthread_mutex_t print_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+// Per-thread random number generator state, xoshiro256** (Blackman and Vigna, 
+// https://prng.di.unimi.it/). Each worker is handed its own stream by split_rand, so 
+// a run is reproducible from its seed and the workers never share generator state. 
+
+_Thread_local rand_stream rand_state = {{1, 2, 3, 4}};
+
+// Seed the calling thread's generator, expanding the seed with splitmix64. 
+
+void seed_rand(uint64_t seed) {
+
+	uint64_t z;
+
+	for (int i = 0; i < 4; i++) {
+		z = (seed += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+		rand_state.s[i] = z ^ (z >> 31);
+	}
+
+	return ;
+}
+
+
+
+// A seed for runs without -seed. Mixing in the nanosecond clock and the process id 
+// keeps jobs started in the same second apart. 
+
+uint64_t default_seed() {
+
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	return ((uint64_t) ts.tv_sec*1000000000ULL + ts.tv_nsec) ^ ((uint64_t) getpid() << 32);
+}
+
+
+
+// Hand the calling thread's current stream to a worker, then jump past it, so that 
+// successive workers get non-overlapping subsequences of 2^128 draws. 
+
+void split_rand(rand_stream *stream) {
+	*stream = rand_state;
+	jump_rand(&rand_state);
+	return ;
+}
+
+
+
+// As split_rand, but leave room for the MAX_THREADS streams the worker will split 
+// from its own. Used for the length sweep's job threads, whose restart workers would 
+// otherwise reuse the next job thread's draws. 
+
+void split_rand_jobs(rand_stream *stream) {
+
+	int i;
+
+	*stream = rand_state;
+	for (i = 0; i < MAX_THREADS; i++) {
+		jump_rand(&rand_state);
+	}
+
+	return ;
+}
+
+
+
+// Advance a stream by 2^128 draws. 
+
+void jump_rand(rand_stream *stream) {
+
+	static const uint64_t jump[4] = {0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 
+		0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL};
+
+	apply_rand_jump(stream, jump);
+
+	return ;
+}
+
+
+
+// Advance a stream by 2^192 draws, past everything a sweep splits from it. 
+
+void long_jump_rand(rand_stream *stream) {
+
+	static const uint64_t jump[4] = {0x76E15D3EFEFDCBBFULL, 0xC5004E441C522FB3ULL, 
+		0x77710069854EE241ULL, 0x39109BB02ACBE635ULL};
+
+	apply_rand_jump(stream, jump);
+
+	return ;
+}
+
+
+
+// Advance a stream by the jump polynomial jump (see the xoshiro256** reference code). 
+
+void apply_rand_jump(rand_stream *stream, const uint64_t jump[4]) {
+
+	uint64_t t[4] = {0, 0, 0, 0}, r;
+	int i, j, k;
+
+	for (i = 0; i < 4; i++) {
+		for (j = 0; j < 64; j++) {
+			if (jump[i] & (1ULL << j)) {
+				for (k = 0; k < 4; k++) t[k] ^= stream->s[k];
+			}
+			// One step of the generator. 
+			r = stream->s[1] << 17;
+			stream->s[2] ^= stream->s[0];
+			stream->s[3] ^= stream->s[1];
+			stream->s[1] ^= stream->s[2];
+			stream->s[0] ^= stream->s[3];
+			stream->s[2] ^= r;
+			stream->s[3] = (stream->s[3] << 45) | (stream->s[3] >> 19);
+		}
+	}
+
+	for (k = 0; k < 4; k++) stream->s[k] = t[k];
+
+	return ;
+}
+
+
+
+uint64_t rand_u64() {
+
+	uint64_t *s = rand_state.s, result = s[1]*5, t = s[1] << 17;
+
+	result = ((result << 7) | (result >> 57))*9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = (s[3] << 45) | (s[3] >> 19);
+
+	return result;
+}
+
+
+
 // Shuffle array -- ref: https://stackoverflow.com/questions/6127503/shuffle-array-in-c
 
 void shuffle(int *array, size_t n) 
@@ -2521,7 +7180,7 @@ void shuffle(int *array, size_t n)
         size_t i;
         for (i = 0; i < n - 1; i++) 
         {
-          size_t j = i + rand() / (RAND_MAX / (n - i) + 1);
+          size_t j = rand_int(i, n);
           int t = array[j];
           array[j] = array[i];
           array[i] = t;
@@ -2531,7 +7190,7 @@ void shuffle(int *array, size_t n)
 
 
 
-void vec_copy(int src[], int dest[], int len) {
+void vec_copy(uint8_t src[], uint8_t dest[], int len) {
 	for (int i = 0; i < len; i++) dest[i] = src[i]; 
 }
 
@@ -2552,14 +7211,38 @@ int int_pow(int base, int exp)
 
 
 
-// Returns a random int in [min, max). 
+// Returns a random int in [min, max), without modulo bias, by Lemire's multiply-shift 
+// method (https://arxiv.org/abs/1805.10941). 
 
 int rand_int(int min, int max) {
-   return min + rand() % (max - min); // result in [min, max)
+
+	uint32_t range = (uint32_t) (max - min), threshold;
+	uint64_t m = (rand_u64() >> 32)*range;
+
+	if ((uint32_t) m < range) {
+		threshold = -range % range;
+		while ((uint32_t) m < threshold) {
+			m = (rand_u64() >> 32)*range;
+		}
+	}
+
+	return min + (int) (m >> 32); // result in [min, max)
 }
 
 
+
+// Returns a random double in [0, 1) from the top 53 bits of a draw. 
+
 double frand() {
-  return ((double) rand())/((double) RAND_MAX); // result in [0, 1]
+	return (rand_u64() >> 11)*0x1.0p-53; // result in [0, 1)
 }
 
+
+
+// Wall-clock time in seconds (clock() measures CPU time summed over all threads). 
+
+double wall_clock() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1.e-9*ts.tv_nsec;
+}
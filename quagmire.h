@@ -6,20 +6,29 @@
 #include <ctype.h> 
 #include <string.h>
 #include <math.h>
+#include <limits.h>
 #include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#define KRYPTOS 0
-#define CRIB_CHECK 1
+#include "libquagmire.h"
 
-#define KRYPTOS_PT_SCRAMBLE 0
+// Vectorised n-gram scoring kernels, selected at run time (see select_ngram_score_kernel). 
 
-#define KRYPTOS_PT 0
-#define KOMITET_PT 0
-#define SOLUBLE_PT 0
+#if defined(__x86_64__) && defined(__GNUC__)
+#define NGRAM_SIMD 1
+#include <immintrin.h>
+#else
+#define NGRAM_SIMD 0
+#endif
 
-#define KRYPTOS_CT 0
-#define KOMITET_CT 0
-#define SOLUBLE_CT 0
+#define KRYPTOS 0
+#define CRIB_CHECK 1
 
 #define VIGENERE 0
 #define QUAGMIRE_1 1
@@ -30,11 +39,84 @@
 
 #define ALPHABET_SIZE 26
 #define MAX_CIPHER_LENGTH 10000
+#define MAX_TEXT_LENGTH 16777216
 #define MAX_FILENAME_LEN 100
 #define MAX_KEYWORD_LEN 30
 #define MAX_CYCLEWORD_LEN 30
+#define MAX_PERIOD 1000
+#define CACHE_LINE_SIZE 64
 #define MAX_NGRAM_SIZE 8
+#define NGRAM_CACHE_SUFFIX ".bin"
+#define NGRAM_CACHE_MAGIC "QNGRAM03"
+#define CHECKPOINT_MAGIC "QCHKPT03"
+#define CHECKPOINT_INTERVAL 60.
+#define NGRAM_LOG_NORMALISED 1
+#define MAX_DENSE_NGRAM_SIZE 6
+
+// n-gram table backends (see ngram_lookup). 
+
+#define NGRAM_FLOAT 0
+#define NGRAM_UINT16 1
+#define NGRAM_UINT8 2
+#define NGRAM_SPARSE 3
+#define N_NGRAM_BACKENDS 4
+
+// Search engines (see search_engine): the slippery hill climber, simulated annealing and 
+// parallel tempering. Annealing cools from START_TEMPERATURE to END_TEMPERATURE over each 
+// restart, and tempering spreads its replicas' temperatures over the same range. 
+
+#define ENGINE_HILL 0
+#define ENGINE_ANNEAL 1
+#define ENGINE_TEMPERING 2
+#define N_ENGINES 3
+#define START_TEMPERATURE 0.01
+#define END_TEMPERATURE 0.0002
+#define SWAP_INTERVAL 100
+
+// Keyword searches (see keyword_search): restarts from random keywords, from keyed 
+// alphabets of a keyword list, or through every keyed alphabet of the list with the 
+// keyword fixed and only the cycleword climbed. 
+
+#define KEYWORD_RANDOM 0
+#define KEYWORD_SEED 1
+#define KEYWORD_EXHAUSTIVE 2
+#define N_KEYWORD_SEARCHES 3
+
+// Phases of a hill climbing move timed by -stats, the move types and outcomes it counts, 
+// and the number of moves between timed ones (prime, so that the timed moves do not fall 
+// on the same step of every -batch or -swapinterval cycle). 
+
+#define STATS_RESTART 0
+#define STATS_PERTURB 1
+#define STATS_CONSTRAIN 2
+#define STATS_SCORE_INCREMENTAL 3
+#define STATS_SCORE_FULL 4
+#define STATS_SCORE_BATCH 5
+#define STATS_ACCEPT 6
+#define N_STATS_PHASES 7
+#define MOVE_KEYWORD 0
+#define MOVE_CYCLEWORD 1
+#define MOVE_BATCH 2
+#define N_MOVE_TYPES 3
+#define MOVE_IMPROVED 0
+#define MOVE_SLIPPED 1
+#define MOVE_REJECTED 2
+#define N_MOVE_OUTCOMES 3
+#define STATS_SAMPLE_INTERVAL 61
+
+#define PROGRESS_QUEUE_SIZE 256
+#define PROGRESS_INTERVAL 0.25
+
 #define MAX_DICT_WORD_LEN 30
+#define MIN_DICT_WORD_LEN 3
+#define MAX_THREADS 256
+#define MAX_BATCH 16
+#define MAX_TOP_K 32
+#define EARLY_ABORT_INTERVAL 64
+#define MIN_SPECIALISED_NGRAM_SIZE 3
+#define MAX_SPECIALISED_NGRAM_SIZE 6
+#define BENCHMARK_STATES 64
+#define INCREMENTAL_WINDOW_FRACTION 4
 
 #define FREQUENCY_WEIGHTED_SELECTION 1
 
@@ -42,132 +124,750 @@
 
 #define INACTIVE -9999
 
+// Centres of the IoC and entropy terms of the score, and the score of the example K4-length 
+// cipher under the default weights, which the score is divided by. 
+
+#define MEAN_ENGLISH_IOC 1.742
+#define MEAN_ENGLISH_ENTROPY 2.85
+#define SCORE_NORMALISATION 3.41
+
 #define min(a,b) (((a) < (b)) ? (a) : (b))
 
 #define max(a,b) (((a) > (b)) ? (a) : (b))
 
 
-// English word length frequencies. (Ref: https://math.wvu.edu/~hdiamond/Math222F17/Sigurd_et_al-2004-Studia_Linguistica.pdf)
-
-int n_english_word_length_frequency_letters = 25;
-double english_word_length_frequencies[] = {
-	0.0316, 0.16975, 0.21192, 0.15678, 0.10852, 0.08524, 0.07724, 
-	0.05623, 0.04032, 0.02766, 0.01582, 0.00917, 0.00483, 0.00262, 
-	0.00099, 0.0005, 0.00027, 0.00022, 0.00011, 0.00006, 0.00005, 
-	0.00002, 0.00001, 0.00001, 0.00001};
-
-
-
-// Ref: http://practicalcryptography.com/cryptanalysis/letter-frequencies-various-languages/english-letter-frequencies/
-double english_monograms[] = {
-	0.085517, // A
-	0.016048, // B
-	0.031644, // C
-	0.038712, // D
-	0.120965, // E
-	0.021815, // F
-	0.020863, // G
-	0.049557, // H
-	0.073251, // I
-	0.002198, // J
-	0.008087, // K
-	0.042065, // L
-	0.025263, // M
-	0.071722, // N
-	0.074673, // O
-	0.020662, // P
-	0.001040, // Q
-	0.063327, // R
-	0.067282, // S
-	0.089381, // T
-	0.026816, // U
-	0.010593, // V
-	0.018254, // W
-	0.001914, // X
-	0.017214, // Y
-	0.001138  // Z
+// English word length and letter frequencies, and the names of the n-gram table types, 
+// search engines and -stats fields (defined in quagmire.c). 
+
+extern int n_english_word_length_frequency_letters;
+extern char *ngram_backend_names[N_NGRAM_BACKENDS], *engine_names[N_ENGINES], 
+	*keyword_search_names[N_KEYWORD_SEARCHES], 
+	*stats_phase_names[N_STATS_PHASES], *move_type_names[N_MOVE_TYPES], 
+	*move_outcome_names[N_MOVE_OUTCOMES];
+extern double english_word_length_frequencies[], english_monograms[ALPHABET_SIZE];
+
+
+
+// Decryption lookup tables for a given state: the inverse of the input keyword (the 
+// ciphertext keyword, or the plaintext keyword for variants), two copies of the output 
+// keyword, and the offset into the latter for each column of the cycleword. straight_input 
+// is set if the input keyword is the straight alphabet, so its inverse is the identity. 
+
+typedef struct {
+	int input_inverse[ALPHABET_SIZE], ciphertext_keyword_inverse[ALPHABET_SIZE], 
+		output_alphabet[2*ALPHABET_SIZE], shifts[MAX_CYCLEWORD_LEN];
+	bool variant, beaufort, straight_input;
+} cipher_tables;
+
+// A hill climber state. Letters are stored as indices 0-25 in bytes, and the struct is 
+// cache-line aligned, so that states are copied by plain assignment. 
+
+typedef struct {
+	_Alignas(CACHE_LINE_SIZE) uint8_t plaintext_keyword[ALPHABET_SIZE], ciphertext_keyword[ALPHABET_SIZE], 
+		cycleword[MAX_CYCLEWORD_LEN];
+} quagmire_state;
+
+// A solution kept in a solution_heap, with the hash of its plaintext (see 
+// plaintext_hash) and its cycleword length. 
+
+typedef struct {
+	quagmire_state state;
+	double score;
+	uint64_t hash;
+	int cycleword_len;
+} solution;
+
+// The (up to) capacity best distinct solutions found, as a min-heap on score, so the 
+// worst of them is solutions[0]. Solutions with the same plaintext are kept once (see 
+// solution_heap_insert). 
+
+typedef struct {
+	int n_solutions, capacity;
+	solution solutions[MAX_TOP_K];
+} solution_heap;
+
+// English monogram frequency-weighted choice of the letters swapped by perturbate_keyword. 
+// The integer weights of the letters inside and outside the keyspace are held in two 
+// Fenwick trees over the alphabet, so a draw is O(log 26). The trees track the keyspace 
+// letters of the last state synced with, and only letters that have since moved in or 
+// out of the keyspace are updated (see keyword_sampler_sync). 
+
+typedef struct {
+	uint32_t in_keyspace;
+	int weights[ALPHABET_SIZE], in_tree[ALPHABET_SIZE + 1], out_tree[ALPHABET_SIZE + 1], 
+		in_total, out_total, positions[ALPHABET_SIZE];
+} keyword_sampler;
+
+// State of a xoshiro256** random number generator (see rand_u64). 
+
+typedef struct {
+	uint64_t s[4];
+} rand_stream;
+
+// A (cycleword, plaintext keyword, ciphertext keyword) length combination to be searched, 
+// and the best solutions found for it. n_restarts_done counts its completed restarts 
+// (including those of a resumed checkpoint). While it runs, score, the keywords and top 
+// are its best so far, guarded by the sweep's checkpoint_lock. converged is set once 
+// the adaptive controller has confirmed its result (see update_convergence). 
+
+typedef struct {
+	int cycleword_len, plaintext_keyword_len, ciphertext_keyword_len, n_restarts_run, n_restarts_done;
+	double score;
+	bool dropped, converged;
+	uint8_t plaintext_keyword[ALPHABET_SIZE], ciphertext_keyword[ALPHABET_SIZE], cycleword[MAX_CYCLEWORD_LEN];
+	solution_heap top;
+} length_triple;
+
+typedef struct length_sweep length_sweep;
+
+// Checkpoint of a length sweep (see write_checkpoint): a header, then a record for each 
+// length triple. The hash covers the ciphertext, the cribs, the cipher type and variant, 
+// and stream is the generator state the resumed sweep's streams are split from. 
+
+typedef struct {
+	char magic[8];
+	uint64_t hash;
+	int n_triples;
+	rand_stream stream;
+} checkpoint_header;
+
+typedef struct {
+	int cycleword_len, plaintext_keyword_len, ciphertext_keyword_len, n_restarts_done;
+	double score;
+	bool dropped, converged;
+	uint8_t plaintext_keyword[ALPHABET_SIZE], ciphertext_keyword[ALPHABET_SIZE], 
+		cycleword[MAX_CYCLEWORD_LEN];
+	solution_heap top;
+} checkpoint_triple;
+
+// Header of a precompiled binary n-gram table (see load_ngrams). The table follows it 
+// directly, so it is padded to keep it aligned. The size and modification time of the 
+// text file it was built from are recorded so that stale tables are rebuilt. 
+
+typedef struct {
+	char magic[8];
+	int ngram_size, alphabet_size, normalisation, backend;
+	long long n_entries, source_size, source_mtime;
+	float scale, max_value;
+	char padding[8];
+} ngram_cache_header;
+
+// A line of an n-gram frequency file (see parse_ngrams). 
+
+typedef struct {
+	long long key, line;
+	int freq;
+} ngram_entry;
+
+// Dictionary words of at least MIN_DICT_WORD_LEN letters as an Aho-Corasick automaton 
+// (see load_dictionary). Node 0 is the root, next[node][letter] is the complete 
+// transition function (trie edges, with the failure links folded in), word_len[node] is 
+// the length of the word ending at node (0 if none), and match_link[node] is the 
+// nearest proper suffix of node that ends a word (0 if none). 
+
+typedef struct {
+	int n_words, n_nodes, max_word_len;
+	int (*next)[ALPHABET_SIZE], *word_len, *match_link;
+} dictionary;
+
+// The keyed alphabets of a keyword list (see load_keyword_index), grouped by keyword 
+// length, the number of distinct letters (KOMITET -> KOMITE, 6) as for the hill climber. 
+// The alphabets of keyword length len are alphabets[offsets[len]] to 
+// alphabets[offsets[len + 1] - 1], each kept once. 
+
+typedef struct {
+	int n_alphabets, offsets[MAX_KEYWORD_LEN + 2];
+	uint8_t (*alphabets)[ALPHABET_SIZE];
+} keyword_index;
+
+// A dictionary word found in a plaintext (see find_dictionary_words). 
+
+typedef struct {
+	int start, len;
+} dictionary_match;
+
+// Loaded n-gram scores, either built from the text file (mapping == NULL) or mapped 
+// read-only from its binary cache, shared through the page cache by concurrent processes. 
+// The backends are 
+// 	NGRAM_FLOAT - dense table of n_entries = 26^n floats, values[]. 
+// 	NGRAM_UINT16, NGRAM_UINT8 - dense tables of quantised scores, values16[] or values8[], 
+// 		where the score is scale*value. 
+// 	NGRAM_SPARSE - the observed n-grams only, in a hash table of n_entries slots 
+// 		(keys[] and values[], empty slots have key INACTIVE). Unobserved n-grams 
+// 		score zero, as in the dense tables. 
+// max_value is the largest score any lookup returns. score_kernel is the fastest 
+// ngram_score implementation for the backend and CPU, fused_kernels the fused_decrypt 
+// implementations for a keyed and a straight input keyword, and window_scale = 26^n 
+// normalises the mean window score. 
+
+struct ngram_table;
+
+typedef double (*fused_decrypt_kernel)(cipher_tables *tables, uint8_t cipher_indices[], int cipher_len, 
+	int cycleword_len, int crib_positions[], uint8_t crib_indices[], int n_cribs, 
+	struct ngram_table *ngram_data, int ngram_size, uint8_t decrypted[], float windows[], int counts[], 
+	int *n_crib_matches, double ngram_bound);
+
+typedef struct ngram_table {
+	int backend, ngram_size;
+	long long n_entries, *keys;
+	float *values, scale, max_value;
+	uint16_t *values16;
+	uint8_t *values8;
+	void *mapping;
+	size_t mapping_len;
+	double window_scale;
+	double (*score_kernel)(uint8_t decrypted[], int cipher_len, struct ngram_table *ngram_data, int ngram_size);
+	char *score_kernel_name;
+	fused_decrypt_kernel fused_kernels[2];
+} ngram_table;
+
+// Hot path counters of a hill climbing worker (see -stats). Every phase entered is 
+// counted, but only one move in STATS_SAMPLE_INTERVAL is timed. proposed counts the moves 
+// generated by type, moves their outcomes (with -batch the keyword and cycleword moves are 
+// only proposed, and the outcome is that of the batch), and contradictions the moves the 
+// crib constraints could not be satisfied after. 
+
+typedef struct {
+	long phase_calls[N_STATS_PHASES], phase_samples[N_STATS_PHASES];
+	double phase_time[N_STATS_PHASES];
+	long proposed[N_MOVE_TYPES], moves[N_MOVE_TYPES][N_MOVE_OUTCOMES], contradictions[N_MOVE_TYPES];
+	long n_moves, n_restarts, n_backtracks;
+} climber_stats;
+
+// The -stats totals of a run, which each worker adds its counters to as it finishes. 
+
+typedef struct {
+	pthread_mutex_t lock;
+	climber_stats totals;
+	int n_ciphers, n_workers;
+	double start_time;
+} stats_report;
+
+// A new shared best, as published by a hill climbing worker for the progress reporter. 
+// The ciphertext and the name point into the cipher's job, which the reporter is flushed 
+// before the job is done with (see progress_reporter_flush). 
+
+typedef struct {
+	char *name;
+	uint8_t *cipher_indices;
+	int cipher_len, cycleword_len, plaintext_keyword_len, ciphertext_keyword_len, n_restart, n_iteration;
+	bool variant, beaufort;
+	long n_iterations, n_backtracks, n_explore, n_contradictions;
+	double elapsed, score;
+	quagmire_state state;
+} progress_snapshot;
+
+typedef struct {
+	atomic_size_t sequence;
+	progress_snapshot snapshot;
+} progress_slot;
+
+// Asynchronous progress reporter. Workers push snapshots onto a bounded lock-free queue 
+// (dropping them if it is full) and the reporter thread decrypts and prints them, the 
+// console at most once every PROGRESS_INTERVAL seconds with the latest snapshot, and the 
+// -results file (if records is not NULL) as one NDJSON record per snapshot. head is 
+// only touched by the reporter thread. 
+
+typedef struct {
+	progress_slot slots[PROGRESS_QUEUE_SIZE];
+	atomic_size_t tail;
+	size_t head;
+	atomic_long n_pushed, n_done, n_dropped;
+	atomic_bool pending, stop;
+	atomic_int n_flushing;
+	bool console;
+	FILE *records;
+	double last_print;
+	pthread_t thread;
+} progress_reporter;
+
+// Problem description and best state shared by the hill climbing workers. Everything 
+// above 'lock' is read-only once the workers start. The best_* fields, the top_k best 
+// distinct restart results in top and the tempering ladder are guarded by 'lock', and the 
+// counters are totals over all completed restarts. With parallel tempering each worker is 
+// a replica: replica_slot[w] is the rung of the temperature ladder worker w is at, 
+// slot_replica the inverse, and replica_score the score each last published. The 
+// adaptive controller (see update_convergence) tracks the best restart result, how many 
+// independent restarts have reached it and how many restarts have passed since it last 
+// improved. n_borrowed counts the restarts borrowed from the sweep's spare pool. With 
+// -solution, solution_indices is the known plaintext and *solved_time is set to the 
+// wall_clock time it is first reached (0 until then), which ends the search. With 
+// -keywordsearch, keywords is the keyword list the restarts start from (see 
+// initial_keyword). 
+
+typedef struct {
+	uint8_t *cipher_indices, *crib_indices;
+	int cipher_type, cipher_len, *crib_positions, n_cribs, 
+		cycleword_len, plaintext_keyword_len, ciphertext_keyword_len, n_hill_climbs, n_restarts, 
+		n_batch, ngram_size, top_k, engine, swap_interval, n_confirm, n_stall, keyword_search;
+	ngram_table *ngram_data;
+	keyword_index *keywords;
+	float weight_ngram, weight_crib, weight_ioc, weight_entropy;
+	double backtracking_probability, keyword_permutation_probability, slip_probability, start_time, 
+		start_temperature, end_temperature, target_score, deadline;
+	bool variant, beaufort, early_abort, verbose;
+	length_sweep *sweep;
+	length_triple *triple;
+	stats_report *stats;
+	uint8_t *solution_indices;
+	_Atomic double *solved_time;
+	progress_reporter *reporter;
+	char *name;
+
+	pthread_mutex_t lock;
+	double best_score;
+	quagmire_state best_state;
+	solution_heap top;
+	int n_replicas, replica_slot[MAX_THREADS], slot_replica[MAX_THREADS];
+	double slot_temperature[MAX_THREADS], replica_score[MAX_THREADS];
+	long n_swaps, n_swap_attempts;
+	uint64_t confirmed_hash;
+	double confirmed_score;
+	int n_confirmations, n_stalled;
+
+	atomic_int next_restart, n_borrowed;
+	atomic_bool dropped, converged;
+	atomic_long n_iterations, n_backtracks, n_explore, n_contradictions;
+} climber_shared;
+
+typedef struct {
+	climber_shared *shared;
+	int id;
+	rand_stream stream;
+} climber_worker;
+
+// Work-stealing pool of length triples. Each job thread owns a deque of indices into 
+// triples, and the leading score over all triples is maintained lock-free. The progress 
+// of the triples is written to checkpoint_file (if not NULL) every checkpoint_interval 
+// seconds. spare_restarts pools the unused restarts of triples the adaptive controller 
+// has stopped early, for the triples still running (see claim_restart). 
+
+typedef struct {
+	pthread_mutex_t lock;
+	int *jobs, head, tail;
+} job_deque;
+
+struct length_sweep {
+	climber_shared *climber_template;
+	length_triple *triples;
+	int n_triples, n_deques, n_threads;
+	job_deque deques[MAX_THREADS];
+	double drop_threshold;
+	_Atomic double leader_score;
+	atomic_int spare_restarts;
+	pthread_mutex_t checkpoint_lock;
+	char *checkpoint_file;
+	double checkpoint_interval, last_checkpoint;
+	rand_stream stream;
+};
+
+typedef struct {
+	length_sweep *sweep;
+	int id;
+	rand_stream stream;
+} sweep_worker;
+
+extern pthread_mutex_t print_lock;
+extern _Thread_local rand_stream rand_state;
+extern double count_log_count[MAX_CIPHER_LENGTH + 1];
+
+// The hill climbing score of a plaintext, as a function of its n-gram total, crib matches 
+// and letter tallies, with the term weights and all the normalisations folded into one 
+// coefficient per term (see score_terms_setup and score_from_terms). 
+
+typedef struct {
+	double ngram_coefficient, crib_coefficient, ioc_coefficient, entropy_coefficient, 
+		ioc_scale, inverse_len, log_len;
+} score_terms;
+
+// Decryption and score terms of a hill climber's current state, with the positions and 
+// letters a move changes and an undo log for the pending move (see score_cache_apply). 
+// Several hundred kilobytes, so allocated on the heap. 
+
+typedef struct {
+	uint8_t *cipher_indices, *crib_indices;
+	int cipher_len, cycleword_len, ngram_size, n_windows, n_cribs, *crib_positions;
+	ngram_table *ngram_data;
+	score_terms terms;
+	bool variant, beaufort, tables_pending, full_pending;
+	cipher_tables table_store[2], *tables, *proposed_tables;
+
+	int column_letter_offsets[MAX_CYCLEWORD_LEN][ALPHABET_SIZE + 1], column_letter_positions[MAX_CIPHER_LENGTH], 
+		column_letters[MAX_CYCLEWORD_LEN][ALPHABET_SIZE], n_column_letters[MAX_CYCLEWORD_LEN];
+
+	uint8_t decrypted[MAX_CIPHER_LENGTH];
+	int crib_letters[MAX_CIPHER_LENGTH], counts[ALPHABET_SIZE], n_crib_matches;
+	float windows[MAX_CIPHER_LENGTH];
+	double ngram_total;
+
+	int move_positions[MAX_CIPHER_LENGTH];
+	uint8_t move_letters[MAX_CIPHER_LENGTH];
+
+	uint8_t undo_letters[MAX_CIPHER_LENGTH];
+	int n_undo_letters, undo_positions[MAX_CIPHER_LENGTH], 
+		n_undo_windows, undo_window_indices[MAX_CIPHER_LENGTH], 
+		window_stamps[MAX_CIPHER_LENGTH], position_stamps[MAX_CIPHER_LENGTH], 
+		stamp, undo_column, undo_shift, undo_n_crib_matches;
+	float undo_windows[MAX_CIPHER_LENGTH];
+	double undo_ngram_total;
+} score_cache;
+
+// A batch of candidate moves from the same current state, scored together (see 
+// score_candidate_batch). The plaintexts are stored position-major, plaintext[p][k] 
+// being letter p of candidate k. 
+
+typedef struct {
+	int n_candidates;
+	quagmire_state states[MAX_BATCH];
+	cipher_tables tables[MAX_BATCH];
+	uint8_t plaintext[MAX_CIPHER_LENGTH][MAX_BATCH];
+	int counts[MAX_BATCH][ALPHABET_SIZE], n_crib_matches[MAX_BATCH];
+	double ngram_totals[MAX_BATCH], scores[MAX_BATCH];
+} candidate_batch;
+
+// The cribs grouped by cycleword column, as distinct (ciphertext letter, crib letter) 
+// pairs with the pairs of columns[i] at offsets[i] to offsets[i + 1], and the cycleword 
+// letters forced by the last pair of keywords (see crib_engine_constrain). 
+
+typedef struct {
+	int cycleword_len, n_columns, columns[MAX_CYCLEWORD_LEN], offsets[MAX_CYCLEWORD_LEN + 1];
+	uint8_t ciphertext_letters[MAX_CIPHER_LENGTH], crib_letters[MAX_CIPHER_LENGTH];
+	bool variant, valid, contradiction;
+	uint8_t plaintext_keyword[ALPHABET_SIZE], ciphertext_keyword[ALPHABET_SIZE], 
+		forced[MAX_CYCLEWORD_LEN];
+	int n_forced;
+} crib_engine;
+
+// The options that may differ between the ciphers of a run. They are set on the command 
+// line and may be overridden for each cipher of a manifest (see parse_cipher_option). 
+// crib holds the crib file name or, in a manifest, possibly the crib text itself, and 
+// solution likewise the known plaintext (see read_known_solution). 
+
+typedef struct {
+	int cipher_type, cycleword_len, max_cycleword_len, plaintext_keyword_len, ciphertext_keyword_len, 
+		plaintext_max_keyword_len, ciphertext_max_keyword_len, min_keyword_len;
+	bool variant, crib_present, cycleword_len_present, plaintext_keyword_len_present, 
+		ciphertext_keyword_len_present, solution_present;
+	char crib[MAX_CIPHER_LENGTH], solution[MAX_CIPHER_LENGTH];
+} cipher_options;
+
+// The settings and models shared by every cipher of a run. dict is NULL without a 
+// dictionary, keywords is NULL without a keyword list, checkpoint_file is NULL without checkpointing, stats is NULL without 
+// -stats, and reporter is NULL without -verbose or -results. 
+
+typedef struct {
+	int ngram_size, n_hill_climbs, n_restarts, n_batch, n_threads, n_jobs, top_k, engine, swap_interval, 
+		n_confirm, n_stall, search_length, keyword_search;
+	double n_sigma_threshold, ioc_threshold, backtracking_probability, keyword_permutation_probability, 
+		slip_probability, drop_threshold, start_temperature, end_temperature, target_score, time_budget;
+	float weight_ngram, weight_crib, weight_ioc, weight_entropy;
+	bool early_abort, period_tests, verbose, resume;
+	char *checkpoint_file;
+	double checkpoint_interval;
+	ngram_table *ngram_data;
+	dictionary *dict;
+	keyword_index *keywords;
+	stats_report *stats;
+	progress_reporter *reporter;
+} solver_settings;
+
+// A cipher to solve (see load_cipher_job) and the best solution found (see solve_cipher). 
+// The ciphertext, crib, best plaintext and known solution arrays are allocated for the 
+// length of the ciphertext, up to MAX_TEXT_LENGTH, and freed by free_cipher_job. With 
+// -solution, solved_time is the wall_clock time the known plaintext was first reached 
+// (in the search window, see -searchlength), or 0. 
+
+typedef struct {
+	cipher_options options;
+	char name[MAX_FILENAME_LEN];
+	int cipher_len, n_cribs, *crib_positions, best_cycleword_len, n_words_found;
+	uint8_t *cipher_indices, *crib_indices, *best_decrypted, best_plaintext_keyword[ALPHABET_SIZE], 
+		best_ciphertext_keyword[ALPHABET_SIZE], best_cycleword[MAX_CYCLEWORD_LEN];
+	double best_score;
+	solution_heap top;
+	uint8_t *solution_indices;
+	_Atomic double solved_time;
+} cipher_job;
+
+// A manifest of ciphers, one per line, read by n_workers threads which each solve one 
+// cipher at a time (see run_manifest). The reader's lock guards the file, the line count 
+// and the random stream that each cipher's stream is split from. 
+
+typedef struct {
+	FILE *fp;
+	cipher_options *defaults;
+	solver_settings *settings;
+	pthread_mutex_t lock;
+	int n_lines;
+	rand_stream stream;
+	atomic_int n_solved, n_failed;
+} manifest_reader;
+
+// The models of the library interface (see libquagmire.h), read-only once loaded. 
+
+struct quagmire_context {
+	ngram_table ngrams;
+	dictionary dict;
+	keyword_index keywords;
+	bool dictionary_present, keywords_present, verbose;
 };
 
 
 
+void default_cipher_options(cipher_options *options);
+int parse_cipher_option(cipher_options *options, int argc, char **argv, int i, bool echo);
+bool check_cipher_options(cipher_options *options);
+void default_solver_settings(solver_settings *settings);
+int parse_solver_option(solver_settings *settings, int argc, char **argv, int i, bool echo);
+bool check_solver_settings(solver_settings *settings);
+void quagmire_context_settings(quagmire_context *context, solver_settings *settings);
+bool load_cipher_job(cipher_job *job, char *cipher_source, cipher_options *options, 
+	bool literal_p, bool verbose);
+void free_cipher_job(cipher_job *job);
+char *read_word(FILE *fp);
+bool read_known_solution(cipher_job *job, char *solution_source, bool literal_p);
+double confirm_score(cipher_job *job, solver_settings *settings, uint8_t decrypted[], 
+	uint8_t plaintext_keyword[], uint8_t ciphertext_keyword[], uint8_t cycleword[], int cycleword_len);
+void job_decrypt(cipher_job *job, uint8_t decrypted[], uint8_t plaintext_keyword[], 
+	uint8_t ciphertext_keyword[], uint8_t cycleword[], int cycleword_len);
+char *text_string(uint8_t indices[], int len);
+bool solve_cipher(cipher_job *job, solver_settings *settings);
+void print_summary_line(cipher_job *job);
+void run_benchmarks(cipher_job *job, solver_settings *settings, int n_calls);
+void report_benchmark(char *name, int n_calls, double elapsed, double checksum);
+void run_manifest(manifest_reader *reader, int n_workers);
+void *manifest_worker(void *arg);
+bool read_manifest_line(manifest_reader *reader, char **line, int *n_line, rand_stream *stream);
+
 double quagmire_shotgun_hill_climber(
 	int cipher_type, 
-	int cipher_indices[], int cipher_len, 
-	int crib_indices[], int crib_positions[], int n_cribs,
+	uint8_t cipher_indices[], int cipher_len, 
+	uint8_t crib_indices[], int crib_positions[], int n_cribs,
 	int cycleword_len, int plaintext_keyword_len, int ciphertext_keyword_len, 
-	int n_hill_climbs, int n_restarts,
-	float *ngram_data, int ngram_size,
-	int decrypted[MAX_CIPHER_LENGTH], int plaintext_keyword[ALPHABET_SIZE], 
-	int ciphertext_keyword[ALPHABET_SIZE], int cycleword[ALPHABET_SIZE],
+	int n_hill_climbs, int n_restarts, int n_batch, 
+	ngram_table *ngram_data, int ngram_size,
+	uint8_t decrypted[MAX_CIPHER_LENGTH], uint8_t plaintext_keyword[ALPHABET_SIZE], 
+	uint8_t ciphertext_keyword[ALPHABET_SIZE], uint8_t cycleword[ALPHABET_SIZE],
 	double backtracking_probability, double keyword_permutation_probability, double slip_probability,
 	float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy,
-	bool variant, bool beaufort, bool verbose);
+	bool variant, bool beaufort, bool early_abort, int n_threads, bool verbose);
 
-bool cribs_satisfied_p(int cipher_indices[], int cipher_len, int crib_indices[], 
+void climber_setup(climber_shared *shared, 
+	int cipher_type, 
+	uint8_t cipher_indices[], int cipher_len, 
+	uint8_t crib_indices[], int crib_positions[], int n_cribs,
+	int cycleword_len, int plaintext_keyword_len, int ciphertext_keyword_len, 
+	int n_hill_climbs, int n_restarts, int n_batch, 
+	ngram_table *ngram_data, int ngram_size,
+	double backtracking_probability, double keyword_permutation_probability, double slip_probability,
+	float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy, 
+	bool variant, bool beaufort, bool early_abort, bool verbose);
+
+double run_hill_climber(climber_shared *shared, int n_threads, 
+	uint8_t decrypted[MAX_CIPHER_LENGTH], uint8_t plaintext_keyword[ALPHABET_SIZE], 
+	uint8_t ciphertext_keyword[ALPHABET_SIZE], uint8_t cycleword[ALPHABET_SIZE]);
+
+void *quagmire_hill_climber_worker(void *arg);
+int search_engine(char *name);
+int keyword_search(char *name);
+int n_keyword_restarts(climber_shared *shared);
+void initial_keyword(climber_shared *shared, uint8_t keyword[], int keyword_len, int n);
+int claim_restart(climber_shared *shared, double known_best_score);
+void check_known_solution(climber_shared *shared, quagmire_state *state, uint8_t decrypted[]);
+void update_convergence(climber_shared *shared, uint64_t hash, double score, bool independent);
+void tempering_setup(climber_shared *shared, int n_replicas);
+double tempering_swap(climber_shared *shared, int replica, double score);
+double metropolis_threshold(double score, double temperature);
+void stats_phase(climber_stats *stats, int phase, bool sampled, double *t);
+void stats_report_init(stats_report *report);
+void stats_report_merge(stats_report *report, climber_stats *stats);
+bool write_stats_report(stats_report *report, char *stats_file, solver_settings *settings);
+
+void run_length_sweep(climber_shared *climber_template, length_triple triples[], int n_triples, 
+	int n_jobs, int n_threads, double drop_threshold, char *checkpoint_file, double checkpoint_interval);
+void record_restart(climber_shared *shared);
+void solution_heap_init(solution_heap *heap, int capacity);
+bool solution_heap_insert(solution_heap *heap, quagmire_state *state, double score, uint64_t hash, 
+	int cycleword_len);
+void solution_heap_merge(solution_heap *heap, solution_heap *from);
+void solution_heap_sort(solution_heap *heap, solution sorted[]);
+uint64_t plaintext_hash(uint8_t plaintext[], int len);
+void print_top_solutions(cipher_job *job);
+uint64_t checkpoint_hash(climber_shared *climber_template);
+bool write_checkpoint(length_sweep *sweep);
+bool read_checkpoint(char *checkpoint_file, climber_shared *climber_template, 
+	length_triple triples[], int n_triples);
+int next_length_triple(length_sweep *sweep, int id);
+void *length_sweep_worker(void *arg);
+void update_sweep_leader(length_sweep *sweep, double score);
+bool drop_length_triple_p(climber_shared *shared, int n_restart);
+
+void report_climber_progress(climber_shared *shared, int n_restart, int n_iteration, 
+	int n_iterations, int n_backtracks, int n_explore, int n_contradictions);
+void progress_reporter_start(progress_reporter *reporter, bool console, FILE *records);
+void progress_reporter_flush(progress_reporter *reporter);
+void progress_reporter_stop(progress_reporter *reporter);
+void close_reporter(progress_reporter *reporter, FILE *results_fp);
+bool progress_push(progress_reporter *reporter, progress_snapshot *snapshot);
+bool progress_pop(progress_reporter *reporter, progress_snapshot *snapshot);
+void *progress_reporter_thread(void *arg);
+void snapshot_decrypt(progress_snapshot *snapshot, uint8_t decrypted[]);
+void print_progress_snapshot(progress_snapshot *snapshot, uint8_t decrypted[]);
+void write_progress_record(FILE *fp, progress_snapshot *snapshot, uint8_t decrypted[]);
+void write_result_record(FILE *fp, cipher_job *job);
+void report_result(solver_settings *settings, cipher_job *job);
+void fprint_json_string(FILE *fp, char *s);
+void fprint_json_text(FILE *fp, uint8_t text[], int len);
+
+bool cribs_satisfied_p(uint8_t cipher_indices[], int cipher_len, uint8_t crib_indices[], 
 	int crib_positions[], int n_cribs, int cycleword_len, bool verbose);
 
-bool constrain_cycleword(int cipher_indices[], int cipher_len, 
-	int crib_indices[], int crib_positions[], int n_cribs, 
-	int plaintext_keyword_indices[], int ciphertext_keyword_indices[], 
-	int cycleword_indices[], int cycleword_len,
-	bool variant, bool verbose);
-
-void quagmire_decrypt(int decrypted[], int cipher_indices[], int cipher_len, 
-	int plaintext_keyword_indices[], int ciphertext_keyword_indices[], 
-	int cycleword_indices[], int cycleword_len, bool beaufort);
-
-void quagmire_encrypt(int encrypted[], int plaintext_indices[], int cipher_len, 
-	int plaintext_keyword_indices[], int ciphertext_keyword_indices[], 
-	int cycleword_indices[], int cycleword_len, bool beaufort);
-
-double state_score(int cipher_indices[], int cipher_len, 
-			int crib_indices[], int crib_positions[], int n_cribs, 
-			int plaintext_keyword_state[], int ciphertext_keyword_state[], 
-			int cycleword_state[], int cycleword_len,
-			bool variant, bool beaufort, 
-			int decrypted[], 
-			float *ngram_data, int ngram_size,
-			float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy);
+void crib_engine_setup(crib_engine *engine, uint8_t cipher_indices[], 
+	uint8_t crib_indices[], int crib_positions[], int n_cribs, int cycleword_len, bool variant);
 
-void straight_alphabet(int keyword[], int len);
+bool crib_engine_constrain(crib_engine *engine, 
+	uint8_t plaintext_keyword[], uint8_t ciphertext_keyword[], uint8_t cycleword[]);
 
-double ngram_score(int decrypted[], int cipher_len, float *ngram_data, int ngram_size);
+void quagmire_decrypt(uint8_t decrypted[], uint8_t cipher_indices[], int cipher_len, 
+	uint8_t plaintext_keyword_indices[], uint8_t ciphertext_keyword_indices[], 
+	uint8_t cycleword_indices[], int cycleword_len, bool beaufort);
 
-double crib_score(int text[], int len, int crib_indices[], int crib_positions[], int n_cribs);
+void quagmire_encrypt(uint8_t encrypted[], uint8_t plaintext_indices[], int cipher_len, 
+	uint8_t plaintext_keyword_indices[], uint8_t ciphertext_keyword_indices[], 
+	uint8_t cycleword_indices[], int cycleword_len, bool beaufort);
 
-double entropy(int text[], int len);
-double chi_squared(int plaintext[], int len);
+void build_cipher_tables(cipher_tables *tables, 
+	uint8_t plaintext_keyword_indices[], uint8_t ciphertext_keyword_indices[], 
+	uint8_t cycleword_indices[], int cycleword_len, bool variant, bool beaufort);
+int column_shift(cipher_tables *tables, int cw_indx);
 
-void load_dictionary(char *filename, char ***dict, int *n_dict_words, int *max_dict_word_len, bool verbose);
-void free_dictionary(char **dict, int n_dict_words);
-int find_dictionary_words(char *plaintext, char **dict, int n_dict_words, int max_dict_word_len);
+void polyalphabetic_gather(uint8_t output[], uint8_t input[], int len, 
+	int inverse[], int alphabet[], int shifts[], int cycleword_len);
+void invert_alphabet(uint8_t keyword[], int inverse[]);
+void doubled_alphabet(uint8_t keyword[], int doubled[], bool beaufort);
 
-float* load_ngrams(char *ngram_file, int ngram_size, bool verbose);
-int ngram_index_int(int *ngram, int ngram_size);
-int ngram_index_str(char *ngram, int ngram_size);
-
-void perturbate_keyword(int state[], int len, int keyword_len);
-void random_keyword(int keyword[], int len, int keyword_len);
-
-void random_cycleword(int cycleword[], int max, int keyword_len);
-void perturbate_cycleword(int state[], int max, int len);
+double state_score(uint8_t cipher_indices[], int cipher_len, 
+			uint8_t crib_indices[], int crib_positions[], int n_cribs, 
+			uint8_t plaintext_keyword_state[], uint8_t ciphertext_keyword_state[], 
+			uint8_t cycleword_state[], int cycleword_len,
+			bool variant, bool beaufort, 
+			uint8_t decrypted[], 
+			ngram_table *ngram_data, int ngram_size,
+			float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy);
 
+void score_terms_setup(score_terms *terms, int cipher_len, int n_cribs, 
+	ngram_table *ngram_data, int ngram_size, 
+	float weight_ngram, float weight_crib, float weight_ioc, float weight_entropy);
+double score_from_terms(score_terms *terms, double ngram_total, int n_crib_matches, int counts[]);
+void build_count_log_count();
+double fused_decrypt(cipher_tables *tables, uint8_t cipher_indices[], int cipher_len, int cycleword_len, 
+	int crib_positions[], uint8_t crib_indices[], int n_cribs, ngram_table *ngram_data, int ngram_size, 
+	uint8_t decrypted[], float windows[], int counts[], int *n_crib_matches, double ngram_bound);
+double fused_decrypt_general(cipher_tables *tables, uint8_t cipher_indices[], int cipher_len, int cycleword_len, 
+	int crib_positions[], uint8_t crib_indices[], int n_cribs, ngram_table *ngram_data, int ngram_size, 
+	uint8_t decrypted[], float windows[], int counts[], int *n_crib_matches, double ngram_bound);
+void select_fused_kernels(ngram_table *table);
+
+void score_cache_setup(score_cache *cache, climber_shared *shared);
+void score_cache_init(score_cache *cache, 
+	uint8_t plaintext_keyword_state[], uint8_t ciphertext_keyword_state[], uint8_t cycleword_state[]);
+void score_cache_decrypt(score_cache *cache);
+double score_cache_score(score_cache *cache);
+double score_cache_tally_score(score_cache *cache, double ngram_total, int n_crib_matches, int counts[]);
+double score_cache_full_score(score_cache *cache, cipher_tables *tables, double threshold);
+void score_cache_apply(score_cache *cache, int n, int positions[], uint8_t letters[]);
+double score_cache_update_column(score_cache *cache, int column, int cw_indx, double threshold);
+void build_column_letter_index(score_cache *cache);
+int changed_positions(score_cache *cache, cipher_tables *proposed, int max_changes, 
+	int positions[], uint8_t letters[]);
+int score_candidate_batch(candidate_batch *batch, score_cache *cache);
+double score_cache_update_state(score_cache *cache, 
+	uint8_t plaintext_keyword_state[], uint8_t ciphertext_keyword_state[], uint8_t cycleword_state[], 
+	double threshold);
+void score_cache_commit(score_cache *cache);
+void score_cache_revert(score_cache *cache);
+
+void straight_alphabet(uint8_t keyword[], int len);
+
+double ngram_score(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size);
+double ngram_score_direct(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size);
+double ngram_score_rolling(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size);
+#if NGRAM_SIMD
+double ngram_score_avx2(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size);
+double ngram_score_avx512(uint8_t decrypted[], int cipher_len, ngram_table *ngram_data, int ngram_size);
+#endif
+void select_ngram_score_kernel(ngram_table *table);
+
+double crib_score(uint8_t text[], int len, uint8_t crib_indices[], int crib_positions[], int n_cribs);
+
+double entropy(uint8_t text[], int len);
+double entropy_from_tally(int frequencies[], int len);
+double chi_squared(uint8_t plaintext[], int len);
+
+void load_dictionary(char *filename, dictionary *dict, bool verbose);
+void free_dictionary(dictionary *dict);
+int find_dictionary_words(char *plaintext, dictionary *dict, bool print_words);
+int compare_dictionary_matches(const void *a, const void *b);
+bool load_keyword_index(char *source, keyword_index *index, bool verbose);
+void free_keyword_index(keyword_index *index);
+int keyed_alphabet(char *word, uint8_t alphabet[]);
+int compare_keyed_alphabets(const void *a, const void *b);
+
+void load_ngrams(ngram_table *table, char *ngram_file, int ngram_size, int backend, bool verbose);
+long long parse_ngrams(char *ngram_file, int ngram_size, long long **keys, float **values);
+int compare_ngram_entries(const void *a, const void *b);
+void build_ngram_table(ngram_table *table, int backend, int ngram_size, 
+	long long *keys, float *values, long long n_entries);
+float ngram_lookup(ngram_table *table, long long index);
+long long ngram_hash(long long index, long long n_slots);
+size_t ngram_table_size(int backend, long long n_entries);
+bool map_ngram_cache(ngram_table *table, char *cache_file, struct stat *source, int ngram_size, int backend);
+bool write_ngram_cache(char *cache_file, struct stat *source, ngram_table *table);
+void free_ngrams(ngram_table *table);
+int ngram_backend(char *name);
+long long ngram_index_int(uint8_t *ngram, int ngram_size);
+long long ngram_index_str(char *ngram, int ngram_size);
+
+void perturbate_keyword(uint8_t state[], int len, int keyword_len, keyword_sampler *sampler);
+void random_keyword(uint8_t keyword[], int len, int keyword_len);
+
+void random_cycleword(uint8_t cycleword[], int max, int keyword_len);
+void perturbate_cycleword(uint8_t state[], int max, int len);
+
+void seed_rand(uint64_t seed);
+uint64_t default_seed();
+void split_rand(rand_stream *stream);
+void split_rand_jobs(rand_stream *stream);
+void long_jump_rand(rand_stream *stream);
+void apply_rand_jump(rand_stream *stream, const uint64_t jump[4]);
+void jump_rand(rand_stream *stream);
+uint64_t rand_u64();
 int rand_int(int min, int max);
-int rand_int_frequency_weighted(int state[], int min_index, int max_index);
-
-double mean_ioc(int text[], int len, int len_cycleword, int *caesar_column);
-void estimate_cycleword_lengths(int text[], int len, int max_cycleword_len, 
-	double n_sigma_threshold, double ioc_threshold, 
+void keyword_sampler_init(keyword_sampler *sampler);
+void keyword_sampler_sync(keyword_sampler *sampler, uint8_t state[], int keyword_len);
+void fenwick_add(int tree[], int letter, int delta);
+int fenwick_search(int tree[], int target);
+int rand_int_frequency_weighted(keyword_sampler *sampler, uint8_t state[], int keyword_len, bool in_keyspace);
+
+void periodic_ioc(uint8_t text[], int len, int max_period, double mean_iocs[]);
+void periodic_autocorrelation(uint8_t text[], int len, int max_period, double kappas[]);
+void kasiski_factors(uint8_t text[], int len, int max_period, double factors[]);
+double friedman_period(uint8_t text[], int len);
+bool z_scores(double vec[], int len, double scores[]);
+void estimate_cycleword_lengths(uint8_t text[], int len, int max_cycleword_len, 
+	double n_sigma_threshold, double ioc_threshold, bool period_tests, 
 	int *n_cycleword_lengths, int cycleword_lengths[], bool verbose);
 double vec_mean(double vec[], int len);
 double vec_stddev(double vec[], int len);
-void vec_print(int vec[], int len);
-void print_text(int indices[], int len);
-void ord(char *text, int indices[]);
-float index_of_coincidence(int plaintext[], int len);
-void tally(int plaintext[], int len, int frequencies[], int n_frequencies);
+void vec_print(uint8_t vec[], int len);
+void print_text(uint8_t indices[], int len);
+void ord(char *text, uint8_t indices[]);
+float index_of_coincidence(uint8_t plaintext[], int len);
+float ioc_from_tally(int frequencies[], int len);
+void tally(uint8_t plaintext[], int len, int frequencies[], int n_frequencies);
 bool file_exists(const char * filename);
 void shuffle(int *array, size_t n);
-void vec_copy(int src[], int dest[], int len);
+void vec_copy(uint8_t src[], uint8_t dest[], int len);
 int int_pow(int base, int exp);
 double frand();
+double wall_clock();